@@ -0,0 +1,151 @@
+// Copyright 2022 Washington University in St Louis
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/shm.h>
+
+#include "rmw/types.h"
+
+#include "rosidl_typesupport_introspection_c/message_introspection.h"
+
+#include "hazcat/hazcat_message_queue.h"
+
+#include "rmw_hazcat/hazcat_segment.h"
+#include "rmw_hazcat/hazcat_slab.h"
+#include "rmw_hazcat/hazcat_tlsf.h"
+
+#ifndef RMW_HAZCAT__HAZCAT_ALLOC_H_
+#define RMW_HAZCAT__HAZCAT_ALLOC_H_
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// Allocators implemented by this rmw rather than hazcat. Hazcat's ALLOCATE and DEALLOCATE don't
+// know their strategies, so allocate and release message memory through these instead. Offsets are
+// 64 bits, and failure is returned apart from them, RMW_RET_BAD_ALLOC when there's no room
+static inline rmw_ret_t
+hazcat_allocate(hma_allocator_t * alloc, size_t size, hazcat_offset_t * offset)
+{
+  switch (alloc->strategy) {
+    case TLSF_STRATEGY:
+      return hazcat_tlsf_allocate(alloc, size, offset);
+    case SLAB_STRATEGY:
+      return hazcat_slab_allocate(alloc, size, offset);
+    default:
+      {
+        int hma_offset = ALLOCATE(alloc, size);
+        if (hma_offset < 0) {
+          return RMW_RET_BAD_ALLOC;
+        }
+        *offset = hma_offset;
+        return RMW_RET_OK;
+      }
+  }
+}
+
+// Adds count references to a message, or releases them if negative. Allocating gives a message its
+// first reference, and each hazcat_deallocate releases one, the last freeing it. Hazcat's own
+// allocators keep no count, so it does nothing for them
+static inline void
+hazcat_share(hma_allocator_t * alloc, hazcat_offset_t offset, int64_t count)
+{
+  switch (alloc->strategy) {
+    case TLSF_STRATEGY:
+      hazcat_tlsf_share(alloc, offset, count);
+      break;
+    case SLAB_STRATEGY:
+      hazcat_slab_share(alloc, offset, count);
+      break;
+    default:
+      break;
+  }
+}
+
+// Whether hazcat_share counts references for the allocator. Only this rmw's own allocators do,
+// which are all in the CPU domain. Hazcat copies messages between domains with ALLOCATE and
+// DEALLOCATE, so these never share a message queue with another domain
+static inline bool
+hazcat_counts_references(const hma_allocator_t * alloc)
+{
+  return TLSF_STRATEGY == alloc->strategy || SLAB_STRATEGY == alloc->strategy;
+}
+
+static inline void
+hazcat_deallocate(hma_allocator_t * alloc, hazcat_offset_t offset)
+{
+  switch (alloc->strategy) {
+    case TLSF_STRATEGY:
+      hazcat_tlsf_deallocate(alloc, offset);
+      break;
+    case SLAB_STRATEGY:
+      hazcat_slab_deallocate(alloc, offset);
+      break;
+    default:
+      DEALLOCATE(alloc, (int)offset);
+  }
+}
+
+// hazcat_share for the message a queue entry references, which may be in an allocator this process
+// hasn't mapped. Pass the caller's own allocator, if it has one, to skip mapping that
+static inline void
+hazcat_share_entry(const entry_t * entry, hma_allocator_t * own, int64_t count)
+{
+  if (NULL != own && entry->alloc_shmem_id == own->shmem_id) {
+    hazcat_share(own, entry->offset, count);
+    return;
+  }
+  hma_allocator_t * alloc = (hma_allocator_t *)shmat(entry->alloc_shmem_id, NULL, 0);
+  if ((void *)-1 != alloc) {
+    hazcat_share(alloc, entry->offset, count);
+    shmdt(alloc);
+  }
+}
+
+// 64 bit counterpart of PTR_TO_OFFSET
+static inline hazcat_offset_t
+hazcat_offset_of(const hma_allocator_t * alloc, const void * ptr)
+{
+  return (const uint8_t *)ptr - (const uint8_t *)alloc;
+}
+
+// Allocator for a publisher or subscription that wasn't handed one. The first such endpoint of a
+// message type in a process gets a TLSF allocator of its own, which can also hold the variable
+// size messages rmw_publish_serialized_message produces. Later endpoints of the type share a slab
+// of its size class instead, falling back on their own TLSF allocator once it's fully reserved.
+// Messages that fit in a cache line along with their header skip TLSF and go in a slab right away.
+// Types with strings or sequences are flattened into blocks of varying size, so always get TLSF.
+// Publishers pass their topic name, and share one allocator with the other publishers of the topic
+// in the process, as long as those are at least as deep. Subscriptions pass null
+hma_allocator_t *
+hazcat_default_allocator(
+  const rosidl_typesupport_introspection_c__MessageMembers * members, const char * topic_name,
+  size_t msg_size, size_t depth);
+
+// Gives back what an endpoint reserved with hazcat_default_allocator, with the same topic name.
+// Once no endpoint in the process uses the allocator it's detached, messages in it stay readable
+// by subscriptions in other processes, which attach to it themselves
+void
+hazcat_release_default_allocator(
+  const rosidl_typesupport_introspection_c__MessageMembers * members, const char * topic_name,
+  hma_allocator_t * alloc, size_t msg_size, size_t depth);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // RMW_HAZCAT__HAZCAT_ALLOC_H_
@@ -0,0 +1,121 @@
+// Copyright 2022 Washington University in St Louis
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "rmw/types.h"
+
+#ifndef RMW_HAZCAT__HAZCAT_BEST_EFFORT_H_
+#define RMW_HAZCAT__HAZCAT_BEST_EFFORT_H_
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// Best effort publishers don't go through hazcat's message queue, which locks the publisher and
+// every slot it touches, and never overwrites a message still being read. Instead each topic with
+// best effort endpoints gets a ring of sequence stamped slots in shared memory. Publishers claim
+// a sequence number, copy the message into its slot and stamp it, only ever waiting on a publisher
+// still writing the same slot a lap earlier.
+// Readers copy messages out and check the stamp again afterwards, skipping any message that was
+// overwritten while (or before) they read it. Best effort subscriptions read both this ring and
+// the topic's hazcat queue, as reliable publishers may publish to them too
+
+#define BE_FILE_PREFIX    "/ros2_hazcat_be"
+#define BE_MAGIC          0x48424532    // Set once the ring is initialized, bumped with its layout
+#define BE_MAX_READERS    64
+#define BE_CACHE_LINE     64
+
+// Readers are woken through a datagram socket, bound in the abstract namespace under their pid
+// and id. Publishers send to them without blocking, and free the entries of readers whose socket
+// is gone. Entries of readers that died without ever waiting are freed once the table fills up
+typedef struct be_reader
+{
+  uint32_t state;     // 0 when free, 1 while being claimed, 2 once registered, 3 while waiting
+  pid_t pid;
+  uint32_t id;
+} be_reader_t;
+
+typedef struct be_slot
+{
+  uint64_t stamp;     // 2 * seq + 1 while message seq is written, 2 * seq + 2 once it's complete
+  uint64_t len;
+} be_slot_t;
+
+// Followed by len slots, stride bytes apart. Each slot starts on its own cache line, so its stamp
+// shares a line with the start of its message rather than the end of the slot before it, and
+// publishing one slot doesn't invalidate lines readers of the previous are still copying
+typedef struct be_ring
+{
+  uint32_t magic;
+  uint32_t refs;      // Endpoints attached, the last to leave unlinks the ring
+  uint32_t len;
+  uint32_t msg_size;
+  uint32_t stride;
+  be_reader_t readers[BE_MAX_READERS];
+  // Sequence number of the next message to be published. Written by every publish, so it's kept
+  // off the lines readers only ever read
+  uint64_t head __attribute__((aligned(BE_CACHE_LINE)));
+} be_ring_t;
+
+typedef struct hazcat_be_endpoint
+{
+  be_ring_t * ring;
+  size_t map_size;
+  int sock;           // Bound to receive wake ups for readers, just used to send for publishers
+  int reader;         // Index in ring->readers, -1 for publishers
+  uint64_t next;      // Sequence number of the next message a reader reads
+  uint64_t lost;      // Messages a reader missed because they were overwritten first
+  char file_name[288];
+} be_endpoint_t;
+
+// Attaches to the ring of a topic, creating it with depth slots of msg_size bytes, header
+// included, if this is the first best effort endpoint on the topic. Readers only see messages
+// published after attaching
+rmw_ret_t
+hazcat_be_attach(
+  be_endpoint_t * ep, const char * topic_name, size_t msg_size, size_t depth, bool reader);
+
+void
+hazcat_be_detach(be_endpoint_t * ep);
+
+// Never blocks, the oldest message is overwritten whether or not it has been read. Slots hold a
+// header of header_size bytes, followed by the message
+rmw_ret_t
+hazcat_be_publish(
+  be_endpoint_t * ep, const void * header, size_t header_size, const void * msg, size_t size);
+
+// Copies the next intact message and its header out, returns false if there isn't one
+bool
+hazcat_be_take(be_endpoint_t * ep, void * header, size_t header_size, void * msg, size_t size);
+
+// Has publishers wake a reader through its socket once it has a message waiting, which it may
+// already. Called before waiting on the socket, publishers only wake a reader once per call
+void
+hazcat_be_arm(be_endpoint_t * ep);
+
+// Whether a reader has a message waiting. Also clears the wake ups it has received, and counts
+// messages it has been lapped on as lost
+bool
+hazcat_be_ready(be_endpoint_t * ep);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // RMW_HAZCAT__HAZCAT_BEST_EFFORT_H_
@@ -0,0 +1,100 @@
+// Copyright 2022 Washington University in St Louis
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "rmw/rmw.h"
+#include "rmw/subscription_content_filter_options.h"
+
+#include "rosidl_typesupport_introspection_c/message_introspection.h"
+
+#ifndef RMW_HAZCAT__HAZCAT_FILTER_H_
+#define RMW_HAZCAT__HAZCAT_FILTER_H_
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// Content filters are a subset of the DDS filter grammar: comparisons (=, <>, <, <=, >, >=) of a
+// field against a literal or %n parameter, combined with AND, OR, NOT and parentheses. Fields are
+// resolved against the message's introspection data when the filter is set, so evaluating one is
+// just loads at fixed offsets into the message as it sits in shared memory. Only fields of
+// primitive type can be compared. Strings and sequences are stored outside the message, in
+// memory that isn't necessarily mapped into the subscription's process
+
+#define FILTER_MAX_NODES  64
+
+typedef enum filter_kind
+{
+  FILTER_AND,
+  FILTER_OR,
+  FILTER_NOT,
+  FILTER_COMPARE,
+} filter_kind_t;
+
+typedef enum filter_op
+{
+  FILTER_EQ,
+  FILTER_NE,
+  FILTER_LT,
+  FILTER_LE,
+  FILTER_GT,
+  FILTER_GE,
+} filter_op_t;
+
+typedef struct filter_node
+{
+  uint8_t kind;       // One of filter_kind_t
+  uint8_t op;         // One of filter_op_t, for comparisons
+  uint8_t type_id;    // rosidl_typesupport_introspection_c__ROS_TYPE_* of the field compared
+  bool as_double;     // Compared as floating point, because the field or the literal is
+  uint32_t offset;    // Of the field compared, from the start of the message
+  int16_t left;       // Operands of AND, OR and NOT, by index in hazcat_filter_t::nodes
+  int16_t right;
+  union
+  {
+    int64_t i;
+    uint64_t u;
+    double d;
+  } value;
+} filter_node_t;
+
+typedef struct hazcat_filter
+{
+  filter_node_t nodes[FILTER_MAX_NODES];
+  int count;
+  int root;
+  rmw_subscription_content_filter_options_t options;   // As set, handed back on request
+} hazcat_filter_t;
+
+// Compiles a filter expression for messages described by members
+rmw_ret_t
+hazcat_filter_init(
+  hazcat_filter_t * filter,
+  const rosidl_typesupport_introspection_c__MessageMembers * members,
+  const rmw_subscription_content_filter_options_t * options);
+
+void
+hazcat_filter_fini(hazcat_filter_t * filter);
+
+bool
+hazcat_filter_matches(const hazcat_filter_t * filter, const void * msg);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // RMW_HAZCAT__HAZCAT_FILTER_H_
@@ -0,0 +1,120 @@
+// Copyright 2022 Washington University in St Louis
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <errno.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include "hazcat/hazcat_message_queue.h"
+
+#ifndef RMW_HAZCAT__HAZCAT_MQ_H_
+#define RMW_HAZCAT__HAZCAT_MQ_H_
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// Helpers for inspecting a hazcat message queue from outside the hazcat library. A queue file is
+// the message_queue_t header, followed by len ref_bits_t, followed by one array of len entry_t
+// for each domain in mq->domains
+
+// Same naming hazcat uses for message queue files, eg "/ns/topic" -> "/ros2_hazcat.ns.topic"
+static inline void
+hazcat_mq_file_name(const char * topic_name, char * file_name, size_t len)
+{
+  snprintf(file_name, len, "/ros2_hazcat%s", topic_name);
+  for (char * c = file_name + 1; '\0' != *c; c++) {
+    if ('/' == *c) {
+      *c = '.';
+    }
+  }
+}
+
+static inline ref_bits_t *
+hazcat_mq_ref_bits(message_queue_t * mq, int i)
+{
+  return (ref_bits_t *)((uint8_t *)mq + sizeof(message_queue_t) + i * sizeof(ref_bits_t));
+}
+
+static inline entry_t *
+hazcat_mq_entry(message_queue_t * mq, int domain, int i)
+{
+  return (entry_t *)((uint8_t *)mq + sizeof(message_queue_t) + mq->len * sizeof(ref_bits_t) +
+         (domain * mq->len + i) * sizeof(entry_t));
+}
+
+// Index of a domain's entries in the queue, or -1 if it has none
+static inline int
+hazcat_mq_domain_index(const message_queue_t * mq, uint32_t domain)
+{
+  for (int j = 0; j < mq->num_domains; j++) {
+    if ((uint32_t)mq->domains[j] == domain) {
+      return j;
+    }
+  }
+  return -1;
+}
+
+// Attempts at a message queue slot's lock between checks on whether its holder is still alive
+#define SLOT_LOCK_SPINS     1000
+
+// Slot locks this rmw takes hold the holder's pid, when the lock is wide enough. Hazcat's own hold
+// 1, the pid of init, which never publishes, so they're never taken for a dead process's.
+// hazcat_publish and hazcat_take update interest_count and availability under this lock with plain
+// loads and stores, so the rmw can't switch its own updates to atomics until hazcat does
+static inline void
+hazcat_mq_slot_lock(ref_bits_t * bits)
+{
+  __typeof__(bits->lock) self = (sizeof(bits->lock) >= sizeof(pid_t)) ? getpid() : 1;
+  for (int spins = 1;; spins++) {
+    __typeof__(bits->lock) holder = 0;
+    if (__atomic_compare_exchange_n(
+        &bits->lock, &holder, self, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+    {
+      return;
+    }
+    // Only break the lock of a holder known to be dead, a live one is just slow to release it
+    if (0 == spins % SLOT_LOCK_SPINS && 1 != holder && -1 == kill(holder, 0) && ESRCH == errno &&
+      __atomic_compare_exchange_n(
+        &bits->lock, &holder, self, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+    {
+      return;
+    }
+    sched_yield();
+  }
+}
+
+static inline void
+hazcat_mq_slot_unlock(ref_bits_t * bits)
+{
+  __atomic_store_n(&bits->lock, 0, __ATOMIC_RELEASE);
+}
+
+// Size of a queue file with the given number of slots and domains
+static inline size_t
+hazcat_mq_size(int len, int num_domains)
+{
+  return sizeof(message_queue_t) + len * sizeof(ref_bits_t) + num_domains * len * sizeof(entry_t);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // RMW_HAZCAT__HAZCAT_MQ_H_
@@ -26,12 +26,14 @@ extern "C"
 typedef struct hazcat_node_info
 {
   rmw_guard_condition_t * const guard_condition_;   // Triggers whenver ros graph changes
+  const int graph_id_;                              // Index of node in shared memory ros graph
 } node_info_t;
 
 // Bytewise identical with above but with const keywords removed for one time assignment
 typedef struct hazcat_node_info__
 {
   rmw_guard_condition_t * guard_condition;
+  int graph_id;
 } construct_node_info__;
 
 #ifdef __cplusplus
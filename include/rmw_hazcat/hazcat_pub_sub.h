@@ -0,0 +1,142 @@
+// Copyright 2022 Washington University in St Louis
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <pthread.h>
+
+#include "rmw/rmw.h"
+
+#include "rosidl_typesupport_introspection_c/message_introspection.h"
+
+#include "hazcat/hazcat_message_queue.h"
+
+#include "rmw_hazcat/hazcat_best_effort.h"
+#include "rmw_hazcat/hazcat_filter.h"
+#include "rmw_hazcat/hazcat_mq.h"
+#include "rmw_hazcat/hazcat_qos.h"
+#include "rmw_hazcat/hazcat_ros_graph.h"
+#include "rmw_hazcat/hazcat_segment.h"
+
+#ifndef RMW_HAZCAT__HAZCAT_PUB_SUB_H_
+#define RMW_HAZCAT__HAZCAT_PUB_SUB_H_
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// Queue depth of KEEP_ALL endpoints that don't ask for one, since ROS ignores depth under KEEP_ALL
+#define KEEP_ALL_DEPTH  256
+
+// Written ahead of every published message. Messages handed to and from users point just past it
+typedef struct hazcat_msg_header
+{
+  rmw_time_point_value_t source_timestamp;
+  rmw_time_point_value_t expiry;    // System time the message's lifespan ends, 0 if it never does
+  uint64_t sequence_number;         // Among messages sent by the same publisher, starting at 1
+  uint8_t publisher_gid[RMW_GID_STORAGE_SIZE];
+} msg_header_t;
+
+// Publishers a subscription remembers the last message of, to see gaps in their sequence numbers.
+// Past that, the one heard from least recently is forgotten and its next gap goes uncounted
+#define TRACKED_PUBLISHERS    8
+
+typedef struct hazcat_publisher_seq
+{
+  uint8_t gid[RMW_GID_STORAGE_SIZE];
+  uint64_t sequence_number;   // Highest taken from the publisher, 0 if the entry is unused
+} publisher_seq_t;
+
+// Publisher and subscription data owned by this rmw. The hazcat data must stay the first member,
+// so a pointer to this struct can be handed to any hazcat_* function expecting pub_sub_data_t
+typedef struct hazcat_pub_sub_info
+{
+  pub_sub_data_t data;
+  const rosidl_typesupport_introspection_c__MessageMembers * members;   // Introspection of type
+  bool fixed_size;   // No strings or sequences, so messages are copied as they are, not flattened
+  int graph_id;   // Index of endpoint in shared memory ros graph
+  graph_topic_t * topic;   // State shared with other endpoints on the topic, in the ros graph
+  rmw_qos_profile_t qos;   // As requested, with depth resolved
+  pub_sub_data_t * retainer;   // Subscription keeping a TRANSIENT_LOCAL publisher's history
+  be_endpoint_t * best_effort;   // Ring best effort messages go through, null when reliable
+  deadline_t deadline;
+  uint64_t sequence_number;   // Of the last message a publisher sent
+  msg_ref_t pending;   // Subscription's next message, taken early to check it hasn't expired
+  pthread_mutex_t pending_lock;
+  publisher_seq_t publishers[TRACKED_PUBLISHERS];   // Most recently heard from first
+  uint64_t lost_reported;   // Totals as of the last rmw_take_event, for working out changes
+  uint32_t incompatible_reported;
+  hazcat_filter_t * filter;   // Content filter of a subscription, null when it takes everything
+  bool mq_locked;   // Whether the endpoint holds a reference to its queue mapping's lock
+} pub_sub_info_t;
+
+// Defined in rmw_publisher.c, also used to identify subscriptions in the ros graph
+rmw_gid_t
+generate_gid();
+
+rmw_ret_t
+allocate_message(hma_allocator_t * alloc, size_t size, hazcat_offset_t * offset);
+
+// Defined in rmw_subscription.c. Whether a subscription has an unexpired message to take, any
+// expired ones ahead of it are released
+bool
+hazcat_subscription_ready(pub_sub_info_t * info);
+
+static inline size_t
+hazcat_qos_depth(const rmw_qos_profile_t * qos)
+{
+  if (RMW_QOS_POLICY_HISTORY_KEEP_ALL == qos->history && 0 == qos->depth) {
+    return KEEP_ALL_DEPTH;
+  }
+  return (qos->depth > 1) ? qos->depth : 1;
+}
+
+// Applies default segment flags to a registered endpoint's message queue mapping. Hazcat maps the
+// queue itself, so this is the earliest the rmw can place or lock it. Every endpoint of the topic
+// in this process shares the mapping, and holds a reference to its lock
+static inline rmw_ret_t
+hazcat_advise_queue(pub_sub_info_t * info)
+{
+  int flags = hazcat_segment_default_flags();
+  message_queue_t * mq = info->data.mq->elem;
+  rmw_ret_t ret = hazcat_segment_advise(mq, hazcat_mq_size(mq->len, mq->num_domains), flags);
+  info->mq_locked = RMW_RET_OK == ret && (flags & HAZCAT_SEGMENT_LOCKED);
+  return ret;
+}
+
+// Whether a registered endpoint's queue spans memory domains while an endpoint on its topic has an
+// allocator counting references, see hazcat_counts_references. Every endpoint checks once it's in
+// both the queue and the ros graph, so of two joining at once, at least the later one sees this
+static inline bool
+hazcat_mixes_domains(const pub_sub_info_t * info)
+{
+  return NULL != info->topic &&
+         1 < __atomic_load_n(&info->data.mq->elem->num_domains, __ATOMIC_SEQ_CST) &&
+         0 < __atomic_load_n(&info->topic->refcounted, __ATOMIC_SEQ_CST);
+}
+
+// Drops the endpoint's reference to the queue mapping's lock, before it's unregistered
+static inline void
+hazcat_unlock_queue(pub_sub_info_t * info)
+{
+  if (info->mq_locked) {
+    hazcat_segment_unlock(info->data.mq->elem);
+    info->mq_locked = false;
+  }
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // RMW_HAZCAT__HAZCAT_PUB_SUB_H_
@@ -0,0 +1,89 @@
+// Copyright 2022 Washington University in St Louis
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "rmw/event.h"
+#include "rmw/types.h"
+
+#ifndef RMW_HAZCAT__HAZCAT_QOS_H_
+#define RMW_HAZCAT__HAZCAT_QOS_H_
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// Nanoseconds in a QoS duration, or 0 if it's unset or infinite and there's nothing to enforce
+int64_t
+hazcat_qos_duration(rmw_time_t duration);
+
+// Counts deadline periods that pass without a publisher sending, or a subscription receiving, a
+// message. Only the time of the last message is tracked, periods missed since are worked out
+// whenever they're asked for. The timer is only there to wake wait sets when a period runs out.
+// Messages are counted by publish and take while wait sets read it, so last and missed are only
+// read under seq, which is odd while they're being updated
+typedef struct hazcat_deadline
+{
+  int64_t period;     // 0 if there's no deadline
+  int64_t last;       // Steady time the last message was sent, or of creation
+  int32_t missed;     // Periods missed up to last
+  int32_t reported;   // Total as of the last hazcat_deadline_take
+  uint32_t seq;
+  int timer;          // timerfd, -1 if there's no deadline
+} deadline_t;
+
+rmw_ret_t
+hazcat_deadline_init(deadline_t * deadline, rmw_time_t period);
+
+void
+hazcat_deadline_fini(deadline_t * deadline);
+
+// Sets the timer to go off when the current period runs out
+void
+hazcat_deadline_arm(deadline_t * deadline);
+
+// Call for every message sent or received, with the system time it was stamped with when sent.
+// Messages older than the last one counted are ignored
+void
+hazcat_deadline_message(deadline_t * deadline, rmw_time_point_value_t source_timestamp);
+
+// Periods missed so far
+int32_t
+hazcat_deadline_missed(const deadline_t * deadline);
+
+// Whether periods were missed since the last hazcat_deadline_take
+bool
+hazcat_deadline_pending(const deadline_t * deadline);
+
+// Periods missed so far, and how many of them weren't reported by the previous call
+void
+hazcat_deadline_take(deadline_t * deadline, int32_t * total, int32_t * change);
+
+// Policy that keeps a publisher's messages from reaching a subscription, going by what each
+// requested, or RMW_QOS_POLICY_INVALID if they're compatible. Checks the same policies as
+// rmw_qos_profile_check_compatible, except liveliness which this rmw doesn't enforce
+rmw_qos_policy_kind_t
+hazcat_qos_incompatibility(const rmw_qos_profile_t * pub, const rmw_qos_profile_t * sub);
+
+// Defined in rmw_event.c, whether an event has something new to take
+bool
+hazcat_event_ready(const rmw_event_t * event);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // RMW_HAZCAT__HAZCAT_QOS_H_
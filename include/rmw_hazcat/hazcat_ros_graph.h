@@ -0,0 +1,256 @@
+// Copyright 2022 Washington University in St Louis
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "rcutils/allocator.h"
+#include "rcutils/types.h"
+
+#include "rmw/names_and_types.h"
+#include "rmw/rmw.h"
+#include "rmw/topic_endpoint_info_array.h"
+#include "rmw/types.h"
+
+#ifndef RMW_HAZCAT__HAZCAT_ROS_GRAPH_H_
+#define RMW_HAZCAT__HAZCAT_ROS_GRAPH_H_
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define GRAPH_FILE_NAME       "/ros2_hazcat_graph"
+#define GRAPH_MAGIC           0x48474152    // Set once the segment is fully initialized
+#define GRAPH_VERSION         3             // Bumped with the segment's layout
+#define GRAPH_MAX_NODES       256
+#define GRAPH_MAX_ENDPOINTS   2048
+#define GRAPH_MAX_TOPICS      1024
+#define GRAPH_NAME_LEN        256
+
+// Bit flags, so queries can ask for several kinds of endpoint at once
+typedef enum graph_endpoint_kind
+{
+  GRAPH_PUBLISHER = 0x1,
+  GRAPH_SUBSCRIPTION = 0x2,
+  GRAPH_SERVICE = 0x4,
+  GRAPH_CLIENT = 0x8,
+} graph_endpoint_kind_t;
+
+typedef struct graph_node
+{
+  uint32_t in_use;
+  pid_t pid;
+  uint64_t start_time;  // With pid, identifies the owning process even if its pid is reused
+  char name[GRAPH_NAME_LEN];
+  char namespace_[GRAPH_NAME_LEN];
+  char enclave[GRAPH_NAME_LEN];
+} graph_node_t;
+
+typedef struct graph_endpoint
+{
+  uint32_t in_use;
+  uint32_t kind;        // One of graph_endpoint_kind_t
+  int node;             // Index of owning node in ros_graph_t::nodes
+  uint32_t domain;      // Memory domain of the endpoint's allocator
+  uint32_t refcounted;  // Whether the endpoint's allocator counts references to messages
+  uint32_t cursor;      // Next queue index a subscription will read, updated after every take
+  uint32_t lost;        // Messages a subscription missed, overwritten before it read them
+  uint32_t incompatible;          // Endpoints on the topic whose QoS doesn't match this one's
+  uint32_t incompatible_policy;   // rmw_qos_policy_kind_t of the latest of them
+  int topic_id;         // Index in ros_graph_t::topics, -1 for services and clients
+  uint8_t gid[RMW_GID_STORAGE_SIZE];
+  rmw_qos_profile_t qos;
+  char topic[GRAPH_NAME_LEN];
+  char type[GRAPH_NAME_LEN];
+} graph_endpoint_t;
+
+// State shared by every publisher and subscription of a topic, on top of hazcat's message queue.
+// Claimed by the first endpoint registered on the topic and freed along with the last one
+typedef struct graph_topic
+{
+  uint32_t refs;
+  uint32_t drained;     // Futex, bumped whenever a subscription frees up queue slots or memory
+  uint32_t waiters;     // Publishers sleeping on drained, so subscriptions can skip the wake
+  uint32_t retainers;   // TRANSIENT_LOCAL publishers, each holding on to the latest messages
+  uint32_t publishers;
+  uint32_t subscriptions;
+  uint32_t refcounted;  // Endpoints whose allocator counts references, see hazcat_share
+  uint32_t departed;    // Bumped by each subscription leaving the queue, before it unregisters
+  char name[GRAPH_NAME_LEN];
+} graph_topic_t;
+
+// Host-wide record of every node and endpoint, living in shared memory. Writers serialize on a
+// robust mutex, readers never take it. Instead they retry whenever seq was odd or changed while
+// they were reading, so queries never block on (or stall) a writer
+typedef struct ros_graph
+{
+  uint32_t magic;
+  uint32_t version;     // Written before magic
+  uint32_t seq;
+  uint32_t epoch;       // Bumped after every change, futex waiters on it are woken
+  pthread_mutex_t lock;
+  int node_count;       // High water mark of nodes array, entries past this were never used
+  int endpoint_count;   // High water mark of endpoints array
+  int topic_count;      // High water mark of topics array
+  graph_node_t nodes[GRAPH_MAX_NODES];
+  graph_endpoint_t endpoints[GRAPH_MAX_ENDPOINTS];
+  graph_topic_t topics[GRAPH_MAX_TOPICS];
+} ros_graph_t;
+
+// Maps the graph segment, creating it if this is the first process on the host. Also starts a
+// thread triggering the graph guard conditions of local nodes whenever the graph changes
+rmw_ret_t
+hazcat_graph_init();
+
+rmw_ret_t
+hazcat_graph_fini();
+
+// graph_guard is triggered on every change to the graph until the node is unregistered
+rmw_ret_t
+hazcat_graph_register_node(
+  const char * name,
+  const char * namespace_,
+  const char * enclave,
+  const rmw_guard_condition_t * graph_guard,
+  int * graph_id);
+
+// Also removes any endpoints of the node that weren't unregistered individually
+rmw_ret_t
+hazcat_graph_unregister_node(int graph_id);
+
+rmw_ret_t
+hazcat_graph_register_endpoint(
+  int node_id,
+  graph_endpoint_kind_t kind,
+  const char * topic,
+  const char * type,
+  const rmw_gid_t * gid,
+  const rmw_qos_profile_t * qos,
+  uint32_t domain,
+  bool refcounted,
+  int * graph_id);
+
+rmw_ret_t
+hazcat_graph_unregister_endpoint(int graph_id);
+
+// Shared state of the topic a publisher or subscription is registered on. Stays valid until the
+// endpoint is unregistered
+graph_topic_t *
+hazcat_graph_topic(int graph_id);
+
+// Wakes publishers waiting on subscriptions of the topic to free up queue slots or memory. Only
+// writes to the topic while one is waiting, so every take doesn't bounce its cache line around
+void
+hazcat_graph_topic_drained(graph_topic_t * topic);
+
+// Bumps the topic's departed count, once a subscription has released every message it took and
+// just before it unregisters from the queue. Publishers compare the count from either side of a
+// publish to tell whether a subscription they counted left meanwhile
+void
+hazcat_graph_topic_depart(graph_topic_t * topic);
+
+// The topic's departed count, 0 for a null topic
+uint32_t
+hazcat_graph_topic_departed(const graph_topic_t * topic);
+
+// Counts a publisher in as waiting on the topic, before it checks whether there's room already.
+// Returns what to pass hazcat_graph_topic_wait, or hazcat_graph_topic_cancel_wait if it needn't
+uint32_t
+hazcat_graph_topic_prepare_wait(graph_topic_t * topic);
+
+void
+hazcat_graph_topic_cancel_wait(graph_topic_t * topic);
+
+// Sleeps until topic->drained moves past seen, or timeout_ns passes, then counts the publisher out
+// again. Returns RMW_RET_TIMEOUT in the latter case, or right away if the topic is null
+rmw_ret_t
+hazcat_graph_topic_wait(graph_topic_t * topic, uint32_t seen, int64_t timeout_ns);
+
+// Publishers and subscriptions registered on a topic anywhere on the host, zero for both if it has
+// none. Either pointer may be null
+void
+hazcat_graph_topic_counts(const char * topic, size_t * publishers, size_t * subscriptions);
+
+// Records how far a subscription has read its message queue. For a TRANSIENT_LOCAL publisher,
+// how far the subscription retaining its messages has read
+void
+hazcat_graph_set_cursor(int graph_id, uint32_t cursor);
+
+// Adds to, and returns, the messages a subscription has lost by being lapped. Kept in the graph
+// so tools outside the process can watch them
+uint32_t
+hazcat_graph_add_lost(int graph_id, uint32_t lost);
+
+// Endpoints found on an endpoint's topic with incompatible QoS since it was registered, and the
+// policy at fault the last time
+uint32_t
+hazcat_graph_incompatible(int graph_id, rmw_qos_policy_kind_t * last_policy);
+
+// Removes nodes of processes that have exited without cleaning up, along with their endpoints.
+// Dead publishers and subscriptions are removed from their message queue's counts, and whatever
+// dead subscriptions still had interest in is released as if they had taken it. Scans at most
+// every few milliseconds and costs a kill() per node when no process has died, pids reused by
+// another process are caught by slower scans about once a second. Returns the number of nodes
+// removed
+int
+hazcat_graph_reclaim();
+
+// Current graph epoch. If unchanged since a previous query, that query's results are still valid
+uint32_t
+hazcat_graph_epoch();
+
+// Collects the names and types of all endpoints matching kinds. If node_name is non-null, only
+// endpoints of that node are included, and RMW_RET_NODE_NAME_NON_EXISTENT is returned if no
+// such node exists
+rmw_ret_t
+hazcat_graph_get_names_and_types(
+  uint32_t kinds,
+  const char * node_name,
+  const char * node_namespace,
+  rcutils_allocator_t * allocator,
+  rmw_names_and_types_t * names_and_types);
+
+// Describes every publisher (GRAPH_PUBLISHER) or subscription (GRAPH_SUBSCRIPTION) on a topic
+rmw_ret_t
+hazcat_graph_get_endpoints_info(
+  graph_endpoint_kind_t kind,
+  const char * topic,
+  rcutils_allocator_t * allocator,
+  rmw_topic_endpoint_info_array_t * endpoints_info);
+
+// Looks up the memory domain of an endpoint's allocator, by the gid reported in its endpoint info.
+// Returns RMW_RET_ERROR if no such endpoint is registered
+rmw_ret_t
+hazcat_graph_get_endpoint_domain(const uint8_t gid[RMW_GID_STORAGE_SIZE], uint32_t * domain);
+
+// Enclaves may be null if not wanted
+rmw_ret_t
+hazcat_graph_get_node_names(
+  rcutils_string_array_t * node_names,
+  rcutils_string_array_t * node_namespaces,
+  rcutils_string_array_t * enclaves);
+
+// Converts introspection namespace and name (eg "std_msgs__msg" and "Int32") into a ROS type name
+// (eg "std_msgs/msg/Int32")
+void
+hazcat_graph_type_name(const char * namespace_, const char * name, char * type, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // RMW_HAZCAT__HAZCAT_ROS_GRAPH_H_
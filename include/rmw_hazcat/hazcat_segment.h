@@ -0,0 +1,94 @@
+// Copyright 2022 Washington University in St Louis
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "rmw/types.h"
+
+#ifndef RMW_HAZCAT__HAZCAT_SEGMENT_H_
+#define RMW_HAZCAT__HAZCAT_SEGMENT_H_
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// Shared memory segments backing this rmw's allocators and best effort rings
+
+// Of memory in a segment, from its start. 64 bits, unlike the int offsets of hazcat allocators,
+// but segments are still capped at HAZCAT_QUEUE_OFFSET_MAX
+typedef uint64_t hazcat_offset_t;
+
+// Hazcat's message queue entries (entry_t) store int offsets, so segments of allocators holding
+// messages to queue must end by here. Pools and slabs past 2GB wait on hazcat widening them
+#define HAZCAT_QUEUE_OFFSET_MAX     INT32_MAX
+
+// Back the segment with huge pages, cutting TLB misses when large messages are copied in and out.
+// Explicit huge pages are tried first, then transparent ones, then it's left on regular pages
+#define HAZCAT_SEGMENT_HUGE_PAGES   0x1
+
+// Fault every page of the segment in and lock it in memory when it's mapped, so the first messages
+// through it don't stall on page faults. Counts against RLIMIT_MEMLOCK, see
+// hazcat_segment_locked_bytes
+#define HAZCAT_SEGMENT_LOCKED       0x2
+
+// NUMA placement, pages not yet faulted in are otherwise placed on whichever node first touches
+// them. At most one of these, prefering the node of the thread creating or mapping the segment,
+// spreading it over every node the process may use, or prefering the given node
+#define HAZCAT_SEGMENT_LOCAL_NODE   0x4
+#define HAZCAT_SEGMENT_INTERLEAVE   0x8
+#define HAZCAT_SEGMENT_NODE(node)   (((node) + 1) << HAZCAT_SEGMENT_NODE_SHIFT)
+#define HAZCAT_SEGMENT_NODE_SHIFT   8
+
+// Environment variables turning the above on for every segment that isn't created by the user.
+// HAZCAT_NUMA_ENV is "local", "interleave" or a node number
+#define HAZCAT_HUGE_PAGES_ENV       "RMW_HAZCAT_HUGE_PAGES"
+#define HAZCAT_LOCK_MEMORY_ENV      "RMW_HAZCAT_LOCK_MEMORY"
+#define HAZCAT_NUMA_ENV             "RMW_HAZCAT_NUMA"
+
+// Flags segments get unless the user creates them, from the environment
+int
+hazcat_segment_default_flags();
+
+// Creates and attaches a System V segment of at least size bytes. The segment is marked for
+// removal right away, Linux still lets other processes attach to it by id until the last detaches
+void *
+hazcat_segment_create(size_t size, int flags, int * shmem_id);
+
+// Applies flags to a segment mapped some other way, eg with mmap. Only fails if the segment was to
+// be locked and couldn't be. Locking a mapping this process has locked already only counts another
+// reference to it
+rmw_ret_t
+hazcat_segment_advise(void * addr, size_t size, int flags);
+
+// Drops a reference to a mapping hazcat_segment_advise or hazcat_segment_create locked, unlocking
+// it once there are none left. Does nothing if it isn't locked. Called before it's unmapped
+void
+hazcat_segment_unlock(void * addr);
+
+// NUMA node the page at addr is on, faulting it in if it isn't yet, or -1 if that can't be told.
+// Works on allocators, message queues and anything else in shared memory
+int
+hazcat_segment_node(const void * addr);
+
+// Bytes this process has locked through HAZCAT_SEGMENT_LOCKED, to budget RLIMIT_MEMLOCK with
+size_t
+hazcat_segment_locked_bytes();
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // RMW_HAZCAT__HAZCAT_SEGMENT_H_
@@ -0,0 +1,84 @@
+// Copyright 2022 Washington University in St Louis
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdbool.h>
+
+#include "rmw/rmw.h"
+
+#include "rosidl_typesupport_introspection_c/message_introspection.h"
+
+#include "rmw_hazcat/hazcat_typesupport.h"
+
+#ifndef RMW_HAZCAT__HAZCAT_SERIALIZE_H_
+#define RMW_HAZCAT__HAZCAT_SERIALIZE_H_
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// Whether a message type holds no strings or sequences, so a copy of it points at nothing outside
+// itself
+bool
+hazcat_fixed_size(const rosidl_typesupport_introspection_c__MessageMembers * members);
+
+// Computes how many bytes a serialized message occupies once deserialized into a single flat
+// block. That is the fixed size of the message, followed by the storage of every string and
+// sequence it contains
+rmw_ret_t
+hazcat_flattened_size(
+  const rosidl_typesupport_introspection_c__MessageMembers * members,
+  const rmw_serialized_message_t * serialized_message,
+  size_t * size);
+
+// Deserializes a CDR buffer into a single flat block of at least hazcat_flattened_size() bytes,
+// such as one borrowed from a shared memory allocator. Strings and sequences are stored in the
+// tail of that same block rather than the heap, so the whole message is released with one
+// deallocation. Their data fields hold offsets from the start of the block instead of pointers, so
+// the block reads the same wherever it's mapped, but isn't a usable message until unflattened
+rmw_ret_t
+hazcat_deserialize_flattened(
+  const rosidl_typesupport_introspection_c__MessageMembers * members,
+  const rmw_serialized_message_t * serialized_message,
+  void * block,
+  size_t size);
+
+// Same as hazcat_flattened_size(), going by a message rather than its serialized form
+rmw_ret_t
+hazcat_message_flattened_size(
+  const rosidl_typesupport_introspection_c__MessageMembers * members,
+  const void * ros_message,
+  size_t * size);
+
+// Copies a message into a single flat block, laid out as hazcat_deserialize_flattened() does
+rmw_ret_t
+hazcat_flatten(
+  const rosidl_typesupport_introspection_c__MessageMembers * members,
+  const void * ros_message,
+  void * block,
+  size_t size);
+
+// Copies a flattened block out into an initialized message. Its strings and sequences are resized
+// and assigned through rosidl, so the message owns all its storage and can be finalized as usual
+rmw_ret_t
+hazcat_unflatten(
+  const rosidl_typesupport_introspection_c__MessageMembers * members,
+  const void * block,
+  void * ros_message);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // RMW_HAZCAT__HAZCAT_SERIALIZE_H_
@@ -0,0 +1,75 @@
+// Copyright 2022 Washington University in St Louis
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rmw/rmw.h"
+
+#ifndef RMW_HAZCAT__HAZCAT_SERVICE_LOANS_H_
+#define RMW_HAZCAT__HAZCAT_SERVICE_LOANS_H_
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// The rmw API has no loans for services, so rmw_hazcat exposes its own. They mirror
+// rmw_borrow_loaned_message and friends: a borrowed message lives in the shared memory it will be
+// sent from, and sending it hands it over, so it must not be returned afterwards. A taken loan
+// must be returned once the caller is done with it.
+
+// Client side
+rmw_ret_t
+rmw_hazcat_borrow_loaned_request(const rmw_client_t * client, void ** ros_request);
+
+rmw_ret_t
+rmw_hazcat_return_loaned_request_from_client(const rmw_client_t * client, void * ros_request);
+
+rmw_ret_t
+rmw_hazcat_send_loaned_request(
+  const rmw_client_t * client, void * ros_request, int64_t * sequence_id);
+
+rmw_ret_t
+rmw_hazcat_take_loaned_response(
+  const rmw_client_t * client, rmw_service_info_t * request_header, void ** ros_response,
+  bool * taken);
+
+rmw_ret_t
+rmw_hazcat_return_loaned_response_from_client(const rmw_client_t * client, void * ros_response);
+
+// Service side. Responses are borrowed from the queue of the client they answer, so borrowing
+// needs the request's header
+rmw_ret_t
+rmw_hazcat_take_loaned_request(
+  const rmw_service_t * service, rmw_service_info_t * request_header, void ** ros_request,
+  bool * taken);
+
+rmw_ret_t
+rmw_hazcat_return_loaned_request_from_service(const rmw_service_t * service, void * ros_request);
+
+rmw_ret_t
+rmw_hazcat_borrow_loaned_response(
+  const rmw_service_t * service, const rmw_request_id_t * request_header, void ** ros_response);
+
+rmw_ret_t
+rmw_hazcat_return_loaned_response_from_service(
+  const rmw_service_t * service, const rmw_request_id_t * request_header, void * ros_response);
+
+rmw_ret_t
+rmw_hazcat_send_loaned_response(
+  const rmw_service_t * service, const rmw_request_id_t * request_header, void * ros_response);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // RMW_HAZCAT__HAZCAT_SERVICE_LOANS_H_
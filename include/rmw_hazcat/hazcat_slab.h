@@ -0,0 +1,82 @@
+// Copyright 2022 Washington University in St Louis
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "rmw/types.h"
+
+#include "hazcat/hazcat_message_queue.h"
+
+#include "rmw_hazcat/hazcat_segment.h"
+
+#ifndef RMW_HAZCAT__HAZCAT_SLAB_H_
+#define RMW_HAZCAT__HAZCAT_SLAB_H_
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// Slab allocator of equally sized slots, shared by every endpoint in a process whose messages fall
+// in the same size class. Free slots form a lock-free stack, so the most recently freed slot, still
+// warm in cache and TLB, is handed out first, whichever topic it was last used on. Slots that have
+// never been used are handed out in order after that, so pages of the segment are only touched as
+// they're needed. Each slot has a reference count, kept apart from the slots in an array right
+// after the allocator, so a slot is only pushed back once the last reference to it is released
+
+// Strategy number in the allocator header, see TLSF_STRATEGY
+#define SLAB_STRATEGY     0xFFE
+
+#define SLAB_ALIGN        64    // Slots start on their own cache line
+#define SLAB_MIN_SLOTS    256
+
+typedef struct slab_allocator
+{
+  hma_allocator_t untyped;
+  uint32_t slot_size;
+  uint32_t capacity;
+  uint32_t slots_start;   // Offset of the first slot
+  uint32_t unused;        // Index of the first slot never handed out
+  uint64_t free_head;     // ABA tag in the upper half, index + 1 of the top free slot in the lower
+  uint32_t refs[];        // Of each slot, 0 while it's free
+} slab_allocator_t;
+
+// Slot size messages of this size are kept in. Classes are powers of two and three quarters of
+// them, so at most a quarter of a slot is wasted
+uint32_t
+hazcat_slab_size_class(size_t size);
+
+// Flags are HAZCAT_SEGMENT_* options for the segment the slab is in, which can't end past
+// HAZCAT_QUEUE_OFFSET_MAX
+hma_allocator_t *
+hazcat_slab_create(uint32_t slot_size, uint32_t capacity, int flags);
+
+// Sets offset to a slot's from the start of the allocator, or returns RMW_RET_BAD_ALLOC if size
+// doesn't fit or none are free
+rmw_ret_t
+hazcat_slab_allocate(hma_allocator_t * alloc, size_t size, hazcat_offset_t * offset);
+
+// Same as hazcat_tlsf_share
+void
+hazcat_slab_share(hma_allocator_t * alloc, hazcat_offset_t offset, int64_t count);
+
+void
+hazcat_slab_deallocate(hma_allocator_t * alloc, hazcat_offset_t offset);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // RMW_HAZCAT__HAZCAT_SLAB_H_
@@ -0,0 +1,113 @@
+// Copyright 2022 Washington University in St Louis
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <pthread.h>
+
+#include "rmw/rmw.h"
+
+#include "rosidl_typesupport_introspection_c/service_introspection.h"
+
+#include "hazcat/hazcat_message_queue.h"
+
+#ifndef RMW_HAZCAT__HAZCAT_SRV_CLT_H_
+#define RMW_HAZCAT__HAZCAT_SRV_CLT_H_
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// Longest hidden topic a service or client queue can live on
+#define SRV_CLT_TOPIC_LEN 512
+
+// Requests and responses travel over ordinary hazcat message queues. Each service subscribes to
+// "<service>/_request", and each client subscribes to its own "<service>/_response/<guid>", which
+// the service publishes to lazily. Every message is this header followed by the ros message
+typedef struct hazcat_srv_header
+{
+  rmw_request_id_t request_id;   // Guid of the client and the sequence number it assigned
+  rmw_time_point_value_t source_timestamp;
+} srv_header_t;
+
+// Response publisher a service keeps for each client it has answered
+typedef struct hazcat_response_route
+{
+  struct hazcat_response_route * next;
+  rmw_request_id_t client;   // Only writer_guid is meaningful
+  int loans;   // Responses borrowed but not yet sent or returned, route can't go away until 0
+  pub_sub_data_t pub;
+} response_route_t;
+
+// Service and client data owned by this rmw. The hazcat data must stay the first member, so a
+// pointer to this struct can be handed to any hazcat_* function expecting srv_clt_data_t
+typedef struct hazcat_srv_clt_info
+{
+  srv_clt_data_t data;
+  const rosidl_typesupport_introspection_c__ServiceMembers * members;   // Introspection of type
+  int graph_id;   // Index of endpoint in shared memory ros graph
+  pub_sub_data_t queue;       // Subscription to requests (service) or to responses (client)
+  pub_sub_data_t requests;    // Client only, publisher to the service's request queue
+  response_route_t * routes;  // Service only, list of response publishers
+  pthread_mutex_t routes_lock;
+  int64_t sequence_number;    // Client only, last sequence number handed out
+} srv_clt_info_t;
+
+// Fills in everything hazcat_register_* expects of a queue carrying messages of the given size
+rmw_ret_t
+hazcat_srv_clt_init_queue(
+  pub_sub_data_t * data, rmw_context_t * context, size_t size, size_t depth);
+
+void
+hazcat_srv_clt_fini_queue(pub_sub_data_t * data);
+
+void
+hazcat_request_topic(const char * service_name, char * topic, size_t len);
+
+void
+hazcat_response_topic(
+  const char * service_name, const rmw_request_id_t * client, char * topic, size_t len);
+
+// Loans hand out the ros message that sits right behind its header in shared memory
+rmw_ret_t
+hazcat_srv_clt_borrow(pub_sub_data_t * data, void ** ros_message);
+
+void
+hazcat_srv_clt_return_borrowed(pub_sub_data_t * data, void * ros_message);
+
+rmw_ret_t
+hazcat_srv_clt_send_loaned(
+  pub_sub_data_t * data, const rmw_request_id_t * request_id, void * ros_message);
+
+// Copies ros_message behind a header and publishes it on data
+rmw_ret_t
+hazcat_srv_clt_send(
+  pub_sub_data_t * data, const rmw_request_id_t * request_id, const void * ros_message);
+
+// Takes the next message from data, if any, filling in header with where it came from
+rmw_ret_t
+hazcat_srv_clt_take(
+  pub_sub_data_t * data, rmw_service_info_t * header, void * ros_message, bool * taken);
+
+rmw_ret_t
+hazcat_srv_clt_take_loaned(
+  pub_sub_data_t * data, rmw_service_info_t * header, void ** ros_message, bool * taken);
+
+rmw_ret_t
+hazcat_srv_clt_return_taken(pub_sub_data_t * data, void * ros_message);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // RMW_HAZCAT__HAZCAT_SRV_CLT_H_
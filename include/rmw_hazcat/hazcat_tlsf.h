@@ -0,0 +1,112 @@
+// Copyright 2022 Washington University in St Louis
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "rmw/types.h"
+
+#include "hazcat/hazcat_message_queue.h"
+
+#include "rmw_hazcat/hazcat_segment.h"
+
+#ifndef RMW_HAZCAT__HAZCAT_TLSF_H_
+#define RMW_HAZCAT__HAZCAT_TLSF_H_
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// Two-level segregated fit allocator, the default for publishers and subscriptions not handed one.
+// The allocator and its pool share a System V segment, so any process attached to it can allocate
+// and free, in any order and any size, in constant time. Free blocks are binned by size, first by
+// power of two, then into TLSF_SL_COUNT linear steps within it, with a bitmap of non-empty bins at
+// each level. Blocks are addressed by offset from the allocator, as it's mapped at different
+// addresses in each process
+
+// Strategy number in the allocator header, clear of those the hazcat library implements
+#define TLSF_STRATEGY     0xFFF
+
+#define TLSF_ALIGN_LOG2   4
+#define TLSF_ALIGN        (1u << TLSF_ALIGN_LOG2)
+#define TLSF_SL_LOG2      4
+#define TLSF_SL_COUNT     (1u << TLSF_SL_LOG2)
+#define TLSF_FL_SHIFT     (TLSF_SL_LOG2 + TLSF_ALIGN_LOG2)
+#define TLSF_FL_COUNT     (64 - TLSF_FL_SHIFT + 1)
+// Blocks smaller than this all go in first level 0
+#define TLSF_SMALL_BLOCK  (1u << TLSF_FL_SHIFT)
+
+// Sits at the start of every block, followed by the block's memory. Sizes are multiples of
+// TLSF_ALIGN, so the low bits are free for flags
+typedef struct tlsf_block
+{
+  uint64_t prev_phys;   // Offset of the block right before this one in the pool, 0 for the first
+  uint64_t size;        // Of the block, header included
+  union
+  {
+    uint64_t next_free;   // Links between free blocks of the same bin, 0 at either end
+    uint64_t refs;        // References to an allocated block, it's freed once the last is released
+  };
+  uint64_t prev_free;
+} tlsf_block_t;
+
+#define TLSF_BLOCK_FREE   0x1u
+#define TLSF_MIN_BLOCK    (2 * sizeof(tlsf_block_t))
+
+typedef struct tlsf_allocator
+{
+  hma_allocator_t untyped;
+  pthread_mutex_t lock;   // Process shared and robust, held for a handful of list operations
+  uint64_t pool_start;    // Offset of the first block
+  uint64_t pool_size;
+  uint64_t fl_bitmap;
+  uint32_t sl_bitmap[TLSF_FL_COUNT];
+  uint64_t free_lists[TLSF_FL_COUNT][TLSF_SL_COUNT];   // Offset of each bin's first block, or 0
+} tlsf_allocator_t;
+
+// Creates an allocator in CPU memory able to hold at least pool_size bytes of blocks. Flags are
+// HAZCAT_SEGMENT_* options for the segment it's in, which can't end past HAZCAT_QUEUE_OFFSET_MAX
+hma_allocator_t *
+hazcat_tlsf_create(size_t pool_size, int flags);
+
+// Pool a publisher or subscription's default allocator gets. Twice as many messages as its queue
+// can reference, leaving room for loans and fragmentation
+static inline size_t
+hazcat_tlsf_pool_size(size_t msg_size, size_t depth)
+{
+  size_t block = (sizeof(tlsf_block_t) + msg_size + TLSF_ALIGN - 1) & ~(size_t)(TLSF_ALIGN - 1);
+  return 2 * depth * block;
+}
+
+// Sets offset to size bytes from the start of the allocator, or returns RMW_RET_BAD_ALLOC if there
+// isn't a big enough block
+rmw_ret_t
+hazcat_tlsf_allocate(hma_allocator_t * alloc, size_t size, hazcat_offset_t * offset);
+
+// Adds count references to an allocated block, or releases them if negative. The block is freed
+// once none are left
+void
+hazcat_tlsf_share(hma_allocator_t * alloc, hazcat_offset_t offset, int64_t count);
+
+// Releases one reference, the one allocation gives unless more were added
+void
+hazcat_tlsf_deallocate(hma_allocator_t * alloc, hazcat_offset_t offset);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // RMW_HAZCAT__HAZCAT_TLSF_H_
@@ -0,0 +1,47 @@
+// Copyright 2022 Washington University in St Louis
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdbool.h>
+
+#include "rosidl_runtime_c/message_type_support_struct.h"
+#include "rosidl_runtime_c/service_type_support_struct.h"
+
+#ifndef RMW_HAZCAT__HAZCAT_TYPESUPPORT_H_
+#define RMW_HAZCAT__HAZCAT_TYPESUPPORT_H_
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// Resolves the C or C++ introspection typesupport of a message
+const rosidl_message_type_support_t *
+get_type_support(
+  const rosidl_message_type_support_t * type_support);
+
+// Whether a typesupport resolved by get_type_support() is the C one. Only C messages have the
+// string and sequence layout messages are flattened with
+bool
+hazcat_c_type_support(const rosidl_message_type_support_t * type_support);
+
+// Resolves the C or C++ introspection typesupport of a service
+const rosidl_service_type_support_t *
+get_service_type_support(
+  const rosidl_service_type_support_t * type_support);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // RMW_HAZCAT__HAZCAT_TYPESUPPORT_H_
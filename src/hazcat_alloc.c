@@ -0,0 +1,287 @@
+// Copyright 2022 Washington University in St Louis
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <string.h>
+#include <sys/shm.h>
+
+#include "rmw/error_handling.h"
+#include "rmw/rmw.h"
+
+#include "rmw_hazcat/hazcat_alloc.h"
+#include "rmw_hazcat/hazcat_ros_graph.h"
+#include "rmw_hazcat/hazcat_segment.h"
+#include "rmw_hazcat/hazcat_serialize.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// A slab is made big enough for this many endpoints as deep as the one that needed it. Pages of it
+// that are never used are never touched, so only address space is spent on the headroom
+#define SLAB_SHARERS  16
+
+// Messages this small, header included, fill a single slot of the smallest size class
+#define SMALL_MESSAGE_SIZE  SLAB_ALIGN
+
+// Default allocators of a message type and size class in this process
+typedef struct default_alloc
+{
+  char type_name[GRAPH_NAME_LEN];
+  uint32_t slot_size;
+  int endpoints;              // Given a default allocator for the type, slab or not
+  hma_allocator_t * slab;     // Created once a second endpoint comes along, or the first if small
+  size_t reserved;            // Slots of the slab promised to endpoints sharing it
+  struct default_alloc * next;
+} default_alloc_t;
+
+// Default allocator the publishers of a topic in this process share
+typedef struct topic_alloc
+{
+  char * topic_name;
+  hma_allocator_t * alloc;
+  size_t msg_size;
+  size_t depth;               // Of the publisher it was made for, later ones may be no deeper
+  int refs;
+  struct topic_alloc * next;
+} topic_alloc_t;
+
+static default_alloc_t * defaults = NULL;
+static topic_alloc_t * topic_allocs = NULL;
+static pthread_mutex_t defaults_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// Each endpoint can have twice its depth of messages in flight, as with its own TLSF pool
+static inline size_t
+slots_reserved(size_t depth)
+{
+  return 2 * depth;
+}
+
+static default_alloc_t *
+find_defaults(const char * type_name, uint32_t slot_size)
+{
+  for (default_alloc_t * it = defaults; NULL != it; it = it->next) {
+    if (slot_size == it->slot_size && 0 == strcmp(type_name, it->type_name)) {
+      return it;
+    }
+  }
+  return NULL;
+}
+
+// With defaults_lock held, the slab an endpoint of the type should use, or null if it should
+// have its own allocator
+static hma_allocator_t *
+reserve_slab(default_alloc_t * entry, size_t depth)
+{
+  size_t reserve = slots_reserved(depth);
+  // Small messages use the slab from the first endpoint on. A publish then costs one cache line of
+  // bookkeeping and one of message, rather than TLSF's lock, bitmaps and block headers
+  bool small = entry->slot_size <= SMALL_MESSAGE_SIZE;
+  if ((0 == entry->endpoints && !small) || 0 == entry->slot_size) {
+    return NULL;
+  }
+  if (NULL == entry->slab) {
+    // Locked slabs are faulted in whole, so headroom costs memory rather than address space
+    int flags = hazcat_segment_default_flags();
+    bool locked = flags & HAZCAT_SEGMENT_LOCKED;
+    size_t capacity = (locked ? 2 : SLAB_SHARERS) * reserve;
+    if (capacity < SLAB_MIN_SLOTS && !locked) {
+      capacity = SLAB_MIN_SLOTS;
+    }
+    size_t most =
+      (HAZCAT_QUEUE_OFFSET_MAX - sizeof(slab_allocator_t) - SLAB_ALIGN) /
+      (entry->slot_size + sizeof(uint32_t));
+    if (capacity > most) {
+      capacity = most;
+    }
+    if (capacity < reserve) {
+      return NULL;
+    }
+    entry->slab = hazcat_slab_create(entry->slot_size, capacity, flags);
+    if (NULL == entry->slab) {
+      // Not fatal, the endpoint can still have an allocator to itself
+      rmw_reset_error();
+      return NULL;
+    }
+  }
+  if (entry->reserved + reserve > ((slab_allocator_t *)entry->slab)->capacity) {
+    return NULL;
+  }
+  entry->reserved += reserve;
+  return entry->slab;
+}
+
+// With defaults_lock held, the allocator shared by publishers of the topic that the given one
+// can also use
+static topic_alloc_t *
+find_topic_alloc(const char * topic_name, size_t msg_size, size_t depth)
+{
+  for (topic_alloc_t * it = topic_allocs; NULL != it; it = it->next) {
+    if (msg_size == it->msg_size && depth <= it->depth && 0 == strcmp(topic_name, it->topic_name)) {
+      return it;
+    }
+  }
+  return NULL;
+}
+
+// With defaults_lock held, drops a publisher's reference to its topic's allocator. False if other
+// publishers still hold it, otherwise depth is set to what it was made for
+static bool
+unref_topic_alloc(hma_allocator_t * alloc, size_t * depth)
+{
+  for (topic_alloc_t ** it = &topic_allocs; NULL != *it; it = &(*it)->next) {
+    topic_alloc_t * entry = *it;
+    if (alloc != entry->alloc) {
+      continue;
+    }
+    if (--entry->refs > 0) {
+      return false;
+    }
+    *depth = entry->depth;
+    *it = entry->next;
+    rmw_free(entry->topic_name);
+    rmw_free(entry);
+    return true;
+  }
+  return true;
+}
+
+static hma_allocator_t *
+type_allocator(
+  const rosidl_typesupport_introspection_c__MessageMembers * members, size_t msg_size,
+  size_t depth)
+{
+  char type_name[GRAPH_NAME_LEN];
+  hazcat_graph_type_name(
+    members->message_namespace_, members->message_name_, type_name, GRAPH_NAME_LEN);
+  uint32_t slot_size = hazcat_slab_size_class(msg_size);
+
+  pthread_mutex_lock(&defaults_lock);
+  default_alloc_t * entry = find_defaults(type_name, slot_size);
+  if (NULL == entry) {
+    entry = rmw_allocate(sizeof(default_alloc_t));
+    if (NULL == entry) {
+      pthread_mutex_unlock(&defaults_lock);
+      RMW_SET_ERROR_MSG("Unable to allocate memory for default allocator bookkeeping");
+      return NULL;
+    }
+    memset(entry, 0, sizeof(default_alloc_t));
+    strncpy(entry->type_name, type_name, GRAPH_NAME_LEN - 1);
+    entry->slot_size = slot_size;
+    entry->next = defaults;
+    defaults = entry;
+  }
+  // Slab slots are a fixed size, too small for a flattened message holding strings or sequences
+  hma_allocator_t * alloc = hazcat_fixed_size(members) ? reserve_slab(entry, depth) : NULL;
+  entry->endpoints++;
+  pthread_mutex_unlock(&defaults_lock);
+
+  if (NULL == alloc) {
+    alloc = hazcat_tlsf_create(
+      hazcat_tlsf_pool_size(msg_size, depth), hazcat_segment_default_flags());
+    if (NULL == alloc) {
+      hazcat_release_default_allocator(members, NULL, NULL, msg_size, depth);
+    }
+  }
+  return alloc;
+}
+
+hma_allocator_t *
+hazcat_default_allocator(
+  const rosidl_typesupport_introspection_c__MessageMembers * members, const char * topic_name,
+  size_t msg_size, size_t depth)
+{
+  if (NULL == topic_name) {
+    return type_allocator(members, msg_size, depth);
+  }
+
+  pthread_mutex_lock(&defaults_lock);
+  topic_alloc_t * shared = find_topic_alloc(topic_name, msg_size, depth);
+  if (NULL != shared) {
+    shared->refs++;
+    hma_allocator_t * alloc = shared->alloc;
+    pthread_mutex_unlock(&defaults_lock);
+    return alloc;
+  }
+  pthread_mutex_unlock(&defaults_lock);
+
+  hma_allocator_t * alloc = type_allocator(members, msg_size, depth);
+  if (NULL == alloc) {
+    return NULL;
+  }
+  // Not being able to share the allocator isn't fatal, this publisher just keeps it to itself
+  shared = rmw_allocate(sizeof(topic_alloc_t));
+  char * name = rmw_allocate(strlen(topic_name) + 1);
+  if (NULL == shared || NULL == name) {
+    rmw_free(shared);
+    rmw_free(name);
+    return alloc;
+  }
+  strcpy(name, topic_name);
+  shared->topic_name = name;
+  shared->alloc = alloc;
+  shared->msg_size = msg_size;
+  shared->depth = depth;
+  shared->refs = 1;
+  pthread_mutex_lock(&defaults_lock);
+  shared->next = topic_allocs;
+  topic_allocs = shared;
+  pthread_mutex_unlock(&defaults_lock);
+  return alloc;
+}
+
+void
+hazcat_release_default_allocator(
+  const rosidl_typesupport_introspection_c__MessageMembers * members, const char * topic_name,
+  hma_allocator_t * alloc, size_t msg_size, size_t depth)
+{
+  char type_name[GRAPH_NAME_LEN];
+  hazcat_graph_type_name(
+    members->message_namespace_, members->message_name_, type_name, GRAPH_NAME_LEN);
+
+  pthread_mutex_lock(&defaults_lock);
+  if (NULL != topic_name && !unref_topic_alloc(alloc, &depth)) {
+    pthread_mutex_unlock(&defaults_lock);
+    return;
+  }
+  default_alloc_t * entry = find_defaults(type_name, hazcat_slab_size_class(msg_size));
+  bool slab = false;
+  if (NULL != entry) {
+    entry->endpoints--;
+    if (NULL != alloc && alloc == entry->slab) {
+      entry->reserved -= slots_reserved(depth);
+      slab = true;
+    }
+    // The slab is kept for later endpoints of the type until none are left
+    if (0 == entry->endpoints && NULL != entry->slab) {
+      hazcat_segment_unlock(entry->slab);
+      shmdt(entry->slab);
+      entry->slab = NULL;
+      entry->reserved = 0;
+    }
+  }
+  pthread_mutex_unlock(&defaults_lock);
+
+  // Any other default allocator was made for this endpoint, or the publishers it was shared with
+  if (NULL != alloc && !slab) {
+    hazcat_segment_unlock(alloc);
+    shmdt(alloc);
+  }
+}
+
+#ifdef __cplusplus
+}
+#endif
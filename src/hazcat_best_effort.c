@@ -0,0 +1,439 @@
+// Copyright 2022 Washington University in St Louis
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <signal.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "rmw/error_handling.h"
+#include "rmw/rmw.h"
+
+#include "rmw_hazcat/hazcat_best_effort.h"
+#include "rmw_hazcat/hazcat_segment.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// How long to wait on another process to finish initializing a ring, in milliseconds
+#define BE_INIT_TIMEOUT   1000
+
+// Attempts at a slot still being written a lap earlier before its writer is presumed dead
+#define BE_CLAIM_SPINS    1000
+
+// Reader states, see be_reader_t
+#define READER_FREE       0
+#define READER_CLAIMED    1
+#define READER_ACTIVE     2
+#define READER_WAITING    3
+
+static size_t
+slot_stride(uint32_t msg_size)
+{
+  return (sizeof(be_slot_t) + msg_size + BE_CACHE_LINE - 1) & ~(size_t)(BE_CACHE_LINE - 1);
+}
+
+static be_slot_t *
+get_slot(be_ring_t * ring, uint64_t seq)
+{
+  return (be_slot_t *)((uint8_t *)(ring + 1) + (seq % ring->len) * ring->stride);
+}
+
+static socklen_t
+reader_address(pid_t pid, uint32_t id, struct sockaddr_un * addr)
+{
+  memset(addr, 0, sizeof(*addr));
+  addr->sun_family = AF_UNIX;
+  // Abstract namespace, so nothing is left on the filesystem by readers that crash
+  int n = snprintf(
+    addr->sun_path + 1, sizeof(addr->sun_path) - 1, "ros2_hazcat_be.%d.%u", pid, id);
+  return offsetof(struct sockaddr_un, sun_path) + 1 + n;
+}
+
+static void
+unmap_ring(be_ring_t * ring, size_t map_size)
+{
+  hazcat_segment_unlock(ring);
+  munmap(ring, map_size);
+}
+
+// Maps a ring, initializing it if this process created the file
+static be_ring_t *
+map_ring(int fd, bool creator, size_t msg_size, size_t depth, size_t * map_size)
+{
+  struct stat st;
+  if (creator) {
+    *map_size = sizeof(be_ring_t) + depth * slot_stride(msg_size);
+    if (-1 == ftruncate(fd, *map_size)) {
+      return NULL;
+    }
+    be_ring_t * ring = mmap(NULL, *map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (MAP_FAILED == ring) {
+      return NULL;
+    }
+    if (RMW_RET_OK != hazcat_segment_advise(ring, *map_size, hazcat_segment_default_flags())) {
+      munmap(ring, *map_size);
+      return NULL;
+    }
+    ring->len = depth;
+    ring->msg_size = msg_size;
+    ring->stride = slot_stride(msg_size);
+    __atomic_store_n(&ring->magic, BE_MAGIC, __ATOMIC_RELEASE);
+    return ring;
+  }
+
+  // Someone else sizes the ring, so wait on that before touching the header
+  int wait = 0;
+  while (0 == fstat(fd, &st) && st.st_size < (off_t)sizeof(be_ring_t) &&
+    wait++ < BE_INIT_TIMEOUT)
+  {
+    usleep(1000);
+  }
+  if (st.st_size < (off_t)sizeof(be_ring_t)) {
+    return NULL;
+  }
+  be_ring_t * ring = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (MAP_FAILED == ring) {
+    return NULL;
+  }
+  if (RMW_RET_OK != hazcat_segment_advise(ring, st.st_size, hazcat_segment_default_flags())) {
+    munmap(ring, st.st_size);
+    return NULL;
+  }
+  while (BE_MAGIC != __atomic_load_n(&ring->magic, __ATOMIC_ACQUIRE)) {
+    if (wait++ >= BE_INIT_TIMEOUT) {
+      unmap_ring(ring, st.st_size);
+      return NULL;
+    }
+    usleep(1000);
+  }
+  *map_size = st.st_size;
+  return ring;
+}
+
+// Whether a registered reader's process is still around to take messages. Its pid may have been
+// reused, so that's followed up by checking its socket is still bound
+static bool
+reader_alive(const be_reader_t * reader)
+{
+  if (-1 == kill(reader->pid, 0) && ESRCH == errno) {
+    return false;
+  }
+  int sock = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+  if (-1 == sock) {
+    return true;
+  }
+  struct sockaddr_un addr;
+  socklen_t addr_len = reader_address(reader->pid, reader->id, &addr);
+  bool alive = 0 == connect(sock, (struct sockaddr *)&addr, addr_len) || ECONNREFUSED != errno;
+  close(sock);
+  return alive;
+}
+
+// Frees the entries of readers that died without detaching. Publishers only find out about those
+// while waking them, which readers that crashed before waiting never ask for
+static void
+reclaim_readers(be_ring_t * ring)
+{
+  for (int i = 0; i < BE_MAX_READERS; i++) {
+    be_reader_t * reader = &ring->readers[i];
+    uint32_t state = __atomic_load_n(&reader->state, __ATOMIC_ACQUIRE);
+    if ((READER_ACTIVE == state || READER_WAITING == state) && !reader_alive(reader)) {
+      __atomic_compare_exchange_n(
+        &reader->state, &state, READER_FREE, false, __ATOMIC_RELEASE, __ATOMIC_RELAXED);
+    }
+  }
+}
+
+static rmw_ret_t
+add_reader(be_endpoint_t * ep)
+{
+  static uint32_t next_id = 0;
+  uint32_t id = __atomic_fetch_add(&next_id, 1, __ATOMIC_RELAXED);
+  struct sockaddr_un addr;
+  socklen_t addr_len = reader_address(getpid(), id, &addr);
+  if (-1 == bind(ep->sock, (struct sockaddr *)&addr, addr_len)) {
+    RMW_SET_ERROR_MSG("Unable to bind best effort subscription's socket");
+    return RMW_RET_ERROR;
+  }
+
+  be_ring_t * ring = ep->ring;
+  for (int attempt = 0; attempt < 2; attempt++) {
+    for (int i = 0; i < BE_MAX_READERS; i++) {
+      uint32_t free_state = READER_FREE;
+      if (__atomic_compare_exchange_n(
+          &ring->readers[i].state, &free_state, READER_CLAIMED, false, __ATOMIC_ACQUIRE,
+          __ATOMIC_RELAXED))
+      {
+        ring->readers[i].pid = getpid();
+        ring->readers[i].id = id;
+        __atomic_store_n(&ring->readers[i].state, READER_ACTIVE, __ATOMIC_RELEASE);
+        ep->reader = i;
+        return RMW_RET_OK;
+      }
+    }
+    // Only worth the system calls once the table is full
+    reclaim_readers(ring);
+  }
+  RMW_SET_ERROR_MSG("Too many best effort subscriptions on topic");
+  return RMW_RET_ERROR;
+}
+
+rmw_ret_t
+hazcat_be_attach(
+  be_endpoint_t * ep, const char * topic_name, size_t msg_size, size_t depth, bool reader)
+{
+  snprintf(ep->file_name, sizeof(ep->file_name), BE_FILE_PREFIX "%s", topic_name);
+  for (char * c = ep->file_name + 1; '\0' != *c; c++) {
+    if ('/' == *c) {
+      *c = '.';
+    }
+  }
+
+  bool creator = true;
+  int fd = shm_open(ep->file_name, O_CREAT | O_EXCL | O_RDWR, 0666);
+  if (-1 == fd && EEXIST == errno) {
+    creator = false;
+    fd = shm_open(ep->file_name, O_RDWR, 0666);
+  }
+  if (-1 == fd) {
+    RMW_SET_ERROR_MSG("Unable to open best effort ring");
+    return RMW_RET_ERROR;
+  }
+  ep->ring = map_ring(fd, creator, msg_size, (depth > 1) ? depth : 1, &ep->map_size);
+  close(fd);
+  if (NULL == ep->ring) {
+    if (!rmw_error_is_set()) {
+      RMW_SET_ERROR_MSG("Unable to map best effort ring");
+    }
+    if (creator) {
+      shm_unlink(ep->file_name);
+    }
+    return RMW_RET_ERROR;
+  }
+  if (ep->ring->msg_size != msg_size) {
+    RMW_SET_ERROR_MSG("Best effort ring was created for a different message type");
+    unmap_ring(ep->ring, ep->map_size);
+    return RMW_RET_ERROR;
+  }
+  // Slots are found by the stride the creator laid them out with, check they're all mapped
+  if (ep->ring->stride < sizeof(be_slot_t) + msg_size ||
+    ep->map_size < sizeof(be_ring_t) + (size_t)ep->ring->len * ep->ring->stride)
+  {
+    RMW_SET_ERROR_MSG("Best effort ring is corrupt");
+    unmap_ring(ep->ring, ep->map_size);
+    return RMW_RET_ERROR;
+  }
+  __atomic_add_fetch(&ep->ring->refs, 1, __ATOMIC_ACQ_REL);
+
+  ep->reader = -1;
+  ep->next = __atomic_load_n(&ep->ring->head, __ATOMIC_ACQUIRE);
+  ep->lost = 0;
+  ep->sock = socket(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (-1 == ep->sock || (reader && RMW_RET_OK != add_reader(ep))) {
+    if (-1 == ep->sock) {
+      RMW_SET_ERROR_MSG("Unable to create best effort socket");
+    }
+    hazcat_be_detach(ep);
+    return RMW_RET_ERROR;
+  }
+
+  return RMW_RET_OK;
+}
+
+void
+hazcat_be_detach(be_endpoint_t * ep)
+{
+  if (-1 != ep->reader) {
+    __atomic_store_n(&ep->ring->readers[ep->reader].state, READER_FREE, __ATOMIC_RELEASE);
+    ep->reader = -1;
+  }
+  if (-1 != ep->sock) {
+    close(ep->sock);
+    ep->sock = -1;
+  }
+  if (0 == __atomic_sub_fetch(&ep->ring->refs, 1, __ATOMIC_ACQ_REL)) {
+    shm_unlink(ep->file_name);
+  }
+  unmap_ring(ep->ring, ep->map_size);
+  ep->ring = NULL;
+}
+
+// Sends a reader its wake up, freeing its entry if its process is gone. A full socket means the
+// reader has wake ups pending already
+static void
+wake(int sock, be_reader_t * reader)
+{
+  struct sockaddr_un addr;
+  socklen_t addr_len = reader_address(reader->pid, reader->id, &addr);
+  if (-1 == sendto(sock, "", 1, MSG_DONTWAIT | MSG_NOSIGNAL, (struct sockaddr *)&addr, addr_len) &&
+    ECONNREFUSED == errno)
+  {
+    uint32_t active = READER_ACTIVE;
+    __atomic_compare_exchange_n(
+      &reader->state, &active, READER_FREE, false, __ATOMIC_RELEASE, __ATOMIC_RELAXED);
+  }
+}
+
+// Marks a slot as being written with message seq. A publisher a lap behind may still be writing
+// it, in which case this waits for it to finish, or returns false if a later lap got there first
+static bool
+claim_slot(be_slot_t * slot, uint64_t seq)
+{
+  uint64_t stamp = __atomic_load_n(&slot->stamp, __ATOMIC_RELAXED);
+  for (int spins = 0; stamp < 2 * seq + 1; spins++) {
+    if (0 == stamp % 2 || spins >= BE_CLAIM_SPINS) {
+      if (__atomic_compare_exchange_n(
+          &slot->stamp, &stamp, 2 * seq + 1, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+      {
+        return true;
+      }
+      continue;
+    }
+    sched_yield();
+    stamp = __atomic_load_n(&slot->stamp, __ATOMIC_RELAXED);
+  }
+  return false;
+}
+
+rmw_ret_t
+hazcat_be_publish(
+  be_endpoint_t * ep, const void * header, size_t header_size, const void * msg, size_t size)
+{
+  be_ring_t * ring = ep->ring;
+  if (header_size + size > ring->msg_size) {
+    RMW_SET_ERROR_MSG("Message too large for best effort ring");
+    return RMW_RET_ERROR;
+  }
+
+  // Odd stamp tells readers the slot is being written, whoever was reading it will notice. Should
+  // the ring lap while this is copied, the publisher a lap ahead can't start on the slot until the
+  // stamp is made even, so readers never see its stamp over this publisher's bytes
+  uint64_t seq = __atomic_fetch_add(&ring->head, 1, __ATOMIC_SEQ_CST);
+  be_slot_t * slot = get_slot(ring, seq);
+  if (!claim_slot(slot, seq)) {
+    // Already overwritten, readers count it as lost
+    return RMW_RET_OK;
+  }
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  slot->len = header_size + size;
+  memcpy(slot + 1, header, header_size);
+  memcpy((uint8_t *)(slot + 1) + header_size, msg, size);
+  uint64_t writing = 2 * seq + 1;
+  __atomic_compare_exchange_n(
+    &slot->stamp, &writing, 2 * seq + 2, false, __ATOMIC_RELEASE, __ATOMIC_RELAXED);
+
+  // Only readers about to wait get a wake up, from whichever publisher finds them waiting first,
+  // so publishing makes no system calls while readers keep up. Readers check the head again after
+  // they start waiting, so one either sees this message or is seen waiting here
+  for (int i = 0; i < BE_MAX_READERS; i++) {
+    be_reader_t * reader = &ring->readers[i];
+    uint32_t waiting = READER_WAITING;
+    if (waiting == __atomic_load_n(&reader->state, __ATOMIC_SEQ_CST) &&
+      __atomic_compare_exchange_n(
+        &reader->state, &waiting, READER_ACTIVE, false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+    {
+      wake(ep->sock, reader);
+    }
+  }
+
+  return RMW_RET_OK;
+}
+
+// Skips a reader past messages that have already been overwritten
+static void
+skip_lapped(be_endpoint_t * ep, uint64_t head)
+{
+  if (head - ep->next > ep->ring->len) {
+    ep->lost += head - ep->next - ep->ring->len;
+    ep->next = head - ep->ring->len;
+  }
+}
+
+bool
+hazcat_be_take(be_endpoint_t * ep, void * header, size_t header_size, void * msg, size_t size)
+{
+  be_ring_t * ring = ep->ring;
+  uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+  while (ep->next < head) {
+    skip_lapped(ep, head);
+
+    be_slot_t * slot = get_slot(ring, ep->next);
+    uint64_t expected = 2 * ep->next + 2;
+    uint64_t stamp = __atomic_load_n(&slot->stamp, __ATOMIC_ACQUIRE);
+    if (stamp < expected) {
+      // Still being written
+      return false;
+    }
+    if (stamp == expected) {
+      uint64_t len = slot->len - header_size;
+      memcpy(header, slot + 1, header_size);
+      memcpy(msg, (uint8_t *)(slot + 1) + header_size, (len < size) ? len : size);
+      __atomic_thread_fence(__ATOMIC_ACQUIRE);
+      if (__atomic_load_n(&slot->stamp, __ATOMIC_RELAXED) == expected) {
+        ep->next++;
+        return true;
+      }
+    }
+    // Overwritten by a later lap, before or while it was copied
+    ep->lost++;
+    ep->next++;
+    head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+  }
+  return false;
+}
+
+bool
+hazcat_be_ready(be_endpoint_t * ep)
+{
+  char buffer[16];
+  while (0 < recv(ep->sock, buffer, sizeof(buffer), MSG_DONTWAIT)) {}
+  uint64_t head = __atomic_load_n(&ep->ring->head, __ATOMIC_ACQUIRE);
+  if (ep->next < head) {
+    skip_lapped(ep, head);
+  }
+  return ep->next < head;
+}
+
+void
+hazcat_be_arm(be_endpoint_t * ep)
+{
+  be_reader_t * reader = &ep->ring->readers[ep->reader];
+  uint32_t active = READER_ACTIVE;
+  __atomic_compare_exchange_n(
+    &reader->state, &active, READER_WAITING, false, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED);
+  // Publishers that came before the state change didn't see it, but did move the head on
+  if (ep->next < __atomic_load_n(&ep->ring->head, __ATOMIC_SEQ_CST)) {
+    uint32_t waiting = READER_WAITING;
+    if (__atomic_compare_exchange_n(
+        &reader->state, &waiting, READER_ACTIVE, false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+    {
+      wake(ep->sock, reader);
+    }
+  }
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,440 @@
+// Copyright 2022 Washington University in St Louis
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "rcutils/allocator.h"
+#include "rmw/error_handling.h"
+
+#include "rosidl_typesupport_introspection_c/field_types.h"
+
+#include "rmw_hazcat/hazcat_filter.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+typedef struct filter_parser
+{
+  const char * p;
+  const rosidl_typesupport_introspection_c__MessageMembers * members;
+  const rcutils_string_array_t * params;
+  hazcat_filter_t * filter;
+} filter_parser_t;
+
+static int
+parse_or(filter_parser_t * parser);
+
+static void
+skip_space(filter_parser_t * parser)
+{
+  while (isspace((unsigned char)*parser->p)) {
+    parser->p++;
+  }
+}
+
+// Consumes keyword if it's next, as a whole word in any case
+static bool
+accept_keyword(filter_parser_t * parser, const char * keyword)
+{
+  skip_space(parser);
+  size_t len = strlen(keyword);
+  if (0 == strncasecmp(parser->p, keyword, len) &&
+    !isalnum((unsigned char)parser->p[len]) && '_' != parser->p[len])
+  {
+    parser->p += len;
+    return true;
+  }
+  return false;
+}
+
+static int
+add_node(filter_parser_t * parser, filter_kind_t kind, int left, int right)
+{
+  if (-1 == left || (FILTER_NOT != kind && FILTER_COMPARE != kind && -1 == right)) {
+    return -1;
+  }
+  hazcat_filter_t * filter = parser->filter;
+  if (FILTER_MAX_NODES == filter->count) {
+    RMW_SET_ERROR_MSG("Content filter expression is too long");
+    return -1;
+  }
+  filter_node_t * node = &filter->nodes[filter->count];
+  memset(node, 0, sizeof(*node));
+  node->kind = kind;
+  node->left = left;
+  node->right = right;
+  return filter->count++;
+}
+
+// Resolves a dotted field name to its offset and type, descending into nested messages
+static bool
+parse_field(filter_parser_t * parser, filter_node_t * node)
+{
+  const rosidl_typesupport_introspection_c__MessageMembers * members = parser->members;
+  uint32_t offset = 0;
+  while (true) {
+    skip_space(parser);
+    const char * name = parser->p;
+    while (isalnum((unsigned char)*parser->p) || '_' == *parser->p) {
+      parser->p++;
+    }
+    size_t len = parser->p - name;
+    if (0 == len) {
+      RMW_SET_ERROR_MSG("Expected field name in content filter expression");
+      return false;
+    }
+
+    const rosidl_typesupport_introspection_c__MessageMember * member = NULL;
+    for (uint32_t i = 0; i < members->member_count_; i++) {
+      if (strlen(members->members_[i].name_) == len &&
+        0 == strncmp(members->members_[i].name_, name, len))
+      {
+        member = &members->members_[i];
+      }
+    }
+    if (NULL == member) {
+      RMW_SET_ERROR_MSG_WITH_FORMAT_STRING(
+        "Content filter names unknown field '%.*s'", (int)len, name);
+      return false;
+    }
+    offset += member->offset_;
+
+    if ('.' != *parser->p) {
+      if (member->is_array_ ||
+        rosidl_typesupport_introspection_c__ROS_TYPE_MESSAGE == member->type_id_ ||
+        rosidl_typesupport_introspection_c__ROS_TYPE_STRING == member->type_id_ ||
+        rosidl_typesupport_introspection_c__ROS_TYPE_WSTRING == member->type_id_ ||
+        rosidl_typesupport_introspection_c__ROS_TYPE_LONG_DOUBLE == member->type_id_)
+      {
+        RMW_SET_ERROR_MSG_WITH_FORMAT_STRING(
+          "Content filter can't compare field '%.*s', only primitive fields", (int)len, name);
+        return false;
+      }
+      node->offset = offset;
+      node->type_id = member->type_id_;
+      return true;
+    }
+    if (member->is_array_ || rosidl_typesupport_introspection_c__ROS_TYPE_MESSAGE !=
+      member->type_id_)
+    {
+      RMW_SET_ERROR_MSG_WITH_FORMAT_STRING(
+        "Content filter field '%.*s' has no members", (int)len, name);
+      return false;
+    }
+    members = (const rosidl_typesupport_introspection_c__MessageMembers *)member->members_->data;
+    parser->p++;
+  }
+}
+
+static bool
+is_floating(uint8_t type_id)
+{
+  return rosidl_typesupport_introspection_c__ROS_TYPE_FLOAT == type_id ||
+         rosidl_typesupport_introspection_c__ROS_TYPE_DOUBLE == type_id;
+}
+
+static bool
+is_signed(uint8_t type_id)
+{
+  switch (type_id) {
+    case rosidl_typesupport_introspection_c__ROS_TYPE_INT8:
+    case rosidl_typesupport_introspection_c__ROS_TYPE_INT16:
+    case rosidl_typesupport_introspection_c__ROS_TYPE_INT32:
+    case rosidl_typesupport_introspection_c__ROS_TYPE_INT64:
+      return true;
+    default:
+      return false;
+  }
+}
+
+// Parses a literal, or the parameter standing in for one, into the value a field is compared to
+static bool
+parse_value(filter_parser_t * parser, filter_node_t * node)
+{
+  skip_space(parser);
+  const char * text = parser->p;
+  if ('%' == *parser->p) {
+    char * end;
+    long index = strtol(parser->p + 1, &end, 10);
+    if (end == parser->p + 1 || index < 0 || (size_t)index >= parser->params->size) {
+      RMW_SET_ERROR_MSG("Content filter refers to a missing parameter");
+      return false;
+    }
+    parser->p = end;
+    text = parser->params->data[index];
+    while (isspace((unsigned char)*text)) {
+      text++;
+    }
+  }
+
+  const char * end;
+  node->as_double = is_floating(node->type_id);
+  if (0 == strncasecmp(text, "TRUE", 4) || 0 == strncasecmp(text, "FALSE", 5)) {
+    bool is_true = 0 == strncasecmp(text, "TRUE", 4);
+    if (node->as_double) {
+      node->value.d = is_true;
+    } else {
+      node->value.u = is_true;    // Same bits as value.i
+    }
+    end = text + (is_true ? 4 : 5);
+  } else {
+    char * num_end;
+    double d = strtod(text, &num_end);
+    if (num_end == text) {
+      RMW_SET_ERROR_MSG("Content filter can only compare fields to numbers and booleans");
+      return false;
+    }
+    end = num_end;
+    // Integer fields compared to a fraction are compared as floating point
+    for (const char * c = text; c < end && !node->as_double; c++) {
+      node->as_double = '.' == *c || (('e' == *c || 'E' == *c) && 'x' != tolower(text[1]));
+    }
+    if (node->as_double) {
+      node->value.d = d;
+    } else if (is_signed(node->type_id)) {
+      node->value.i = strtoll(text, NULL, 0);
+    } else {
+      node->value.u = strtoull(text, NULL, 0);
+    }
+  }
+
+  if (text == parser->p) {
+    parser->p = end;
+  }
+  return true;
+}
+
+static bool
+parse_op(filter_parser_t * parser, filter_node_t * node)
+{
+  static const struct
+  {
+    const char * token;
+    filter_op_t op;
+  } ops[] = {
+    {"<>", FILTER_NE}, {"!=", FILTER_NE}, {"<=", FILTER_LE}, {">=", FILTER_GE},
+    {"==", FILTER_EQ}, {"=", FILTER_EQ}, {"<", FILTER_LT}, {">", FILTER_GT},
+  };
+  skip_space(parser);
+  for (size_t i = 0; i < sizeof(ops) / sizeof(ops[0]); i++) {
+    size_t len = strlen(ops[i].token);
+    if (0 == strncmp(parser->p, ops[i].token, len)) {
+      node->op = ops[i].op;
+      parser->p += len;
+      return true;
+    }
+  }
+  RMW_SET_ERROR_MSG("Expected comparison operator in content filter expression");
+  return false;
+}
+
+static int
+parse_primary(filter_parser_t * parser)
+{
+  if (accept_keyword(parser, "NOT")) {
+    return add_node(parser, FILTER_NOT, parse_primary(parser), -1);
+  }
+  skip_space(parser);
+  if ('(' == *parser->p) {
+    parser->p++;
+    int inner = parse_or(parser);
+    skip_space(parser);
+    if (-1 == inner || ')' != *parser->p) {
+      if (-1 != inner) {
+        RMW_SET_ERROR_MSG("Unbalanced parentheses in content filter expression");
+      }
+      return -1;
+    }
+    parser->p++;
+    return inner;
+  }
+
+  int index = add_node(parser, FILTER_COMPARE, 0, -1);
+  if (-1 == index) {
+    return -1;
+  }
+  filter_node_t * node = &parser->filter->nodes[index];
+  if (!parse_field(parser, node) || !parse_op(parser, node) || !parse_value(parser, node)) {
+    return -1;
+  }
+  return index;
+}
+
+static int
+parse_and(filter_parser_t * parser)
+{
+  int left = parse_primary(parser);
+  while (-1 != left && accept_keyword(parser, "AND")) {
+    left = add_node(parser, FILTER_AND, left, parse_primary(parser));
+  }
+  return left;
+}
+
+static int
+parse_or(filter_parser_t * parser)
+{
+  int left = parse_and(parser);
+  while (-1 != left && accept_keyword(parser, "OR")) {
+    left = add_node(parser, FILTER_OR, left, parse_and(parser));
+  }
+  return left;
+}
+
+rmw_ret_t
+hazcat_filter_init(
+  hazcat_filter_t * filter,
+  const rosidl_typesupport_introspection_c__MessageMembers * members,
+  const rmw_subscription_content_filter_options_t * options)
+{
+  RCUTILS_CHECK_ARGUMENT_FOR_NULL(filter, RMW_RET_INVALID_ARGUMENT);
+  RCUTILS_CHECK_ARGUMENT_FOR_NULL(members, RMW_RET_INVALID_ARGUMENT);
+  RCUTILS_CHECK_ARGUMENT_FOR_NULL(options, RMW_RET_INVALID_ARGUMENT);
+  RCUTILS_CHECK_ARGUMENT_FOR_NULL(options->filter_expression, RMW_RET_INVALID_ARGUMENT);
+
+  filter->count = 0;
+  filter_parser_t parser = {options->filter_expression, members, &options->expression_parameters,
+    filter};
+  filter->root = parse_or(&parser);
+  skip_space(&parser);
+  if (-1 == filter->root) {
+    return RMW_RET_INVALID_ARGUMENT;
+  }
+  if ('\0' != *parser.p) {
+    RMW_SET_ERROR_MSG("Unexpected text at end of content filter expression");
+    return RMW_RET_INVALID_ARGUMENT;
+  }
+
+  rcutils_allocator_t allocator = rcutils_get_default_allocator();
+  filter->options = rmw_get_zero_initialized_content_filter_options();
+  return rmw_subscription_content_filter_options_copy(options, &allocator, &filter->options);
+}
+
+void
+hazcat_filter_fini(hazcat_filter_t * filter)
+{
+  rcutils_allocator_t allocator = rcutils_get_default_allocator();
+  rmw_subscription_content_filter_options_fini(&filter->options, &allocator);
+}
+
+// Loads a field as the type it's compared as
+#define LOAD_FIELD(node, msg, type) \
+  (*(const type *)((const uint8_t *)(msg) + (node)->offset))
+
+static int64_t
+load_signed(const filter_node_t * node, const void * msg)
+{
+  switch (node->type_id) {
+    case rosidl_typesupport_introspection_c__ROS_TYPE_INT8:
+      return LOAD_FIELD(node, msg, int8_t);
+    case rosidl_typesupport_introspection_c__ROS_TYPE_INT16:
+      return LOAD_FIELD(node, msg, int16_t);
+    case rosidl_typesupport_introspection_c__ROS_TYPE_INT32:
+      return LOAD_FIELD(node, msg, int32_t);
+    default:
+      return LOAD_FIELD(node, msg, int64_t);
+  }
+}
+
+// Booleans, chars and octets count as unsigned
+static uint64_t
+load_unsigned(const filter_node_t * node, const void * msg)
+{
+  switch (node->type_id) {
+    case rosidl_typesupport_introspection_c__ROS_TYPE_UINT16:
+      return LOAD_FIELD(node, msg, uint16_t);
+    case rosidl_typesupport_introspection_c__ROS_TYPE_WCHAR:
+    case rosidl_typesupport_introspection_c__ROS_TYPE_UINT32:
+      return LOAD_FIELD(node, msg, uint32_t);
+    case rosidl_typesupport_introspection_c__ROS_TYPE_UINT64:
+      return LOAD_FIELD(node, msg, uint64_t);
+    default:
+      return LOAD_FIELD(node, msg, uint8_t);
+  }
+}
+
+static double
+load_double(const filter_node_t * node, const void * msg)
+{
+  switch (node->type_id) {
+    case rosidl_typesupport_introspection_c__ROS_TYPE_FLOAT:
+      return LOAD_FIELD(node, msg, float);
+    case rosidl_typesupport_introspection_c__ROS_TYPE_DOUBLE:
+      return LOAD_FIELD(node, msg, double);
+    default:
+      return is_signed(node->type_id) ? (double)load_signed(node, msg) : 0;
+  }
+}
+
+static int
+compare(const filter_node_t * node, const void * msg)
+{
+  if (node->as_double) {
+    double field = is_signed(node->type_id) || is_floating(node->type_id) ?
+      load_double(node, msg) : (double)load_unsigned(node, msg);
+    return (field > node->value.d) - (field < node->value.d);
+  }
+  if (is_signed(node->type_id)) {
+    int64_t field = load_signed(node, msg);
+    return (field > node->value.i) - (field < node->value.i);
+  }
+  uint64_t field = load_unsigned(node, msg);
+  return (field > node->value.u) - (field < node->value.u);
+}
+
+static bool
+evaluate(const hazcat_filter_t * filter, int index, const void * msg)
+{
+  const filter_node_t * node = &filter->nodes[index];
+  switch (node->kind) {
+    case FILTER_AND:
+      return evaluate(filter, node->left, msg) && evaluate(filter, node->right, msg);
+    case FILTER_OR:
+      return evaluate(filter, node->left, msg) || evaluate(filter, node->right, msg);
+    case FILTER_NOT:
+      return !evaluate(filter, node->left, msg);
+    default:
+      break;
+  }
+
+  int order = compare(node, msg);
+  switch (node->op) {
+    case FILTER_EQ:
+      return 0 == order;
+    case FILTER_NE:
+      return 0 != order;
+    case FILTER_LT:
+      return order < 0;
+    case FILTER_LE:
+      return order <= 0;
+    case FILTER_GT:
+      return order > 0;
+    default:
+      return order >= 0;
+  }
+}
+
+bool
+hazcat_filter_matches(const hazcat_filter_t * filter, const void * msg)
+{
+  return evaluate(filter, filter->root, msg);
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,182 @@
+// Copyright 2022 Washington University in St Louis
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include "rcutils/time.h"
+#include "rmw/error_handling.h"
+
+#include "rmw_hazcat/hazcat_qos.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// Seconds of RMW_DURATION_INFINITE, anything this long never runs out
+#define INFINITE_SEC  9223372036ull
+
+int64_t
+hazcat_qos_duration(rmw_time_t duration)
+{
+  if (duration.sec >= INFINITE_SEC) {
+    return 0;
+  }
+  return (int64_t)duration.sec * 1000000000 + (int64_t)duration.nsec;
+}
+
+// Reads the last message time and the periods missed up to it as of the same message
+static void
+deadline_read(const deadline_t * deadline, int64_t * last, int32_t * missed)
+{
+  uint32_t seq;
+  do {
+    seq = __atomic_load_n(&deadline->seq, __ATOMIC_ACQUIRE);
+    *last = __atomic_load_n(&deadline->last, __ATOMIC_RELAXED);
+    *missed = __atomic_load_n(&deadline->missed, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  } while ((seq & 1) || seq != __atomic_load_n(&deadline->seq, __ATOMIC_RELAXED));
+}
+
+rmw_ret_t
+hazcat_deadline_init(deadline_t * deadline, rmw_time_t period)
+{
+  deadline->period = hazcat_qos_duration(period);
+  rcutils_steady_time_now(&deadline->last);
+  deadline->missed = 0;
+  deadline->reported = 0;
+  deadline->seq = 0;
+  deadline->timer = -1;
+  if (0 != deadline->period) {
+    // Steady time is CLOCK_MONOTONIC, so the timer can be set in the same terms
+    deadline->timer = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (-1 == deadline->timer) {
+      RMW_SET_ERROR_MSG("Unable to create deadline timer");
+      return RMW_RET_ERROR;
+    }
+  }
+  return RMW_RET_OK;
+}
+
+void
+hazcat_deadline_fini(deadline_t * deadline)
+{
+  if (-1 != deadline->timer) {
+    close(deadline->timer);
+    deadline->timer = -1;
+  }
+}
+
+void
+hazcat_deadline_arm(deadline_t * deadline)
+{
+  if (-1 == deadline->timer) {
+    return;
+  }
+  int64_t last;
+  int32_t missed;
+  deadline_read(deadline, &last, &missed);
+  rcutils_time_point_value_t now;
+  rcutils_steady_time_now(&now);
+  int64_t next = last + ((now - last) / deadline->period + 1) * deadline->period;
+  struct itimerspec spec = {
+    .it_interval = {0, 0},
+    .it_value = {next / 1000000000, next % 1000000000}
+  };
+  timerfd_settime(deadline->timer, TFD_TIMER_ABSTIME, &spec, NULL);
+}
+
+void
+hazcat_deadline_message(deadline_t * deadline, rmw_time_point_value_t source_timestamp)
+{
+  if (0 == deadline->period) {
+    return;
+  }
+  // Source timestamps are system time, which could jump, so only the message's age is taken from
+  // them. A subscription taking a message late then still counts it from when it was sent
+  rcutils_time_point_value_t now;
+  rcutils_time_point_value_t system_now;
+  rcutils_steady_time_now(&now);
+  rcutils_system_time_now(&system_now);
+  int64_t sent = now - ((system_now > source_timestamp) ? system_now - source_timestamp : 0);
+
+  uint32_t seq;
+  do {
+    seq = __atomic_load_n(&deadline->seq, __ATOMIC_RELAXED) & ~1u;
+  } while (!__atomic_compare_exchange_n(
+      &deadline->seq, &seq, seq + 1, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED));
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  int64_t last = __atomic_load_n(&deadline->last, __ATOMIC_RELAXED);
+  if (sent > last) {
+    int32_t missed = __atomic_load_n(&deadline->missed, __ATOMIC_RELAXED) +
+      (sent - last) / deadline->period;
+    __atomic_store_n(&deadline->missed, missed, __ATOMIC_RELAXED);
+    __atomic_store_n(&deadline->last, sent, __ATOMIC_RELAXED);
+  }
+  __atomic_store_n(&deadline->seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+int32_t
+hazcat_deadline_missed(const deadline_t * deadline)
+{
+  if (0 == deadline->period) {
+    return 0;
+  }
+  int64_t last;
+  int32_t missed;
+  deadline_read(deadline, &last, &missed);
+  rcutils_time_point_value_t now;
+  rcutils_steady_time_now(&now);
+  return missed + (now - last) / deadline->period;
+}
+
+bool
+hazcat_deadline_pending(const deadline_t * deadline)
+{
+  return hazcat_deadline_missed(deadline) > __atomic_load_n(&deadline->reported, __ATOMIC_RELAXED);
+}
+
+void
+hazcat_deadline_take(deadline_t * deadline, int32_t * total, int32_t * change)
+{
+  *total = hazcat_deadline_missed(deadline);
+  *change = *total - __atomic_exchange_n(&deadline->reported, *total, __ATOMIC_RELAXED);
+}
+
+rmw_qos_policy_kind_t
+hazcat_qos_incompatibility(const rmw_qos_profile_t * pub, const rmw_qos_profile_t * sub)
+{
+  if (RMW_QOS_POLICY_RELIABILITY_BEST_EFFORT == pub->reliability &&
+    RMW_QOS_POLICY_RELIABILITY_RELIABLE == sub->reliability)
+  {
+    return RMW_QOS_POLICY_RELIABILITY;
+  }
+  if (RMW_QOS_POLICY_DURABILITY_VOLATILE == pub->durability &&
+    RMW_QOS_POLICY_DURABILITY_TRANSIENT_LOCAL == sub->durability)
+  {
+    return RMW_QOS_POLICY_DURABILITY;
+  }
+  // Publishers have to offer a deadline at least as short as the one requested
+  int64_t offered = hazcat_qos_duration(pub->deadline);
+  int64_t requested = hazcat_qos_duration(sub->deadline);
+  if (0 != requested && (0 == offered || offered > requested)) {
+    return RMW_QOS_POLICY_DEADLINE;
+  }
+  return RMW_QOS_POLICY_INVALID;
+}
+
+#ifdef __cplusplus
+}
+#endif
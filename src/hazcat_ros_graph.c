@@ -12,11 +12,1307 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <linux/futex.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/shm.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "rcutils/strdup.h"
+
+#include "rmw/error_handling.h"
+#include "rmw/rmw.h"
+
+#include "hazcat_allocators/cpu_ringbuf_allocator.h"
+
+#include "rmw_hazcat/hazcat_alloc.h"
+#include "rmw_hazcat/hazcat_mq.h"
+#include "rmw_hazcat/hazcat_qos.h"
+#include "rmw_hazcat/hazcat_ros_graph.h"
+#include "rmw_hazcat/hazcat_segment.h"
+
 #ifdef __cplusplus
 extern "C"
 {
 #endif
 
+// How long to wait on another process to finish initializing the graph segment, in milliseconds
+#define GRAPH_INIT_TIMEOUT  1000
+
+// Decrements an integer in shared memory unless it's already zero, evaluating to the new value
+#define SATURATING_DECREMENT(ptr) \
+  __extension__ ({ \
+    __typeof__(*(ptr)) old_ = __atomic_load_n(ptr, __ATOMIC_RELAXED); \
+    while (old_ > 0 && !__atomic_compare_exchange_n( \
+      ptr, &old_, old_ - 1, false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {} \
+    (old_ > 0) ? old_ - 1 : 0; \
+  })
+
+// Upper bound on how long the watcher thread takes to notice it should exit, in nanoseconds
+#define WATCHER_POLL_PERIOD 100000000
+
+// Least time between scans for dead processes, and between the ones that also read /proc to catch
+// pids reused since, in nanoseconds. Publishers call reclaim on every failed allocation or timeout
+#define RECLAIM_PERIOD        10000000
+#define RECLAIM_REUSE_PERIOD  1000000000
+
+typedef struct name_type_pair
+{
+  char name[GRAPH_NAME_LEN];
+  char type[GRAPH_NAME_LEN];
+} name_type_pair_t;
+
+typedef struct endpoint_info
+{
+  char node_name[GRAPH_NAME_LEN];
+  char node_namespace[GRAPH_NAME_LEN];
+  char type[GRAPH_NAME_LEN];
+  uint8_t gid[RMW_GID_STORAGE_SIZE];
+  rmw_qos_profile_t qos;
+} endpoint_info_t;
+
+typedef struct node_names
+{
+  char name[GRAPH_NAME_LEN];
+  char namespace_[GRAPH_NAME_LEN];
+  char enclave[GRAPH_NAME_LEN];
+} node_names_t;
+
+ros_graph_t * graph = NULL;
+int graph_fd = -1;
+int graph_refs = 0;   // Number of contexts in this process using the graph
+pthread_mutex_t graph_init_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// Graph guard conditions of nodes in this process, indexed by node id
+const rmw_guard_condition_t * graph_guards[GRAPH_MAX_NODES];
+pthread_mutex_t graph_guards_lock = PTHREAD_MUTEX_INITIALIZER;
+pthread_t watcher;
+bool watcher_stop = false;
+
+// Strings read under the seqlock may be torn, so always terminate them
+static inline void
+copy_name(char * dst, const char * src)
+{
+  strncpy(dst, src, GRAPH_NAME_LEN - 1);
+  dst[GRAPH_NAME_LEN - 1] = '\0';
+}
+
+static void
+graph_write_begin()
+{
+  uint32_t seq = __atomic_load_n(&graph->seq, __ATOMIC_RELAXED);
+  if (EOWNERDEAD == pthread_mutex_lock(&graph->lock)) {
+    // Previous writer died mid-update. Entries it half wrote are either finished or reused later,
+    // but the sequence number must be made even again or readers would spin forever
+    pthread_mutex_consistent(&graph->lock);
+    seq = __atomic_load_n(&graph->seq, __ATOMIC_RELAXED);
+    seq += seq & 1;
+  } else {
+    seq = __atomic_load_n(&graph->seq, __ATOMIC_RELAXED);
+  }
+  __atomic_store_n(&graph->seq, seq + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static void
+graph_write_end()
+{
+  __atomic_store_n(&graph->seq, graph->seq + 1, __ATOMIC_RELEASE);
+  __atomic_add_fetch(&graph->epoch, 1, __ATOMIC_RELEASE);
+  pthread_mutex_unlock(&graph->lock);
+  syscall(SYS_futex, &graph->epoch, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+}
+
+// Sleeps on the graph epoch, triggering every local graph guard condition each time it moves
+static void *
+graph_watcher(void * arg)
+{
+  (void)arg;
+  struct timespec timeout = {.tv_sec = 0, .tv_nsec = WATCHER_POLL_PERIOD};
+  uint32_t seen = __atomic_load_n(&graph->epoch, __ATOMIC_ACQUIRE);
+  while (!__atomic_load_n(&watcher_stop, __ATOMIC_ACQUIRE)) {
+    syscall(SYS_futex, &graph->epoch, FUTEX_WAIT, seen, &timeout, NULL, 0);
+    uint32_t epoch = __atomic_load_n(&graph->epoch, __ATOMIC_ACQUIRE);
+    if (epoch == seen) {
+      continue;
+    }
+    seen = epoch;
+
+    pthread_mutex_lock(&graph_guards_lock);
+    for (int i = 0; i < GRAPH_MAX_NODES; i++) {
+      if (NULL != graph_guards[i]) {
+        rmw_trigger_guard_condition(graph_guards[i]);
+      }
+    }
+    pthread_mutex_unlock(&graph_guards_lock);
+  }
+  return NULL;
+}
+
+static uint32_t
+graph_read_begin()
+{
+  uint32_t seq;
+  while ((seq = __atomic_load_n(&graph->seq, __ATOMIC_ACQUIRE)) & 1) {
+    sched_yield();
+  }
+  return seq;
+}
+
+// Returns true if a writer intervened and whatever was read must be discarded
+static bool
+graph_read_retry(uint32_t seq)
+{
+  __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  return seq != __atomic_load_n(&graph->seq, __ATOMIC_RELAXED);
+}
+
+static bool
+node_matches(int node_id, const char * node_name, const char * node_namespace)
+{
+  if (node_id < 0 || node_id >= GRAPH_MAX_NODES || !graph->nodes[node_id].in_use) {
+    return false;
+  }
+  return 0 == strncmp(graph->nodes[node_id].name, node_name, GRAPH_NAME_LEN) &&
+         0 == strncmp(graph->nodes[node_id].namespace_, node_namespace, GRAPH_NAME_LEN);
+}
+
+static int
+compare_pairs(const void * a, const void * b)
+{
+  const name_type_pair_t * pa = (const name_type_pair_t *)a;
+  const name_type_pair_t * pb = (const name_type_pair_t *)b;
+  int ret = strcmp(pa->name, pb->name);
+  return (0 != ret) ? ret : strcmp(pa->type, pb->type);
+}
+
+// Start time of a process in clock ticks since boot, or 0 if it can't be read
+static uint64_t
+process_start_time(pid_t pid)
+{
+  char path[32];
+  snprintf(path, sizeof(path), "/proc/%d/stat", (int)pid);
+  FILE * f = fopen(path, "r");
+  if (NULL == f) {
+    return 0;
+  }
+  char buf[1024];
+  size_t len = fread(buf, 1, sizeof(buf) - 1, f);
+  fclose(f);
+  buf[len] = '\0';
+
+  // Command name may contain spaces itself, so count fields from the ')' closing it. The field
+  // after it is the 3rd, and start time is the 22nd
+  char * c = strrchr(buf, ')');
+  for (int field = 2; field < 22 && NULL != c; field++) {
+    c = strchr(c + 1, ' ');
+  }
+  return (NULL == c) ? 0 : strtoull(c + 1, NULL, 10);
+}
+
+// Whether a node's process is alive. Without check_reuse, only whether its pid is still taken
+static bool
+process_alive(pid_t pid, uint64_t start_time, bool check_reuse)
+{
+  if (0 != kill(pid, 0) && ESRCH == errno) {
+    return false;
+  }
+  if (!check_reuse) {
+    return true;
+  }
+  // Pid exists, but may have been reused by another process. Trust kill() if /proc is unavailable
+  uint64_t current = process_start_time(pid);
+  return 0 == start_time || 0 == current || start_time == current;
+}
+
+// Does for a dead subscription what it would have done had it taken every message it was still
+// interested in, then returned it: drop its interest in the slot and deallocate its copy
+static void
+release_interest(message_queue_t * mq, const graph_endpoint_t * ep)
+{
+  int domain = hazcat_mq_domain_index(mq, ep->domain);
+
+  // Everything from the cursor up to the write index was published while the subscription was
+  // registered, and at most a full lap of the queue can be outstanding
+  uint32_t len = mq->len;
+  uint32_t index = __atomic_load_n(&mq->index, __ATOMIC_ACQUIRE);
+  uint32_t cursor = ep->cursor;
+  uint32_t outstanding = (index >= cursor) ? index - cursor : index + len - cursor;
+  if (outstanding > len) {
+    outstanding = len;
+  }
+
+  for (uint32_t k = 0; k < outstanding; k++) {
+    int i = (cursor + k) % len;
+    ref_bits_t * bits = hazcat_mq_ref_bits(mq, i);
+    hazcat_mq_slot_lock(bits);
+    if (0 == bits->interest_count) {
+      hazcat_mq_slot_unlock(bits);
+      continue;
+    }
+    if (-1 != domain && (bits->availability & (1 << domain))) {
+      hazcat_share_entry(hazcat_mq_entry(mq, domain, i), NULL, -1);
+    }
+    if (0 == --bits->interest_count) {
+      bits->availability = 0;
+    }
+    hazcat_mq_slot_unlock(bits);
+  }
+}
+
+// TRANSIENT_LOCAL publishers are registered on their message queue as a subscription too
+static bool
+retains(const graph_endpoint_t * ep)
+{
+  return GRAPH_PUBLISHER == ep->kind &&
+         RMW_QOS_POLICY_DURABILITY_TRANSIENT_LOCAL == ep->qos.durability;
+}
+
+// Undoes a dead publisher's or subscription's registration on its message queue
+static void
+reclaim_endpoint(const graph_endpoint_t * ep)
+{
+  char file_name[GRAPH_NAME_LEN + 16];
+  hazcat_mq_file_name(ep->topic, file_name, sizeof(file_name));
+  int fd = shm_open(file_name, O_RDWR, 0);
+  if (-1 == fd) {
+    return;
+  }
+  struct stat st;
+  if (-1 == fstat(fd, &st) || st.st_size < (off_t)sizeof(message_queue_t)) {
+    close(fd);
+    return;
+  }
+  message_queue_t * mq = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (MAP_FAILED == mq) {
+    return;
+  }
+
+  if (GRAPH_PUBLISHER == ep->kind) {
+    SATURATING_DECREMENT(&mq->pub_count);
+  }
+  if (GRAPH_SUBSCRIPTION == ep->kind || retains(ep)) {
+    hazcat_graph_topic_depart(&graph->topics[ep->topic_id]);
+    SATURATING_DECREMENT(&mq->sub_count);
+    if ((size_t)st.st_size >= hazcat_mq_size(mq->len, mq->num_domains)) {
+      release_interest(mq, ep);
+    }
+  }
+  munmap(mq, st.st_size);
+}
+
+// Finds or claims the topic slot for an endpoint on topic, returns -1 if the table is full
+static int
+acquire_topic(const char * topic)
+{
+  int free_slot = -1;
+  for (int t = 0; t < graph->topic_count; t++) {
+    graph_topic_t * it = &graph->topics[t];
+    if (0 == it->refs) {
+      free_slot = (-1 == free_slot) ? t : free_slot;
+    } else if (0 == strncmp(it->name, topic, GRAPH_NAME_LEN)) {
+      it->refs++;
+      return t;
+    }
+  }
+  if (-1 == free_slot) {
+    if (GRAPH_MAX_TOPICS == graph->topic_count) {
+      return -1;
+    }
+    free_slot = graph->topic_count++;
+  }
+
+  graph_topic_t * it = &graph->topics[free_slot];
+  copy_name(it->name, topic);
+  __atomic_store_n(&it->waiters, 0, __ATOMIC_RELAXED);
+  __atomic_store_n(&it->retainers, 0, __ATOMIC_RELAXED);
+  it->publishers = 0;
+  it->subscriptions = 0;
+  it->refcounted = 0;
+  __atomic_store_n(&it->departed, 0, __ATOMIC_RELAXED);
+  it->refs = 1;
+  return free_slot;
+}
+
+// Drops an endpoint's reference on its topic slot
+static void
+release_endpoint(graph_endpoint_t * ep)
+{
+  if (-1 != ep->topic_id && graph->topics[ep->topic_id].refs > 0) {
+    graph_topic_t * topic = &graph->topics[ep->topic_id];
+    topic->refs--;
+    if (GRAPH_PUBLISHER == ep->kind) {
+      SATURATING_DECREMENT(&topic->publishers);
+    } else {
+      SATURATING_DECREMENT(&topic->subscriptions);
+    }
+    if (ep->refcounted) {
+      SATURATING_DECREMENT(&topic->refcounted);
+    }
+    if (retains(ep)) {
+      SATURATING_DECREMENT(&topic->retainers);
+    }
+  }
+  ep->in_use = 0;
+}
+
+// Records a pair of publisher and subscription that don't match on both of them
+static void
+check_compatible(graph_endpoint_t * a, graph_endpoint_t * b)
+{
+  if (a->kind == b->kind || a->topic_id != b->topic_id) {
+    return;
+  }
+  graph_endpoint_t * pub = (GRAPH_PUBLISHER == a->kind) ? a : b;
+  graph_endpoint_t * sub = (GRAPH_PUBLISHER == a->kind) ? b : a;
+  rmw_qos_policy_kind_t policy = hazcat_qos_incompatibility(&pub->qos, &sub->qos);
+  if (RMW_QOS_POLICY_INVALID == policy) {
+    return;
+  }
+  for (graph_endpoint_t * ep = a; NULL != ep; ep = (ep == a) ? b : NULL) {
+    __atomic_store_n(&ep->incompatible_policy, policy, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&ep->incompatible, 1, __ATOMIC_RELEASE);
+  }
+}
+
+// Lowers high water marks past any trailing unused entries
+static void
+graph_trim()
+{
+  while (graph->node_count > 0 && !graph->nodes[graph->node_count - 1].in_use) {
+    graph->node_count--;
+  }
+  while (graph->endpoint_count > 0 && !graph->endpoints[graph->endpoint_count - 1].in_use) {
+    graph->endpoint_count--;
+  }
+  while (graph->topic_count > 0 && 0 == graph->topics[graph->topic_count - 1].refs) {
+    graph->topic_count--;
+  }
+}
+
+static void
+unmap_graph()
+{
+  hazcat_segment_unlock(graph);
+  munmap(graph, sizeof(ros_graph_t));
+}
+
+// Unlinks the graph file if it's still the one fd refers to, so the next process to open it
+// creates a fresh one rather than also unlinking the replacement
+static void
+unlink_stale_graph(int fd)
+{
+  int cur_fd = shm_open(GRAPH_FILE_NAME, O_RDONLY, 0);
+  if (-1 == cur_fd) {
+    return;
+  }
+  struct stat st;
+  struct stat cur;
+  if (0 == fstat(fd, &st) && 0 == fstat(cur_fd, &cur) && st.st_ino == cur.st_ino) {
+    shm_unlink(GRAPH_FILE_NAME);
+  }
+  close(cur_fd);
+}
+
+// Opens and maps the graph segment, initializing it if this process created it. Sets stale if the
+// segment was never finished by its creator or has another layout, having unlinked it
+static rmw_ret_t
+map_graph(bool * stale)
+{
+  *stale = false;
+
+  // Whoever creates the file initializes it, everyone else waits for that to finish
+  bool creator = true;
+  int fd = shm_open(GRAPH_FILE_NAME, O_CREAT | O_EXCL | O_RDWR, 0666);
+  if (-1 == fd && EEXIST == errno) {
+    creator = false;
+    fd = shm_open(GRAPH_FILE_NAME, O_RDWR, 0666);
+  }
+  if (-1 == fd) {
+    RMW_SET_ERROR_MSG("Unable to open ros graph file");
+    return RMW_RET_ERROR;
+  }
+
+  int wait = 0;
+  struct stat st;
+  if (creator) {
+    if (-1 == ftruncate(fd, sizeof(ros_graph_t))) {
+      RMW_SET_ERROR_MSG("Unable to resize ros graph file");
+      close(fd);
+      shm_unlink(GRAPH_FILE_NAME);
+      return RMW_RET_ERROR;
+    }
+  } else {
+    while (0 == fstat(fd, &st) && st.st_size < (off_t)sizeof(ros_graph_t) &&
+      wait++ < GRAPH_INIT_TIMEOUT)
+    {
+      usleep(1000);
+    }
+    // Touching the mapping past the end of the file would raise SIGBUS
+    if (-1 == fstat(fd, &st) || st.st_size < (off_t)sizeof(ros_graph_t)) {
+      RMW_SET_ERROR_MSG("ros graph file was never sized");
+      unlink_stale_graph(fd);
+      close(fd);
+      *stale = true;
+      return RMW_RET_ERROR;
+    }
+  }
+
+  graph = mmap(NULL, sizeof(ros_graph_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (MAP_FAILED == graph) {
+    RMW_SET_ERROR_MSG("Unable to map ros graph file");
+    graph = NULL;
+    close(fd);
+    return RMW_RET_ERROR;
+  }
+  // Locked here so rmw_init takes the page faults rather than the first graph update
+  int flags = hazcat_segment_default_flags();
+  if (RMW_RET_OK != hazcat_segment_advise(graph, sizeof(ros_graph_t), flags)) {
+    munmap(graph, sizeof(ros_graph_t));
+    graph = NULL;
+    close(fd);
+    return RMW_RET_ERROR;
+  }
+
+  if (creator) {
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+    pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+    pthread_mutex_init(&graph->lock, &attr);
+    pthread_mutexattr_destroy(&attr);
+    graph->version = GRAPH_VERSION;
+    __atomic_store_n(&graph->magic, GRAPH_MAGIC, __ATOMIC_RELEASE);
+  } else {
+    while (GRAPH_MAGIC != __atomic_load_n(&graph->magic, __ATOMIC_ACQUIRE) &&
+      wait++ < GRAPH_INIT_TIMEOUT)
+    {
+      usleep(1000);
+    }
+    if (GRAPH_MAGIC != __atomic_load_n(&graph->magic, __ATOMIC_ACQUIRE) ||
+      GRAPH_VERSION != graph->version)
+    {
+      RMW_SET_ERROR_MSG("ros graph file is half initialized or from another version");
+      unlink_stale_graph(fd);
+      unmap_graph();
+      graph = NULL;
+      close(fd);
+      *stale = true;
+      return RMW_RET_ERROR;
+    }
+  }
+
+  graph_fd = fd;
+  return RMW_RET_OK;
+}
+
+rmw_ret_t
+hazcat_graph_init()
+{
+  pthread_mutex_lock(&graph_init_lock);
+  if (graph_refs++ > 0) {
+    pthread_mutex_unlock(&graph_init_lock);
+    return RMW_RET_OK;
+  }
+
+  // Retried once, against the segment whoever first noticed the stale one created
+  bool stale;
+  rmw_ret_t ret = map_graph(&stale);
+  if (stale) {
+    rmw_reset_error();
+    ret = map_graph(&stale);
+  }
+  if (RMW_RET_OK != ret) {
+    graph_refs--;
+    pthread_mutex_unlock(&graph_init_lock);
+    return ret;
+  }
+
+  // Clean up after any processes that crashed since the graph was last used
+  hazcat_graph_reclaim();
+
+  __atomic_store_n(&watcher_stop, false, __ATOMIC_RELEASE);
+  if (0 != pthread_create(&watcher, NULL, graph_watcher, NULL)) {
+    RMW_SET_ERROR_MSG("Unable to start ros graph watcher thread");
+    unmap_graph();
+    graph = NULL;
+    close(graph_fd);
+    graph_fd = -1;
+    graph_refs--;
+    pthread_mutex_unlock(&graph_init_lock);
+    return RMW_RET_ERROR;
+  }
+
+  pthread_mutex_unlock(&graph_init_lock);
+  return RMW_RET_OK;
+}
+
+rmw_ret_t
+hazcat_graph_fini()
+{
+  pthread_mutex_lock(&graph_init_lock);
+  if (graph_refs <= 0 || --graph_refs > 0) {
+    pthread_mutex_unlock(&graph_init_lock);
+    return RMW_RET_OK;
+  }
+
+  // Waking everyone on the epoch is harmless, other processes' watchers see it unchanged
+  __atomic_store_n(&watcher_stop, true, __ATOMIC_RELEASE);
+  syscall(SYS_futex, &graph->epoch, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+  pthread_join(watcher, NULL);
+
+  // The segment itself is never unlinked, other processes on the host may still be using it
+  unmap_graph();
+  close(graph_fd);
+  graph = NULL;
+  graph_fd = -1;
+
+  pthread_mutex_unlock(&graph_init_lock);
+  return RMW_RET_OK;
+}
+
+rmw_ret_t
+hazcat_graph_register_node(
+  const char * name,
+  const char * namespace_,
+  const char * enclave,
+  const rmw_guard_condition_t * graph_guard,
+  int * graph_id)
+{
+  RCUTILS_CHECK_ARGUMENT_FOR_NULL(name, RMW_RET_INVALID_ARGUMENT);
+  RCUTILS_CHECK_ARGUMENT_FOR_NULL(namespace_, RMW_RET_INVALID_ARGUMENT);
+  RCUTILS_CHECK_ARGUMENT_FOR_NULL(graph_id, RMW_RET_INVALID_ARGUMENT);
+  if (NULL == graph) {
+    RMW_SET_ERROR_MSG("ros graph hasn't been initialized");
+    return RMW_RET_ERROR;
+  }
+
+  hazcat_graph_reclaim();
+
+  graph_write_begin();
+  int i = 0;
+  while (i < GRAPH_MAX_NODES && graph->nodes[i].in_use) {
+    i++;
+  }
+  if (GRAPH_MAX_NODES == i) {
+    graph_write_end();
+    RMW_SET_ERROR_MSG("Too many nodes in ros graph");
+    return RMW_RET_ERROR;
+  }
+
+  graph_node_t * n = &graph->nodes[i];
+  n->pid = getpid();
+  n->start_time = process_start_time(n->pid);
+  copy_name(n->name, name);
+  copy_name(n->namespace_, namespace_);
+  copy_name(n->enclave, (NULL == enclave) ? "" : enclave);
+  n->in_use = 1;
+  if (i >= graph->node_count) {
+    graph->node_count = i + 1;
+  }
+  pthread_mutex_lock(&graph_guards_lock);
+  graph_guards[i] = graph_guard;
+  pthread_mutex_unlock(&graph_guards_lock);
+  graph_write_end();
+
+  *graph_id = i;
+  return RMW_RET_OK;
+}
+
+rmw_ret_t
+hazcat_graph_unregister_node(int graph_id)
+{
+  if (graph_id < 0 || graph_id >= GRAPH_MAX_NODES) {
+    RMW_SET_ERROR_MSG("Invalid node id");
+    return RMW_RET_INVALID_ARGUMENT;
+  }
+  if (NULL == graph) {
+    RMW_SET_ERROR_MSG("ros graph hasn't been initialized");
+    return RMW_RET_ERROR;
+  }
+
+  pthread_mutex_lock(&graph_guards_lock);
+  graph_guards[graph_id] = NULL;
+  pthread_mutex_unlock(&graph_guards_lock);
+
+  graph_write_begin();
+  graph->nodes[graph_id].in_use = 0;
+  for (int i = 0; i < graph->endpoint_count; i++) {
+    if (graph->endpoints[i].in_use && graph->endpoints[i].node == graph_id) {
+      release_endpoint(&graph->endpoints[i]);
+    }
+  }
+  graph_trim();
+  graph_write_end();
+
+  return RMW_RET_OK;
+}
+
+rmw_ret_t
+hazcat_graph_register_endpoint(
+  int node_id,
+  graph_endpoint_kind_t kind,
+  const char * topic,
+  const char * type,
+  const rmw_gid_t * gid,
+  const rmw_qos_profile_t * qos,
+  uint32_t domain,
+  bool refcounted,
+  int * graph_id)
+{
+  RCUTILS_CHECK_ARGUMENT_FOR_NULL(topic, RMW_RET_INVALID_ARGUMENT);
+  RCUTILS_CHECK_ARGUMENT_FOR_NULL(type, RMW_RET_INVALID_ARGUMENT);
+  RCUTILS_CHECK_ARGUMENT_FOR_NULL(qos, RMW_RET_INVALID_ARGUMENT);
+  RCUTILS_CHECK_ARGUMENT_FOR_NULL(graph_id, RMW_RET_INVALID_ARGUMENT);
+  if (node_id < 0 || node_id >= GRAPH_MAX_NODES) {
+    RMW_SET_ERROR_MSG("Invalid node id");
+    return RMW_RET_INVALID_ARGUMENT;
+  }
+  if (NULL == graph) {
+    RMW_SET_ERROR_MSG("ros graph hasn't been initialized");
+    return RMW_RET_ERROR;
+  }
+
+  graph_write_begin();
+  int i = 0;
+  while (i < GRAPH_MAX_ENDPOINTS && graph->endpoints[i].in_use) {
+    i++;
+  }
+  if (GRAPH_MAX_ENDPOINTS == i) {
+    graph_write_end();
+    RMW_SET_ERROR_MSG("Too many endpoints in ros graph");
+    return RMW_RET_ERROR;
+  }
+
+  graph_endpoint_t * ep = &graph->endpoints[i];
+  ep->topic_id = -1;
+  if (kind & (GRAPH_PUBLISHER | GRAPH_SUBSCRIPTION)) {
+    ep->topic_id = acquire_topic(topic);
+    if (-1 == ep->topic_id) {
+      graph_write_end();
+      RMW_SET_ERROR_MSG("Too many topics in ros graph");
+      return RMW_RET_ERROR;
+    }
+  }
+  ep->kind = kind;
+  ep->node = node_id;
+  ep->domain = domain;
+  ep->refcounted = refcounted && -1 != ep->topic_id;
+  if (NULL == gid) {
+    memset(ep->gid, 0, RMW_GID_STORAGE_SIZE);
+  } else {
+    memcpy(ep->gid, gid->data, RMW_GID_STORAGE_SIZE);
+  }
+  ep->qos = *qos;
+  if (GRAPH_PUBLISHER == kind) {
+    graph->topics[ep->topic_id].publishers++;
+  } else if (GRAPH_SUBSCRIPTION == kind) {
+    graph->topics[ep->topic_id].subscriptions++;
+  }
+  if (retains(ep)) {
+    __atomic_add_fetch(&graph->topics[ep->topic_id].retainers, 1, __ATOMIC_RELAXED);
+  }
+  if (ep->refcounted) {
+    __atomic_add_fetch(&graph->topics[ep->topic_id].refcounted, 1, __ATOMIC_SEQ_CST);
+  }
+  copy_name(ep->topic, topic);
+  copy_name(ep->type, type);
+  ep->cursor = 0;
+  __atomic_store_n(&ep->lost, 0, __ATOMIC_RELAXED);
+  __atomic_store_n(&ep->incompatible, 0, __ATOMIC_RELAXED);
+  __atomic_store_n(&ep->incompatible_policy, RMW_QOS_POLICY_INVALID, __ATOMIC_RELAXED);
+  if (-1 != ep->topic_id) {
+    for (int j = 0; j < graph->endpoint_count; j++) {
+      if (graph->endpoints[j].in_use) {
+        check_compatible(ep, &graph->endpoints[j]);
+      }
+    }
+  }
+  ep->in_use = 1;
+  if (i >= graph->endpoint_count) {
+    graph->endpoint_count = i + 1;
+  }
+  graph_write_end();
+
+  *graph_id = i;
+  return RMW_RET_OK;
+}
+
+rmw_ret_t
+hazcat_graph_unregister_endpoint(int graph_id)
+{
+  if (graph_id < 0 || graph_id >= GRAPH_MAX_ENDPOINTS) {
+    RMW_SET_ERROR_MSG("Invalid endpoint id");
+    return RMW_RET_INVALID_ARGUMENT;
+  }
+  if (NULL == graph) {
+    RMW_SET_ERROR_MSG("ros graph hasn't been initialized");
+    return RMW_RET_ERROR;
+  }
+
+  graph_write_begin();
+  release_endpoint(&graph->endpoints[graph_id]);
+  graph_trim();
+  graph_write_end();
+
+  return RMW_RET_OK;
+}
+
+graph_topic_t *
+hazcat_graph_topic(int graph_id)
+{
+  if (NULL == graph || graph_id < 0 || graph_id >= GRAPH_MAX_ENDPOINTS ||
+    -1 == graph->endpoints[graph_id].topic_id)
+  {
+    return NULL;
+  }
+  return &graph->topics[graph->endpoints[graph_id].topic_id];
+}
+
+void
+hazcat_graph_topic_drained(graph_topic_t * topic)
+{
+  if (NULL == topic) {
+    return;
+  }
+  // Orders whatever was just freed up before the check for waiters. Waiters count themselves in
+  // before checking for room, so either this sees the waiter or the waiter sees the room
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  if (0 < __atomic_load_n(&topic->waiters, __ATOMIC_RELAXED)) {
+    __atomic_add_fetch(&topic->drained, 1, __ATOMIC_SEQ_CST);
+    syscall(SYS_futex, &topic->drained, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+  }
+}
+
+void
+hazcat_graph_topic_depart(graph_topic_t * topic)
+{
+  if (NULL != topic) {
+    __atomic_add_fetch(&topic->departed, 1, __ATOMIC_SEQ_CST);
+  }
+}
+
+uint32_t
+hazcat_graph_topic_departed(const graph_topic_t * topic)
+{
+  return (NULL == topic) ? 0 : __atomic_load_n(&topic->departed, __ATOMIC_SEQ_CST);
+}
+
+uint32_t
+hazcat_graph_topic_prepare_wait(graph_topic_t * topic)
+{
+  if (NULL == topic) {
+    return 0;
+  }
+  __atomic_add_fetch(&topic->waiters, 1, __ATOMIC_SEQ_CST);
+  return __atomic_load_n(&topic->drained, __ATOMIC_SEQ_CST);
+}
+
+void
+hazcat_graph_topic_cancel_wait(graph_topic_t * topic)
+{
+  if (NULL != topic) {
+    __atomic_sub_fetch(&topic->waiters, 1, __ATOMIC_RELEASE);
+  }
+}
+
+rmw_ret_t
+hazcat_graph_topic_wait(graph_topic_t * topic, uint32_t seen, int64_t timeout_ns)
+{
+  if (NULL == topic) {
+    return RMW_RET_TIMEOUT;
+  }
+  if (timeout_ns <= 0) {
+    hazcat_graph_topic_cancel_wait(topic);
+    return RMW_RET_TIMEOUT;
+  }
+  struct timespec timeout = {
+    .tv_sec = timeout_ns / 1000000000,
+    .tv_nsec = timeout_ns % 1000000000
+  };
+  long ret = syscall(SYS_futex, &topic->drained, FUTEX_WAIT, seen, &timeout, NULL, 0);
+  int err = errno;
+  hazcat_graph_topic_cancel_wait(topic);
+
+  return (-1 == ret && ETIMEDOUT == err) ? RMW_RET_TIMEOUT : RMW_RET_OK;
+}
+
+void
+hazcat_graph_topic_counts(const char * topic, size_t * publishers, size_t * subscriptions)
+{
+  size_t pubs = 0;
+  size_t subs = 0;
+  if (NULL != graph) {
+    uint32_t seq;
+    do {
+      seq = graph_read_begin();
+      pubs = 0;
+      subs = 0;
+      for (int t = 0; t < GRAPH_MAX_TOPICS && t < graph->topic_count; t++) {
+        graph_topic_t * it = &graph->topics[t];
+        if (0 != it->refs && 0 == strncmp(it->name, topic, GRAPH_NAME_LEN)) {
+          pubs = it->publishers;
+          subs = it->subscriptions;
+          break;
+        }
+      }
+    } while (graph_read_retry(seq));
+  }
+
+  if (NULL != publishers) {
+    *publishers = pubs;
+  }
+  if (NULL != subscriptions) {
+    *subscriptions = subs;
+  }
+}
+
+void
+hazcat_graph_set_cursor(int graph_id, uint32_t cursor)
+{
+  // Only read by reclamation, under the write lock, so no need to involve the seqlock
+  if (NULL != graph && graph_id >= 0 && graph_id < GRAPH_MAX_ENDPOINTS) {
+    __atomic_store_n(&graph->endpoints[graph_id].cursor, cursor, __ATOMIC_RELEASE);
+  }
+}
+
+uint32_t
+hazcat_graph_add_lost(int graph_id, uint32_t lost)
+{
+  if (NULL == graph || graph_id < 0 || graph_id >= GRAPH_MAX_ENDPOINTS) {
+    return 0;
+  }
+  return __atomic_add_fetch(&graph->endpoints[graph_id].lost, lost, __ATOMIC_RELAXED);
+}
+
+uint32_t
+hazcat_graph_incompatible(int graph_id, rmw_qos_policy_kind_t * last_policy)
+{
+  if (NULL == graph || graph_id < 0 || graph_id >= GRAPH_MAX_ENDPOINTS) {
+    return 0;
+  }
+  graph_endpoint_t * ep = &graph->endpoints[graph_id];
+  uint32_t count = __atomic_load_n(&ep->incompatible, __ATOMIC_ACQUIRE);
+  *last_policy = __atomic_load_n(&ep->incompatible_policy, __ATOMIC_RELAXED);
+  return count;
+}
+
+int
+hazcat_graph_reclaim()
+{
+  if (NULL == graph) {
+    return 0;
+  }
+
+  // Shared by every thread of the process, a scan another thread just did counts
+  static int64_t last_scan = 0;
+  static int64_t last_reuse_check = 0;
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  int64_t now = ts.tv_sec * 1000000000ll + ts.tv_nsec;
+  int64_t last = __atomic_load_n(&last_scan, __ATOMIC_RELAXED);
+  if ((0 != last && now - last < RECLAIM_PERIOD) ||
+    !__atomic_compare_exchange_n(&last_scan, &last, now, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+  {
+    return 0;
+  }
+  int64_t last_reuse = __atomic_load_n(&last_reuse_check, __ATOMIC_RELAXED);
+  bool check_reuse = 0 == last_reuse || now - last_reuse >= RECLAIM_REUSE_PERIOD;
+  if (check_reuse) {
+    __atomic_store_n(&last_reuse_check, now, __ATOMIC_RELAXED);
+  }
+
+  // Look for dead nodes without locking first, so the common case neither blocks writers nor
+  // bumps the epoch and wakes every graph listener on the host
+  bool any_dead = false;
+  for (int n = 0; !any_dead && n < GRAPH_MAX_NODES && n < graph->node_count; n++) {
+    graph_node_t * node = &graph->nodes[n];
+    any_dead = node->in_use && !process_alive(node->pid, node->start_time, check_reuse);
+  }
+  if (!any_dead) {
+    return 0;
+  }
+
+  // Recheck under the lock, in case another process reclaimed them meanwhile
+  int reclaimed = 0;
+  graph_write_begin();
+  for (int n = 0; n < graph->node_count; n++) {
+    graph_node_t * node = &graph->nodes[n];
+    if (!node->in_use || process_alive(node->pid, node->start_time, check_reuse)) {
+      continue;
+    }
+    for (int e = 0; e < graph->endpoint_count; e++) {
+      graph_endpoint_t * ep = &graph->endpoints[e];
+      if (ep->in_use && ep->node == n) {
+        if (ep->kind & (GRAPH_PUBLISHER | GRAPH_SUBSCRIPTION)) {
+          reclaim_endpoint(ep);
+        }
+        if (GRAPH_SUBSCRIPTION == ep->kind || retains(ep)) {
+          hazcat_graph_topic_drained(&graph->topics[ep->topic_id]);
+        }
+        release_endpoint(ep);
+      }
+    }
+    node->in_use = 0;
+    reclaimed++;
+  }
+  graph_trim();
+  graph_write_end();
+
+  return reclaimed;
+}
+
+uint32_t
+hazcat_graph_epoch()
+{
+  return (NULL == graph) ? 0 : __atomic_load_n(&graph->epoch, __ATOMIC_ACQUIRE);
+}
+
+rmw_ret_t
+hazcat_graph_get_names_and_types(
+  uint32_t kinds,
+  const char * node_name,
+  const char * node_namespace,
+  rcutils_allocator_t * allocator,
+  rmw_names_and_types_t * names_and_types)
+{
+  RCUTILS_CHECK_ARGUMENT_FOR_NULL(allocator, RMW_RET_INVALID_ARGUMENT);
+  RCUTILS_CHECK_ARGUMENT_FOR_NULL(names_and_types, RMW_RET_INVALID_ARGUMENT);
+  if (NULL != node_name && NULL == node_namespace) {
+    RMW_SET_ERROR_MSG("Node name given without namespace");
+    return RMW_RET_INVALID_ARGUMENT;
+  }
+  if (NULL == graph) {
+    RMW_SET_ERROR_MSG("ros graph hasn't been initialized");
+    return RMW_RET_ERROR;
+  }
+
+  // Copy out matching (name, type) pairs, starting over if a writer modified the graph meanwhile
+  name_type_pair_t * pairs = NULL;
+  size_t capacity = 0;
+  size_t count = 0;
+  bool node_found = false;
+  uint32_t seq;
+  do {
+    seq = graph_read_begin();
+    size_t high_water = __atomic_load_n(&graph->endpoint_count, __ATOMIC_RELAXED);
+    if (high_water > GRAPH_MAX_ENDPOINTS) {
+      continue;   // Torn read
+    }
+    if (high_water > capacity) {
+      void * tmp = allocator->reallocate(
+        pairs, high_water * sizeof(name_type_pair_t), allocator->state);
+      if (NULL == tmp) {
+        allocator->deallocate(pairs, allocator->state);
+        RMW_SET_ERROR_MSG("Unable to allocate memory for graph query");
+        return RMW_RET_BAD_ALLOC;
+      }
+      pairs = tmp;
+      capacity = high_water;
+    }
+
+    node_found = (NULL == node_name);
+    for (int i = 0; !node_found && i < GRAPH_MAX_NODES && i < graph->node_count; i++) {
+      node_found = node_matches(i, node_name, node_namespace);
+    }
+
+    count = 0;
+    for (size_t i = 0; i < high_water; i++) {
+      graph_endpoint_t * ep = &graph->endpoints[i];
+      if (!ep->in_use || !(ep->kind & kinds)) {
+        continue;
+      }
+      if (NULL != node_name && !node_matches(ep->node, node_name, node_namespace)) {
+        continue;
+      }
+      copy_name(pairs[count].name, ep->topic);
+      copy_name(pairs[count].type, ep->type);
+      count++;
+    }
+  } while (graph_read_retry(seq));
+
+  if (!node_found) {
+    allocator->deallocate(pairs, allocator->state);
+    RMW_SET_ERROR_MSG_WITH_FORMAT_STRING(
+      "node %s%s doesn't exist", node_namespace, node_name);
+    return RMW_RET_NODE_NAME_NON_EXISTENT;
+  }
+
+  // Sort, so pairs sharing a name are adjacent and duplicates can be skipped
+  qsort(pairs, count, sizeof(name_type_pair_t), compare_pairs);
+  size_t num_names = 0;
+  for (size_t i = 0; i < count; i++) {
+    if (0 == i || 0 != strcmp(pairs[i].name, pairs[i - 1].name)) {
+      num_names++;
+    }
+  }
+
+  rmw_ret_t ret = rmw_names_and_types_init(names_and_types, num_names, allocator);
+  if (RMW_RET_OK != ret) {
+    allocator->deallocate(pairs, allocator->state);
+    return ret;
+  }
+
+  size_t n = 0;
+  for (size_t i = 0; i < count; n++) {
+    size_t end = i;
+    size_t num_types = 0;
+    for (; end < count && 0 == strcmp(pairs[end].name, pairs[i].name); end++) {
+      if (end == i || 0 != strcmp(pairs[end].type, pairs[end - 1].type)) {
+        num_types++;
+      }
+    }
+
+    names_and_types->names.data[n] = rcutils_strdup(pairs[i].name, *allocator);
+    if (NULL == names_and_types->names.data[n] ||
+      RCUTILS_RET_OK != rcutils_string_array_init(&names_and_types->types[n], num_types, allocator))
+    {
+      goto fail;
+    }
+    for (size_t j = i, t = 0; j < end; j++) {
+      if (j == i || 0 != strcmp(pairs[j].type, pairs[j - 1].type)) {
+        names_and_types->types[n].data[t] = rcutils_strdup(pairs[j].type, *allocator);
+        if (NULL == names_and_types->types[n].data[t++]) {
+          goto fail;
+        }
+      }
+    }
+    i = end;
+  }
+
+  allocator->deallocate(pairs, allocator->state);
+  return RMW_RET_OK;
+
+fail:
+  RMW_SET_ERROR_MSG("Unable to allocate memory for graph query");
+  rmw_names_and_types_fini(names_and_types);
+  allocator->deallocate(pairs, allocator->state);
+  return RMW_RET_BAD_ALLOC;
+}
+
+rmw_ret_t
+hazcat_graph_get_endpoints_info(
+  graph_endpoint_kind_t kind,
+  const char * topic,
+  rcutils_allocator_t * allocator,
+  rmw_topic_endpoint_info_array_t * endpoints_info)
+{
+  RCUTILS_CHECK_ARGUMENT_FOR_NULL(topic, RMW_RET_INVALID_ARGUMENT);
+  RCUTILS_CHECK_ARGUMENT_FOR_NULL(allocator, RMW_RET_INVALID_ARGUMENT);
+  RCUTILS_CHECK_ARGUMENT_FOR_NULL(endpoints_info, RMW_RET_INVALID_ARGUMENT);
+  if (NULL == graph) {
+    RMW_SET_ERROR_MSG("ros graph hasn't been initialized");
+    return RMW_RET_ERROR;
+  }
+
+  endpoint_info_t * infos = NULL;
+  size_t capacity = 0;
+  size_t count = 0;
+  uint32_t seq;
+  do {
+    seq = graph_read_begin();
+    size_t high_water = __atomic_load_n(&graph->endpoint_count, __ATOMIC_RELAXED);
+    if (high_water > GRAPH_MAX_ENDPOINTS) {
+      continue;   // Torn read
+    }
+    if (high_water > capacity) {
+      void * tmp = allocator->reallocate(
+        infos, high_water * sizeof(endpoint_info_t), allocator->state);
+      if (NULL == tmp) {
+        allocator->deallocate(infos, allocator->state);
+        RMW_SET_ERROR_MSG("Unable to allocate memory for graph query");
+        return RMW_RET_BAD_ALLOC;
+      }
+      infos = tmp;
+      capacity = high_water;
+    }
+
+    count = 0;
+    for (size_t i = 0; i < high_water; i++) {
+      graph_endpoint_t * ep = &graph->endpoints[i];
+      if (!ep->in_use || ep->kind != kind || 0 != strncmp(ep->topic, topic, GRAPH_NAME_LEN) ||
+        ep->node < 0 || ep->node >= GRAPH_MAX_NODES)
+      {
+        continue;
+      }
+      copy_name(infos[count].node_name, graph->nodes[ep->node].name);
+      copy_name(infos[count].node_namespace, graph->nodes[ep->node].namespace_);
+      copy_name(infos[count].type, ep->type);
+      memcpy(infos[count].gid, ep->gid, RMW_GID_STORAGE_SIZE);
+      infos[count].qos = ep->qos;
+      count++;
+    }
+  } while (graph_read_retry(seq));
+
+  rmw_ret_t ret = rmw_topic_endpoint_info_array_init_with_size(endpoints_info, count, allocator);
+  if (RMW_RET_OK != ret) {
+    allocator->deallocate(infos, allocator->state);
+    return ret;
+  }
+
+  // All of them, so finishing the array on failure never touches entries not filled in yet
+  for (size_t i = 0; i < count; i++) {
+    endpoints_info->info_array[i] = rmw_get_zero_initialized_topic_endpoint_info();
+  }
+
+  rmw_endpoint_type_t type =
+    (GRAPH_PUBLISHER == kind) ? RMW_ENDPOINT_PUBLISHER : RMW_ENDPOINT_SUBSCRIPTION;
+  for (size_t i = 0; i < count; i++) {
+    rmw_topic_endpoint_info_t * info = &endpoints_info->info_array[i];
+    if (RMW_RET_OK != (ret = rmw_topic_endpoint_info_set_node_name(
+        info, infos[i].node_name, allocator)) ||
+      RMW_RET_OK != (ret = rmw_topic_endpoint_info_set_node_namespace(
+        info, infos[i].node_namespace, allocator)) ||
+      RMW_RET_OK != (ret = rmw_topic_endpoint_info_set_topic_type(
+        info, infos[i].type, allocator)) ||
+      RMW_RET_OK != (ret = rmw_topic_endpoint_info_set_endpoint_type(info, type)) ||
+      RMW_RET_OK != (ret = rmw_topic_endpoint_info_set_gid(
+        info, infos[i].gid, RMW_GID_STORAGE_SIZE)) ||
+      RMW_RET_OK != (ret = rmw_topic_endpoint_info_set_qos_profile(info, &infos[i].qos)))
+    {
+      rmw_topic_endpoint_info_array_fini(endpoints_info, allocator);
+      allocator->deallocate(infos, allocator->state);
+      return ret;
+    }
+  }
+
+  allocator->deallocate(infos, allocator->state);
+  return RMW_RET_OK;
+}
+
+rmw_ret_t
+hazcat_graph_get_endpoint_domain(const uint8_t gid[RMW_GID_STORAGE_SIZE], uint32_t * domain)
+{
+  RCUTILS_CHECK_ARGUMENT_FOR_NULL(gid, RMW_RET_INVALID_ARGUMENT);
+  RCUTILS_CHECK_ARGUMENT_FOR_NULL(domain, RMW_RET_INVALID_ARGUMENT);
+  if (NULL == graph) {
+    RMW_SET_ERROR_MSG("ros graph hasn't been initialized");
+    return RMW_RET_ERROR;
+  }
+
+  bool found;
+  uint32_t seq;
+  do {
+    seq = graph_read_begin();
+    found = false;
+    for (int i = 0; !found && i < GRAPH_MAX_ENDPOINTS && i < graph->endpoint_count; i++) {
+      graph_endpoint_t * ep = &graph->endpoints[i];
+      if (ep->in_use && 0 == memcmp(ep->gid, gid, RMW_GID_STORAGE_SIZE)) {
+        *domain = ep->domain;
+        found = true;
+      }
+    }
+  } while (graph_read_retry(seq));
+
+  if (!found) {
+    RMW_SET_ERROR_MSG("No endpoint with that gid in ros graph");
+    return RMW_RET_ERROR;
+  }
+  return RMW_RET_OK;
+}
+
+rmw_ret_t
+hazcat_graph_get_node_names(
+  rcutils_string_array_t * node_names,
+  rcutils_string_array_t * node_namespaces,
+  rcutils_string_array_t * enclaves)
+{
+  RCUTILS_CHECK_ARGUMENT_FOR_NULL(node_names, RMW_RET_INVALID_ARGUMENT);
+  RCUTILS_CHECK_ARGUMENT_FOR_NULL(node_namespaces, RMW_RET_INVALID_ARGUMENT);
+  if (NULL == graph) {
+    RMW_SET_ERROR_MSG("ros graph hasn't been initialized");
+    return RMW_RET_ERROR;
+  }
+
+  rcutils_allocator_t allocator = rcutils_get_default_allocator();
+  node_names_t * nodes =
+    allocator.allocate(GRAPH_MAX_NODES * sizeof(node_names_t), allocator.state);
+  if (NULL == nodes) {
+    RMW_SET_ERROR_MSG("Unable to allocate memory for graph query");
+    return RMW_RET_BAD_ALLOC;
+  }
+
+  size_t count;
+  uint32_t seq;
+  do {
+    seq = graph_read_begin();
+    count = 0;
+    for (int i = 0; i < GRAPH_MAX_NODES && i < graph->node_count; i++) {
+      graph_node_t * n = &graph->nodes[i];
+      if (n->in_use) {
+        copy_name(nodes[count].name, n->name);
+        copy_name(nodes[count].namespace_, n->namespace_);
+        copy_name(nodes[count].enclave, n->enclave);
+        count++;
+      }
+    }
+  } while (graph_read_retry(seq));
+
+  if (RCUTILS_RET_OK != rcutils_string_array_init(node_names, count, &allocator) ||
+    RCUTILS_RET_OK != rcutils_string_array_init(node_namespaces, count, &allocator) ||
+    (NULL != enclaves && RCUTILS_RET_OK != rcutils_string_array_init(enclaves, count, &allocator)))
+  {
+    goto fail;
+  }
+  for (size_t i = 0; i < count; i++) {
+    node_names->data[i] = rcutils_strdup(nodes[i].name, allocator);
+    node_namespaces->data[i] = rcutils_strdup(nodes[i].namespace_, allocator);
+    if (NULL == node_names->data[i] || NULL == node_namespaces->data[i]) {
+      goto fail;
+    }
+    if (NULL != enclaves) {
+      enclaves->data[i] = rcutils_strdup(nodes[i].enclave, allocator);
+      if (NULL == enclaves->data[i]) {
+        goto fail;
+      }
+    }
+  }
+
+  allocator.deallocate(nodes, allocator.state);
+  return RMW_RET_OK;
+
+fail:
+  RMW_SET_ERROR_MSG("Unable to allocate memory for graph query");
+  rcutils_string_array_fini(node_names);
+  rcutils_string_array_fini(node_namespaces);
+  if (NULL != enclaves) {
+    rcutils_string_array_fini(enclaves);
+  }
+  allocator.deallocate(nodes, allocator.state);
+  return RMW_RET_BAD_ALLOC;
+}
+
+void
+hazcat_graph_type_name(const char * namespace_, const char * name, char * type, size_t len)
+{
+  if (0 == len) {
+    return;
+  }
+
+  size_t i = 0;
+  for (const char * c = namespace_; '\0' != *c && i + 1 < len; c++) {
+    // C typesupport separates namespaces with "__", C++ typesupport with "::"
+    if (('_' == c[0] && '_' == c[1]) || (':' == c[0] && ':' == c[1])) {
+      type[i++] = '/';
+      c++;
+    } else {
+      type[i++] = *c;
+    }
+  }
+  snprintf(type + i, len - i, "/%s", name);
+}
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,295 @@
+// Copyright 2022 Washington University in St Louis
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <linux/mempolicy.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ipc.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/shm.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "rcutils/env.h"
+
+#include "rmw/error_handling.h"
+#include "rmw/rmw.h"
+
+#include "rmw_hazcat/hazcat_segment.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// Used when the kernel doesn't say, the size on x86 and most arm64 configurations
+#define DEFAULT_HUGE_PAGE_SIZE  (2 * 1024 * 1024)
+
+// Nodes a mask passed to the kernel can name, the most any kernel is configured for
+#define MAX_NODES               1024
+#define NODE_MASK_WORDS         (MAX_NODES / (8 * sizeof(unsigned long)))
+
+// A mapping this process has locked. Endpoints of a topic share its message queue mapping, and
+// endpoints of a type their allocator's, so each is locked and counted once until the last unlocks
+typedef struct locked_mapping
+{
+  void * addr;
+  size_t size;
+  int refs;
+  struct locked_mapping * next;
+} locked_mapping_t;
+
+static locked_mapping_t * locked = NULL;
+static pthread_mutex_t locked_lock = PTHREAD_MUTEX_INITIALIZER;
+static size_t locked_bytes = 0;
+
+static bool
+env_enabled(const char * name)
+{
+  const char * value = NULL;
+  return NULL == rcutils_get_env(name, &value) && NULL != value && '\0' != value[0] &&
+         0 != strcmp(value, "0");
+}
+
+static size_t
+page_rounded(size_t size)
+{
+  size_t page = sysconf(_SC_PAGESIZE);
+  return (size + page - 1) / page * page;
+}
+
+static size_t
+huge_page_size()
+{
+  static size_t size = 0;
+  size_t cached = __atomic_load_n(&size, __ATOMIC_RELAXED);
+  if (0 != cached) {
+    return cached;
+  }
+
+  cached = DEFAULT_HUGE_PAGE_SIZE;
+  FILE * meminfo = fopen("/proc/meminfo", "r");
+  if (NULL != meminfo) {
+    char line[128];
+    size_t kb;
+    while (NULL != fgets(line, sizeof(line), meminfo)) {
+      if (1 == sscanf(line, "Hugepagesize: %zu kB", &kb)) {
+        cached = kb * 1024;
+        break;
+      }
+    }
+    fclose(meminfo);
+  }
+  __atomic_store_n(&size, cached, __ATOMIC_RELAXED);
+  return cached;
+}
+
+int
+hazcat_segment_default_flags()
+{
+  static int flags = -1;
+  int cached = __atomic_load_n(&flags, __ATOMIC_RELAXED);
+  if (-1 != cached) {
+    return cached;
+  }
+
+  cached = 0;
+  if (env_enabled(HAZCAT_HUGE_PAGES_ENV)) {
+    cached |= HAZCAT_SEGMENT_HUGE_PAGES;
+  }
+  if (env_enabled(HAZCAT_LOCK_MEMORY_ENV)) {
+    cached |= HAZCAT_SEGMENT_LOCKED;
+  }
+  const char * numa = NULL;
+  if (NULL == rcutils_get_env(HAZCAT_NUMA_ENV, &numa) && NULL != numa && '\0' != numa[0]) {
+    char * end;
+    long node = strtol(numa, &end, 10);
+    if (0 == strcmp(numa, "local")) {
+      cached |= HAZCAT_SEGMENT_LOCAL_NODE;
+    } else if (0 == strcmp(numa, "interleave")) {
+      cached |= HAZCAT_SEGMENT_INTERLEAVE;
+    } else if ('\0' == *end && node >= 0 && node < MAX_NODES) {
+      cached |= HAZCAT_SEGMENT_NODE(node);
+    }
+  }
+  __atomic_store_n(&flags, cached, __ATOMIC_RELAXED);
+  return cached;
+}
+
+void *
+hazcat_segment_create(size_t size, int flags, int * shmem_id)
+{
+  int id = -1;
+  if (flags & HAZCAT_SEGMENT_HUGE_PAGES) {
+    // Fails unless huge pages have been reserved, eg through /proc/sys/vm/nr_hugepages
+    size_t page = huge_page_size();
+    id = shmget(IPC_PRIVATE, (size + page - 1) / page * page, IPC_CREAT | SHM_HUGETLB | 0666);
+    if (-1 != id) {
+      flags &= ~HAZCAT_SEGMENT_HUGE_PAGES;
+    }
+  }
+  if (-1 == id) {
+    id = shmget(IPC_PRIVATE, size, IPC_CREAT | 0666);
+  }
+  if (-1 == id) {
+    RMW_SET_ERROR_MSG("Unable to create shared memory segment");
+    return NULL;
+  }
+  void * addr = shmat(id, NULL, 0);
+  shmctl(id, IPC_RMID, NULL);
+  if ((void *)-1 == addr) {
+    RMW_SET_ERROR_MSG("Unable to attach to shared memory segment");
+    return NULL;
+  }
+
+  if (RMW_RET_OK != hazcat_segment_advise(addr, size, flags)) {
+    shmdt(addr);
+    return NULL;
+  }
+  *shmem_id = id;
+  return addr;
+}
+
+// Sets the NUMA policy of a segment, moving pages this process alone has mapped already. Placement
+// is only a preference, so failure isn't reported
+static void
+place(void * addr, size_t size, int flags)
+{
+  unsigned long nodes[NODE_MASK_WORDS] = {0};
+  int mode;
+  unsigned int node;
+  if (flags & HAZCAT_SEGMENT_INTERLEAVE) {
+    mode = MPOL_INTERLEAVE;
+    if (0 != syscall(SYS_get_mempolicy, NULL, nodes, MAX_NODES + 1, NULL, MPOL_F_MEMS_ALLOWED)) {
+      return;
+    }
+  } else {
+    mode = MPOL_PREFERRED;
+    if (flags >> HAZCAT_SEGMENT_NODE_SHIFT) {
+      node = (flags >> HAZCAT_SEGMENT_NODE_SHIFT) - 1;
+    } else if (0 != syscall(SYS_getcpu, NULL, &node, NULL)) {
+      return;
+    }
+    if (node >= MAX_NODES) {
+      return;
+    }
+    nodes[node / (8 * sizeof(unsigned long))] = 1ul << (node % (8 * sizeof(unsigned long)));
+  }
+  syscall(SYS_mbind, addr, size, mode, nodes, MAX_NODES + 1, MPOL_MF_MOVE);
+}
+
+static rmw_ret_t
+lock(void * addr, size_t size)
+{
+  pthread_mutex_lock(&locked_lock);
+  for (locked_mapping_t * it = locked; NULL != it; it = it->next) {
+    if (addr == it->addr) {
+      it->refs++;
+      pthread_mutex_unlock(&locked_lock);
+      return RMW_RET_OK;
+    }
+  }
+  locked_mapping_t * mapping = rmw_allocate(sizeof(locked_mapping_t));
+  if (NULL == mapping) {
+    pthread_mutex_unlock(&locked_lock);
+    RMW_SET_ERROR_MSG("Unable to allocate memory for locked mapping bookkeeping");
+    return RMW_RET_ERROR;
+  }
+
+#ifdef MADV_POPULATE_WRITE
+  // mlock alone maps shared pages read only, the first write to each would still fault
+  madvise(addr, size, MADV_POPULATE_WRITE);
+#endif
+  if (0 != mlock(addr, size)) {
+    pthread_mutex_unlock(&locked_lock);
+    rmw_free(mapping);
+    struct rlimit limit;
+    getrlimit(RLIMIT_MEMLOCK, &limit);
+    RMW_SET_ERROR_MSG_WITH_FORMAT_STRING(
+      "Unable to lock %zu bytes of shared memory, %zu already locked with RLIMIT_MEMLOCK at "
+      "%llu", page_rounded(size), hazcat_segment_locked_bytes(),
+      (unsigned long long)limit.rlim_cur);
+    return RMW_RET_ERROR;
+  }
+  __atomic_add_fetch(&locked_bytes, page_rounded(size), __ATOMIC_RELAXED);
+  mapping->addr = addr;
+  mapping->size = size;
+  mapping->refs = 1;
+  mapping->next = locked;
+  locked = mapping;
+  pthread_mutex_unlock(&locked_lock);
+  return RMW_RET_OK;
+}
+
+rmw_ret_t
+hazcat_segment_advise(void * addr, size_t size, int flags)
+{
+  if ((flags & (HAZCAT_SEGMENT_LOCAL_NODE | HAZCAT_SEGMENT_INTERLEAVE)) ||
+    (flags >> HAZCAT_SEGMENT_NODE_SHIFT))
+  {
+    place(addr, size, flags);
+  }
+  if (flags & HAZCAT_SEGMENT_HUGE_PAGES) {
+    // Transparent huge pages, only honoured for shared memory if shmem_enabled is set to advise
+    madvise(addr, size, MADV_HUGEPAGE);
+  }
+  if (flags & HAZCAT_SEGMENT_LOCKED) {
+    return lock(addr, size);
+  }
+  return RMW_RET_OK;
+}
+
+void
+hazcat_segment_unlock(void * addr)
+{
+  pthread_mutex_lock(&locked_lock);
+  for (locked_mapping_t ** it = &locked; NULL != *it; it = &(*it)->next) {
+    locked_mapping_t * mapping = *it;
+    if (addr != mapping->addr) {
+      continue;
+    }
+    if (--mapping->refs == 0) {
+      munlock(addr, mapping->size);
+      __atomic_sub_fetch(&locked_bytes, page_rounded(mapping->size), __ATOMIC_RELAXED);
+      *it = mapping->next;
+      rmw_free(mapping);
+    }
+    break;
+  }
+  pthread_mutex_unlock(&locked_lock);
+}
+
+int
+hazcat_segment_node(const void * addr)
+{
+  int node;
+  if (0 != syscall(SYS_get_mempolicy, &node, NULL, 0, addr, MPOL_F_NODE | MPOL_F_ADDR)) {
+    return -1;
+  }
+  return node;
+}
+
+size_t
+hazcat_segment_locked_bytes()
+{
+  return __atomic_load_n(&locked_bytes, __ATOMIC_RELAXED);
+}
+
+#ifdef __cplusplus
+}
+#endif
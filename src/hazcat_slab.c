@@ -0,0 +1,176 @@
+// Copyright 2022 Washington University in St Louis
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdbool.h>
+#include <string.h>
+
+#include "rmw/error_handling.h"
+#include "rmw/rmw.h"
+
+#include "rmw_hazcat/hazcat_segment.h"
+#include "rmw_hazcat/hazcat_slab.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define FREE_INDEX_MASK   0xFFFFFFFFull
+
+// Offset of the slot at index
+static inline hazcat_offset_t
+slot_offset(slab_allocator_t * slab, uint32_t index)
+{
+  return slab->slots_start + (hazcat_offset_t)index * slab->slot_size;
+}
+
+// Free slots hold the index + 1 of the next free slot in their first word
+static inline uint32_t *
+free_link(slab_allocator_t * slab, uint32_t index)
+{
+  return (uint32_t *)((uint8_t *)slab + slot_offset(slab, index));
+}
+
+uint32_t
+hazcat_slab_size_class(size_t size)
+{
+  if (size > (1u << 31)) {
+    return 0;
+  }
+  uint32_t pow2 = SLAB_ALIGN;
+  while (pow2 < size) {
+    pow2 <<= 1;
+  }
+  // Three quarters of a power of two, if that's still a whole number of cache lines
+  uint32_t three_quarters = pow2 / 4 * 3;
+  if (three_quarters >= size && 0 == three_quarters % SLAB_ALIGN) {
+    return three_quarters;
+  }
+  return pow2;
+}
+
+hma_allocator_t *
+hazcat_slab_create(uint32_t slot_size, uint32_t capacity, int flags)
+{
+  size_t header_size = sizeof(slab_allocator_t) + (size_t)capacity * sizeof(uint32_t);
+  size_t slots_start = (header_size + SLAB_ALIGN - 1) & ~(size_t)(SLAB_ALIGN - 1);
+  size_t size = slots_start + (size_t)capacity * slot_size;
+  if (0 == slot_size || 0 != slot_size % SLAB_ALIGN) {
+    RMW_SET_ERROR_MSG("Invalid slab slot size");
+    return NULL;
+  }
+  if (size > HAZCAT_QUEUE_OFFSET_MAX) {
+    RMW_SET_ERROR_MSG("Slab capacity too large");
+    return NULL;
+  }
+
+  int shmem_id;
+  slab_allocator_t * slab = hazcat_segment_create(size, flags, &shmem_id);
+  if (NULL == slab) {
+    return NULL;
+  }
+
+  slab->untyped.shmem_id = shmem_id;
+  slab->untyped.strategy = SLAB_STRATEGY;
+  slab->untyped.domain = 0;   // CPU
+  slab->slot_size = slot_size;
+  slab->capacity = capacity;
+  slab->slots_start = slots_start;
+  slab->unused = 0;
+  slab->free_head = 0;
+
+  return &slab->untyped;
+}
+
+rmw_ret_t
+hazcat_slab_allocate(hma_allocator_t * alloc, size_t size, hazcat_offset_t * offset)
+{
+  slab_allocator_t * slab = (slab_allocator_t *)alloc;
+  if (size > slab->slot_size) {
+    return RMW_RET_BAD_ALLOC;
+  }
+
+  uint64_t head = __atomic_load_n(&slab->free_head, __ATOMIC_ACQUIRE);
+  while (0 != (head & FREE_INDEX_MASK)) {
+    uint32_t index = (head & FREE_INDEX_MASK) - 1;
+    // May be garbage if another thread takes the slot first, but then the tag has moved on
+    uint32_t next = __atomic_load_n(free_link(slab, index), __ATOMIC_RELAXED);
+    uint64_t popped = ((head >> 32) + 1) << 32 | next;
+    if (__atomic_compare_exchange_n(
+        &slab->free_head, &head, popped, true, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+    {
+      __atomic_store_n(&slab->refs[index], 1, __ATOMIC_RELEASE);
+      *offset = slot_offset(slab, index);
+      return RMW_RET_OK;
+    }
+  }
+
+  uint32_t index = __atomic_load_n(&slab->unused, __ATOMIC_RELAXED);
+  do {
+    if (index >= slab->capacity) {
+      return RMW_RET_BAD_ALLOC;
+    }
+  } while (!__atomic_compare_exchange_n(
+    &slab->unused, &index, index + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+  __atomic_store_n(&slab->refs[index], 1, __ATOMIC_RELEASE);
+  *offset = slot_offset(slab, index);
+  return RMW_RET_OK;
+}
+
+// Pushes a slot onto the free stack
+static void
+free_slot(slab_allocator_t * slab, uint32_t index)
+{
+  uint64_t head = __atomic_load_n(&slab->free_head, __ATOMIC_RELAXED);
+  uint64_t pushed;
+  do {
+    __atomic_store_n(free_link(slab, index), (uint32_t)(head & FREE_INDEX_MASK), __ATOMIC_RELAXED);
+    pushed = ((head >> 32) + 1) << 32 | (index + 1);
+  } while (!__atomic_compare_exchange_n(
+    &slab->free_head, &head, pushed, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+void
+hazcat_slab_share(hma_allocator_t * alloc, hazcat_offset_t offset, int64_t count)
+{
+  slab_allocator_t * slab = (slab_allocator_t *)alloc;
+  if (offset < slab->slots_start || 0 != (offset - slab->slots_start) % slab->slot_size ||
+    (offset - slab->slots_start) / slab->slot_size >= slab->capacity)
+  {
+    return;
+  }
+  uint32_t index = (offset - slab->slots_start) / slab->slot_size;
+
+  // Releasing a free slot would push it twice, handing it to two messages at once
+  uint32_t refs = __atomic_load_n(&slab->refs[index], __ATOMIC_ACQUIRE);
+  do {
+    if (0 == refs || (int64_t)refs + count < 0 || (int64_t)refs + count > UINT32_MAX) {
+      return;
+    }
+  } while (!__atomic_compare_exchange_n(
+    &slab->refs[index], &refs, refs + count, true, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+  if ((int64_t)refs + count == 0) {
+    free_slot(slab, index);
+  }
+}
+
+void
+hazcat_slab_deallocate(hma_allocator_t * alloc, hazcat_offset_t offset)
+{
+  hazcat_slab_share(alloc, offset, -1);
+}
+
+#ifdef __cplusplus
+}
+#endif
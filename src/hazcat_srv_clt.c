@@ -0,0 +1,192 @@
+// Copyright 2022 Washington University in St Louis
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <semaphore.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "rcutils/time.h"
+
+#include "rmw/error_handling.h"
+#include "rmw/rmw.h"
+
+#include "hazcat_allocators/cpu_ringbuf_allocator.h"
+#include "hazcat/hazcat_message_queue.h"
+
+#include "rmw_hazcat/hazcat_alloc.h"
+#include "rmw_hazcat/hazcat_pub_sub.h"
+#include "rmw_hazcat/hazcat_srv_clt.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+rmw_ret_t
+hazcat_srv_clt_init_queue(
+  pub_sub_data_t * data, rmw_context_t * context, size_t size, size_t depth)
+{
+  data->depth = (depth > 1) ? depth : 1;
+  data->msg_size = sizeof(srv_header_t) + size;
+  data->alloc = create_cpu_ringbuf_allocator(data->msg_size, data->depth);
+  if (NULL == data->alloc) {
+    RMW_SET_ERROR_MSG("Unable to create allocator for service queue");
+    return RMW_RET_BAD_ALLOC;
+  }
+  data->gid = generate_gid();
+  data->context = context;
+  sem_init(&data->lock, 0, 1);
+
+  return RMW_RET_OK;
+}
+
+void
+hazcat_srv_clt_fini_queue(pub_sub_data_t * data)
+{
+  sem_destroy(&data->lock);
+  cpu_ringbuf_unmap(data->alloc);
+}
+
+void
+hazcat_request_topic(const char * service_name, char * topic, size_t len)
+{
+  snprintf(topic, len, "%s/_request", service_name);
+}
+
+void
+hazcat_response_topic(
+  const char * service_name, const rmw_request_id_t * client, char * topic, size_t len)
+{
+  size_t n = snprintf(topic, len, "%s/_response/", service_name);
+  for (size_t i = 0; i < sizeof(client->writer_guid) && n + 2 < len; i++) {
+    n += snprintf(topic + n, len - n, "%02x", (uint8_t)client->writer_guid[i]);
+  }
+}
+
+rmw_ret_t
+hazcat_srv_clt_borrow(pub_sub_data_t * data, void ** ros_message)
+{
+  hazcat_offset_t offset;
+  if (RMW_RET_OK != allocate_message(data->alloc, data->msg_size, &offset)) {
+    RMW_SET_ERROR_MSG("unable to allocate memory for service message");
+    return RMW_RET_ERROR;
+  }
+  *ros_message = GET_PTR(data->alloc, offset, srv_header_t) + 1;
+
+  return RMW_RET_OK;
+}
+
+void
+hazcat_srv_clt_return_borrowed(pub_sub_data_t * data, void * ros_message)
+{
+  hazcat_deallocate(data->alloc, hazcat_offset_of(data->alloc, (srv_header_t *)ros_message - 1));
+}
+
+rmw_ret_t
+hazcat_srv_clt_send_loaned(
+  pub_sub_data_t * data, const rmw_request_id_t * request_id, void * ros_message)
+{
+  srv_header_t * header = (srv_header_t *)ros_message - 1;
+  header->request_id = *request_id;
+  rcutils_system_time_now(&header->source_timestamp);
+
+  return hazcat_publish(data, header, data->msg_size);
+}
+
+rmw_ret_t
+hazcat_srv_clt_send(
+  pub_sub_data_t * data, const rmw_request_id_t * request_id, const void * ros_message)
+{
+  void * msg;
+  rmw_ret_t ret = hazcat_srv_clt_borrow(data, &msg);
+  if (RMW_RET_OK != ret) {
+    return ret;
+  }
+
+  // TODO(nightduck): Same as rmw_publish, copies the message as is until serialization works
+  memcpy(msg, ros_message, data->msg_size - sizeof(srv_header_t));
+
+  return hazcat_srv_clt_send_loaned(data, request_id, msg);
+}
+
+static void
+fill_info(const srv_header_t * msg_header, rmw_service_info_t * header)
+{
+  header->request_id = msg_header->request_id;
+  header->source_timestamp = msg_header->source_timestamp;
+  rcutils_system_time_now(&header->received_timestamp);
+}
+
+rmw_ret_t
+hazcat_srv_clt_take(
+  pub_sub_data_t * data, rmw_service_info_t * header, void * ros_message, bool * taken)
+{
+  msg_ref_t msg_ref = hazcat_take(data);
+  if (NULL == msg_ref.msg) {
+    *taken = false;
+    return RMW_RET_OK;
+  }
+
+  srv_header_t * msg_header = (srv_header_t *)msg_ref.msg;
+  fill_info(msg_header, header);
+  memcpy(ros_message, msg_header + 1, data->msg_size - sizeof(srv_header_t));
+
+  hazcat_deallocate(msg_ref.alloc, hazcat_offset_of(msg_ref.alloc, msg_ref.msg));
+
+  *taken = true;
+  return RMW_RET_OK;
+}
+
+rmw_ret_t
+hazcat_srv_clt_take_loaned(
+  pub_sub_data_t * data, rmw_service_info_t * header, void ** ros_message, bool * taken)
+{
+  msg_ref_t msg_ref = hazcat_take(data);
+  if (NULL == msg_ref.msg) {
+    *taken = false;
+    return RMW_RET_OK;
+  }
+
+  srv_header_t * msg_header = (srv_header_t *)msg_ref.msg;
+  fill_info(msg_header, header);
+  *ros_message = msg_header + 1;
+
+  *taken = true;
+  return RMW_RET_OK;
+}
+
+rmw_ret_t
+hazcat_srv_clt_return_taken(pub_sub_data_t * data, void * ros_message)
+{
+  // Same work-around as rmw_return_loaned_message_from_subscription. get_matching_alloc only
+  // needs the hazcat data behind a subscription, so the queue is wrapped in a throwaway one
+  rmw_subscription_t sub = {
+    .implementation_identifier = rmw_get_implementation_identifier(),
+    .data = data
+  };
+  void * msg = (srv_header_t *)ros_message - 1;
+  hma_allocator_t * alloc = get_matching_alloc(&sub, msg);
+  if (NULL == alloc) {
+    RMW_SET_ERROR_MSG("Returning message that wasn't loaned");
+    return RMW_RET_ERROR;
+  }
+
+  hazcat_deallocate(alloc, hazcat_offset_of(alloc, msg));
+
+  return RMW_RET_OK;
+}
+
+#ifdef __cplusplus
+}
+#endif
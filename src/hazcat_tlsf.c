@@ -0,0 +1,293 @@
+// Copyright 2022 Washington University in St Louis
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <errno.h>
+#include <string.h>
+
+#include "rmw/error_handling.h"
+#include "rmw/rmw.h"
+
+#include "rmw_hazcat/hazcat_segment.h"
+#include "rmw_hazcat/hazcat_tlsf.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+static inline tlsf_block_t *
+get_block(tlsf_allocator_t * tlsf, uint64_t offset)
+{
+  return (tlsf_block_t *)((uint8_t *)tlsf + offset);
+}
+
+static inline uint64_t
+block_size(const tlsf_block_t * block)
+{
+  return block->size & ~TLSF_BLOCK_FREE;
+}
+
+static inline uint64_t
+round_up(size_t size)
+{
+  return (size + TLSF_ALIGN - 1) & ~(size_t)(TLSF_ALIGN - 1);
+}
+
+// Bin holding free blocks of exactly this size
+static void
+mapping_insert(uint64_t size, int * fl, int * sl)
+{
+  if (size < TLSF_SMALL_BLOCK) {
+    *fl = 0;
+    *sl = size >> TLSF_ALIGN_LOG2;
+  } else {
+    int log2 = 63 - __builtin_clzll(size);
+    *sl = (size >> (log2 - TLSF_SL_LOG2)) ^ TLSF_SL_COUNT;
+    *fl = log2 - TLSF_FL_SHIFT + 1;
+  }
+}
+
+// First bin whose blocks are all at least this size, so whatever block is found there fits
+static void
+mapping_search(uint64_t size, int * fl, int * sl)
+{
+  if (size >= TLSF_SMALL_BLOCK) {
+    size += (1ull << (63 - __builtin_clzll(size) - TLSF_SL_LOG2)) - 1;
+  }
+  mapping_insert(size, fl, sl);
+}
+
+static void
+insert_free(tlsf_allocator_t * tlsf, uint64_t offset)
+{
+  tlsf_block_t * block = get_block(tlsf, offset);
+  int fl, sl;
+  mapping_insert(block_size(block), &fl, &sl);
+  block->size |= TLSF_BLOCK_FREE;
+  block->prev_free = 0;
+  block->next_free = tlsf->free_lists[fl][sl];
+  if (0 != block->next_free) {
+    get_block(tlsf, block->next_free)->prev_free = offset;
+  }
+  tlsf->free_lists[fl][sl] = offset;
+  tlsf->fl_bitmap |= 1ull << fl;
+  tlsf->sl_bitmap[fl] |= 1u << sl;
+}
+
+static void
+remove_free(tlsf_allocator_t * tlsf, uint64_t offset)
+{
+  tlsf_block_t * block = get_block(tlsf, offset);
+  int fl, sl;
+  mapping_insert(block_size(block), &fl, &sl);
+  if (0 != block->prev_free) {
+    get_block(tlsf, block->prev_free)->next_free = block->next_free;
+  } else {
+    tlsf->free_lists[fl][sl] = block->next_free;
+  }
+  if (0 != block->next_free) {
+    get_block(tlsf, block->next_free)->prev_free = block->prev_free;
+  }
+  if (0 == tlsf->free_lists[fl][sl]) {
+    tlsf->sl_bitmap[fl] &= ~(1u << sl);
+    if (0 == tlsf->sl_bitmap[fl]) {
+      tlsf->fl_bitmap &= ~(1ull << fl);
+    }
+  }
+  block->size &= ~TLSF_BLOCK_FREE;
+}
+
+// Offset of the first block in the smallest non-empty bin at or above fl, sl, or 0
+static uint64_t
+find_free(tlsf_allocator_t * tlsf, int fl, int sl)
+{
+  if (fl >= TLSF_FL_COUNT) {
+    return 0;
+  }
+  uint32_t sl_map = tlsf->sl_bitmap[fl] & (~0u << sl);
+  if (0 == sl_map) {
+    uint64_t fl_map = (fl + 1 < 64) ? tlsf->fl_bitmap & (~0ull << (fl + 1)) : 0;
+    if (0 == fl_map) {
+      return 0;
+    }
+    fl = __builtin_ctzll(fl_map);
+    sl_map = tlsf->sl_bitmap[fl];
+  }
+  return tlsf->free_lists[fl][__builtin_ctz(sl_map)];
+}
+
+static void
+tlsf_lock(tlsf_allocator_t * tlsf)
+{
+  if (EOWNERDEAD == pthread_mutex_lock(&tlsf->lock)) {
+    // Lists are only ever edited a few words at a time, carry on with whatever was left
+    pthread_mutex_consistent(&tlsf->lock);
+  }
+}
+
+hma_allocator_t *
+hazcat_tlsf_create(size_t pool_size, int flags)
+{
+  uint64_t pool_start = round_up(sizeof(tlsf_allocator_t));
+  // Room for the sentinel block closing off the end of the pool
+  size_t size = pool_start + round_up(pool_size) + sizeof(tlsf_block_t);
+  if (pool_size > HAZCAT_QUEUE_OFFSET_MAX || size > HAZCAT_QUEUE_OFFSET_MAX) {
+    RMW_SET_ERROR_MSG("TLSF pool too large");
+    return NULL;
+  }
+
+  int shmem_id;
+  tlsf_allocator_t * tlsf = hazcat_segment_create(size, flags, &shmem_id);
+  if (NULL == tlsf) {
+    return NULL;
+  }
+
+  memset(tlsf, 0, sizeof(tlsf_allocator_t));
+  tlsf->untyped.shmem_id = shmem_id;
+  tlsf->untyped.strategy = TLSF_STRATEGY;
+  tlsf->untyped.domain = 0;   // CPU
+  pthread_mutexattr_t attr;
+  pthread_mutexattr_init(&attr);
+  pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+  pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+  pthread_mutex_init(&tlsf->lock, &attr);
+  pthread_mutexattr_destroy(&attr);
+  tlsf->pool_start = pool_start;
+  tlsf->pool_size = round_up(pool_size);
+
+  // One free block spanning the pool, and an allocated, empty one after it so merging never has
+  // to check for the end
+  tlsf_block_t * block = get_block(tlsf, pool_start);
+  block->prev_phys = 0;
+  block->size = tlsf->pool_size;
+  tlsf_block_t * sentinel = get_block(tlsf, pool_start + tlsf->pool_size);
+  sentinel->prev_phys = pool_start;
+  sentinel->size = 0;
+  insert_free(tlsf, pool_start);
+
+  return &tlsf->untyped;
+}
+
+rmw_ret_t
+hazcat_tlsf_allocate(hma_allocator_t * alloc, size_t size, hazcat_offset_t * offset)
+{
+  tlsf_allocator_t * tlsf = (tlsf_allocator_t *)alloc;
+  if (size > tlsf->pool_size) {
+    return RMW_RET_BAD_ALLOC;
+  }
+  uint64_t needed = round_up(sizeof(tlsf_block_t) + size);
+  if (needed < TLSF_MIN_BLOCK) {
+    needed = TLSF_MIN_BLOCK;
+  }
+  int fl, sl;
+  mapping_search(needed, &fl, &sl);
+
+  tlsf_lock(tlsf);
+  uint64_t block_offset = find_free(tlsf, fl, sl);
+  if (0 == block_offset) {
+    // Blocks in the bin this size falls in may still fit, the search only skips them to stay O(1)
+    mapping_insert(needed, &fl, &sl);
+    block_offset = tlsf->free_lists[fl][sl];
+    if (0 != block_offset && block_size(get_block(tlsf, block_offset)) < needed) {
+      block_offset = 0;
+    }
+  }
+  if (0 == block_offset) {
+    pthread_mutex_unlock(&tlsf->lock);
+    return RMW_RET_BAD_ALLOC;
+  }
+  remove_free(tlsf, block_offset);
+
+  // Give back whatever's left over, if it's big enough to be a block of its own
+  tlsf_block_t * block = get_block(tlsf, block_offset);
+  uint64_t remaining = block_size(block) - needed;
+  if (remaining >= TLSF_MIN_BLOCK) {
+    uint64_t rest_offset = block_offset + needed;
+    tlsf_block_t * rest = get_block(tlsf, rest_offset);
+    rest->prev_phys = block_offset;
+    rest->size = remaining;
+    get_block(tlsf, rest_offset + remaining)->prev_phys = rest_offset;
+    block->size = needed;
+    insert_free(tlsf, rest_offset);
+  }
+  block->refs = 1;
+  pthread_mutex_unlock(&tlsf->lock);
+
+  *offset = block_offset + sizeof(tlsf_block_t);
+  return RMW_RET_OK;
+}
+
+// Returns an allocated block to the pool
+static void
+free_block(tlsf_allocator_t * tlsf, uint64_t block_offset)
+{
+  tlsf_lock(tlsf);
+  tlsf_block_t * block = get_block(tlsf, block_offset);
+
+  // Merge with free neighbours, so the pool never fragments into adjacent free blocks
+  tlsf_block_t * next = get_block(tlsf, block_offset + block_size(block));
+  if (next->size & TLSF_BLOCK_FREE) {
+    remove_free(tlsf, block_offset + block_size(block));
+    block->size += block_size(next);
+  }
+  if (0 != block->prev_phys) {
+    tlsf_block_t * prev = get_block(tlsf, block->prev_phys);
+    if (prev->size & TLSF_BLOCK_FREE) {
+      remove_free(tlsf, block->prev_phys);
+      prev->size += block_size(block);
+      block_offset = block->prev_phys;
+      block = prev;
+    }
+  }
+  get_block(tlsf, block_offset + block_size(block))->prev_phys = block_offset;
+  insert_free(tlsf, block_offset);
+  pthread_mutex_unlock(&tlsf->lock);
+}
+
+void
+hazcat_tlsf_share(hma_allocator_t * alloc, hazcat_offset_t offset, int64_t count)
+{
+  tlsf_allocator_t * tlsf = (tlsf_allocator_t *)alloc;
+  if (offset < tlsf->pool_start + sizeof(tlsf_block_t) ||
+    offset >= tlsf->pool_start + tlsf->pool_size)
+  {
+    return;
+  }
+  uint64_t block_offset = offset - sizeof(tlsf_block_t);
+  tlsf_block_t * block = get_block(tlsf, block_offset);
+
+  // A free block's reference count is its list link, so never touch that
+  uint64_t refs = __atomic_load_n(&block->refs, __ATOMIC_ACQUIRE);
+  do {
+    if ((__atomic_load_n(&block->size, __ATOMIC_RELAXED) & TLSF_BLOCK_FREE) || 0 == refs ||
+      (count < 0 && refs < (uint64_t)-count))
+    {
+      return;
+    }
+  } while (!__atomic_compare_exchange_n(
+    &block->refs, &refs, refs + count, true, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+  if (refs + count == 0) {
+    free_block(tlsf, block_offset);
+  }
+}
+
+void
+hazcat_tlsf_deallocate(hma_allocator_t * alloc, hazcat_offset_t offset)
+{
+  hazcat_tlsf_share(alloc, offset, -1);
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -12,6 +12,8 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <cstring>
+
 #include "rmw/error_handling.h"
 #include "rmw/rmw.h"
 
@@ -22,19 +24,18 @@
 #include "rosidl_typesupport_introspection_c/field_types.h"
 #include "rosidl_typesupport_introspection_c/identifier.h"
 #include "rosidl_typesupport_introspection_c/message_introspection.h"
+#include "rosidl_typesupport_introspection_c/service_introspection.h"
 
 #include "rosidl_typesupport_introspection_cpp/field_types.hpp"
 #include "rosidl_typesupport_introspection_cpp/identifier.hpp"
 #include "rosidl_typesupport_introspection_cpp/message_introspection.hpp"
+#include "rosidl_typesupport_introspection_cpp/service_introspection.hpp"
+
+#include "rmw_hazcat/hazcat_typesupport.h"
 
 #define RMW_HAZCAT_TYPESUPPORT_C    rosidl_typesupport_introspection_c__identifier
 #define RMW_HAZCAT_TYPESUPPORT_CPP  rosidl_typesupport_introspection_cpp::typesupport_identifier
 
-extern "C"
-const rosidl_message_type_support_t *
-get_type_support(
-  const rosidl_message_type_support_t * type_support);
-
 const rosidl_message_type_support_t *
 get_type_support(
   const rosidl_message_type_support_t * type_support)
@@ -55,3 +56,30 @@ get_type_support(
   RMW_SET_ERROR_MSG("Unsupported typesupport");
   return nullptr;
 }
+
+bool
+hazcat_c_type_support(const rosidl_message_type_support_t * type_support)
+{
+  return 0 == strcmp(type_support->typesupport_identifier, RMW_HAZCAT_TYPESUPPORT_C);
+}
+
+const rosidl_service_type_support_t *
+get_service_type_support(
+  const rosidl_service_type_support_t * type_support)
+{
+  const rosidl_service_type_support_t * ts_c =
+    reinterpret_cast<const rosidl_service_type_support_t *>(
+    type_support->func(type_support, RMW_HAZCAT_TYPESUPPORT_C));
+  if (ts_c) {
+    return ts_c;
+  }
+  const rosidl_service_type_support_t * ts_cpp =
+    reinterpret_cast<const rosidl_service_type_support_t *>(
+    type_support->func(type_support, RMW_HAZCAT_TYPESUPPORT_CPP));
+  if (ts_cpp) {
+    return ts_cpp;
+  }
+
+  RMW_SET_ERROR_MSG("Unsupported typesupport");
+  return nullptr;
+}
@@ -12,6 +12,8 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <string.h>
+
 #include "rmw/error_handling.h"
 #include "rmw/rmw.h"
 #include "rmw/get_node_info_and_types.h"
@@ -21,10 +23,43 @@
 
 #include "hazcat/hazcat_message_queue.h"
 
+#include "rmw_hazcat/hazcat_node.h"
+#include "rmw_hazcat/hazcat_ros_graph.h"
+#include "rmw_hazcat/hazcat_service_loans.h"
+#include "rmw_hazcat/hazcat_srv_clt.h"
+#include "rmw_hazcat/hazcat_typesupport.h"
+
 #ifdef __cplusplus
 extern "C"
 {
 #endif
+// Requests are identified by the guid of the client's request publisher
+static void
+get_request_id(const srv_clt_info_t * info, rmw_request_id_t * id)
+{
+  memset(id, 0, sizeof(rmw_request_id_t));
+  memcpy(id->writer_guid, info->requests.gid.data, sizeof(id->writer_guid));
+}
+
+// Sends a request either copied from ros_request or, if set, the borrowed message loan
+static rmw_ret_t
+send_request(
+  const rmw_client_t * client, const void * ros_request, void * loan, int64_t * sequence_id)
+{
+  srv_clt_info_t * info = (srv_clt_info_t *)client->data;
+  rmw_request_id_t id;
+  get_request_id(info, &id);
+  id.sequence_number = __atomic_add_fetch(&info->sequence_number, 1, __ATOMIC_RELAXED);
+
+  rmw_ret_t ret = (NULL == loan) ?
+    hazcat_srv_clt_send(&info->requests, &id, ros_request) :
+    hazcat_srv_clt_send_loaned(&info->requests, &id, loan);
+  if (RMW_RET_OK == ret) {
+    *sequence_id = id.sequence_number;
+  }
+  return ret;
+}
+
 rmw_client_t *
 rmw_create_client(
   const rmw_node_t * node,
@@ -55,6 +90,11 @@ rmw_create_client(
     RMW_SET_ERROR_MSG("Invalid QoS policy");
     return NULL;
   }
+  const rosidl_service_type_support_t * ts = get_service_type_support(type_support);
+  if (NULL == ts) {
+    RMW_SET_ERROR_MSG("Unsupported typesupport");
+    return NULL;
+  }
 
   rmw_client_t * clt = rmw_client_allocate();
   if (NULL == clt) {
@@ -63,16 +103,74 @@ rmw_create_client(
   }
 
   clt->implementation_identifier = rmw_get_implementation_identifier();
-  clt->data = rmw_allocate(sizeof(srv_clt_data_t));
+  clt->service_name = NULL;
+  srv_clt_info_t * info = rmw_allocate(sizeof(srv_clt_info_t));
+  clt->data = info;
+  if (NULL == info) {
+    RMW_SET_ERROR_MSG("Unable to allocate memory for client info");
+    goto fail;
+  }
+  info->members = (const rosidl_typesupport_introspection_c__ServiceMembers *)ts->data;
+  info->sequence_number = 0;
   clt->service_name = rmw_allocate(strlen(service_name) + 1);
 
   if (NULL == clt->service_name) {
     RMW_SET_ERROR_MSG("Unable to allocate string for subscription's topic name");
-    return NULL;
+    goto fail;
   }
   snprintf(clt->service_name, strlen(service_name) + 1, service_name);
 
+  // The response queue is named after the guid of the request publisher, which is how the
+  // service knows where to answer
+  if (RMW_RET_OK != hazcat_srv_clt_init_queue(
+      &info->requests, node->context, info->members->request_members_->size_of_,
+      qos_policies->depth))
+  {
+    goto fail;
+  }
+  if (RMW_RET_OK != hazcat_srv_clt_init_queue(
+      &info->queue, node->context, info->members->response_members_->size_of_,
+      qos_policies->depth))
+  {
+    goto fail_requests;
+  }
+  char topic[SRV_CLT_TOPIC_LEN];
+  rmw_request_id_t id;
+  get_request_id(info, &id);
+  hazcat_response_topic(service_name, &id, topic, SRV_CLT_TOPIC_LEN);
+  if (RMW_RET_OK != hazcat_register_subscription(&info->queue, topic)) {
+    goto fail_queue;
+  }
+  hazcat_request_topic(service_name, topic, SRV_CLT_TOPIC_LEN);
+  if (RMW_RET_OK != hazcat_register_publisher(&info->requests, topic)) {
+    goto fail_subscription;
+  }
+
+  char type_name[GRAPH_NAME_LEN];
+  hazcat_graph_type_name(
+    info->members->service_namespace_, info->members->service_name_, type_name, GRAPH_NAME_LEN);
+  if (RMW_RET_OK != hazcat_graph_register_endpoint(
+      ((node_info_t *)node->data)->graph_id_, GRAPH_CLIENT, service_name, type_name,
+      &info->requests.gid, qos_policies, info->requests.alloc->domain, false,
+      &info->graph_id))
+  {
+    hazcat_unregister_publisher(&info->requests);
+    goto fail_subscription;
+  }
+
   return clt;
+
+fail_subscription:
+  hazcat_unregister_subscription(&info->queue);
+fail_queue:
+  hazcat_srv_clt_fini_queue(&info->queue);
+fail_requests:
+  hazcat_srv_clt_fini_queue(&info->requests);
+fail:
+  rmw_free(clt->service_name);
+  rmw_free(clt->data);
+  rmw_client_free(clt);
+  return NULL;
 }
 
 rmw_ret_t
@@ -87,6 +185,23 @@ rmw_destroy_client(rmw_node_t * node, rmw_client_t * client)
     return RMW_RET_INCORRECT_RMW_IMPLEMENTATION;
   }
 
+  srv_clt_info_t * info = (srv_clt_info_t *)client->data;
+  rmw_ret_t ret = hazcat_graph_unregister_endpoint(info->graph_id);
+  if (RMW_RET_OK != ret) {
+    return ret;
+  }
+
+  ret = hazcat_unregister_publisher(&info->requests);
+  if (RMW_RET_OK != ret) {
+    return ret;
+  }
+  ret = hazcat_unregister_subscription(&info->queue);
+  if (RMW_RET_OK != ret) {
+    return ret;
+  }
+  hazcat_srv_clt_fini_queue(&info->requests);
+  hazcat_srv_clt_fini_queue(&info->queue);
+
   rmw_free(client->data);
   rmw_free(client->service_name);
   rmw_client_free(client);
@@ -103,9 +218,11 @@ rmw_send_request(
   RCUTILS_CHECK_ARGUMENT_FOR_NULL(client, RMW_RET_INVALID_ARGUMENT);
   RCUTILS_CHECK_ARGUMENT_FOR_NULL(ros_request, RMW_RET_INVALID_ARGUMENT);
   RCUTILS_CHECK_ARGUMENT_FOR_NULL(sequence_id, RMW_RET_INVALID_ARGUMENT);
+  if (client->implementation_identifier != rmw_get_implementation_identifier()) {
+    return RMW_RET_INCORRECT_RMW_IMPLEMENTATION;
+  }
 
-  RMW_SET_ERROR_MSG("rmw_send_request hasn't been implemented yet");
-  return RMW_RET_UNSUPPORTED;
+  return send_request(client, ros_request, NULL, sequence_id);
 }
 
 rmw_ret_t
@@ -119,9 +236,90 @@ rmw_take_response(
   RCUTILS_CHECK_ARGUMENT_FOR_NULL(request_header, RMW_RET_INVALID_ARGUMENT);
   RCUTILS_CHECK_ARGUMENT_FOR_NULL(ros_response, RMW_RET_INVALID_ARGUMENT);
   RCUTILS_CHECK_ARGUMENT_FOR_NULL(taken, RMW_RET_INVALID_ARGUMENT);
+  if (client->implementation_identifier != rmw_get_implementation_identifier()) {
+    return RMW_RET_INCORRECT_RMW_IMPLEMENTATION;
+  }
+
+  // Only this client's responses land in its queue, the header's sequence number tells the caller
+  // which request each one answers
+  return hazcat_srv_clt_take(
+    &((srv_clt_info_t *)client->data)->queue, request_header, ros_response, taken);
+}
+
+rmw_ret_t
+rmw_hazcat_borrow_loaned_request(const rmw_client_t * client, void ** ros_request)
+{
+  RCUTILS_CHECK_ARGUMENT_FOR_NULL(client, RMW_RET_INVALID_ARGUMENT);
+  RCUTILS_CHECK_ARGUMENT_FOR_NULL(ros_request, RMW_RET_INVALID_ARGUMENT);
+  if (client->implementation_identifier != rmw_get_implementation_identifier()) {
+    return RMW_RET_INCORRECT_RMW_IMPLEMENTATION;
+  }
+  if (NULL != *ros_request) {
+    RMW_SET_ERROR_MSG("Non-null message given to rmw_hazcat_borrow_loaned_request");
+    return RMW_RET_INVALID_ARGUMENT;
+  }
+
+  return hazcat_srv_clt_borrow(&((srv_clt_info_t *)client->data)->requests, ros_request);
+}
+
+rmw_ret_t
+rmw_hazcat_return_loaned_request_from_client(const rmw_client_t * client, void * ros_request)
+{
+  RCUTILS_CHECK_ARGUMENT_FOR_NULL(client, RMW_RET_INVALID_ARGUMENT);
+  RCUTILS_CHECK_ARGUMENT_FOR_NULL(ros_request, RMW_RET_INVALID_ARGUMENT);
+  if (client->implementation_identifier != rmw_get_implementation_identifier()) {
+    return RMW_RET_INCORRECT_RMW_IMPLEMENTATION;
+  }
+
+  hazcat_srv_clt_return_borrowed(&((srv_clt_info_t *)client->data)->requests, ros_request);
+  return RMW_RET_OK;
+}
+
+rmw_ret_t
+rmw_hazcat_send_loaned_request(
+  const rmw_client_t * client,
+  void * ros_request,
+  int64_t * sequence_id)
+{
+  RCUTILS_CHECK_ARGUMENT_FOR_NULL(client, RMW_RET_INVALID_ARGUMENT);
+  RCUTILS_CHECK_ARGUMENT_FOR_NULL(ros_request, RMW_RET_INVALID_ARGUMENT);
+  RCUTILS_CHECK_ARGUMENT_FOR_NULL(sequence_id, RMW_RET_INVALID_ARGUMENT);
+  if (client->implementation_identifier != rmw_get_implementation_identifier()) {
+    return RMW_RET_INCORRECT_RMW_IMPLEMENTATION;
+  }
+
+  return send_request(client, NULL, ros_request, sequence_id);
+}
+
+rmw_ret_t
+rmw_hazcat_take_loaned_response(
+  const rmw_client_t * client,
+  rmw_service_info_t * request_header,
+  void ** ros_response,
+  bool * taken)
+{
+  RCUTILS_CHECK_ARGUMENT_FOR_NULL(client, RMW_RET_INVALID_ARGUMENT);
+  RCUTILS_CHECK_ARGUMENT_FOR_NULL(request_header, RMW_RET_INVALID_ARGUMENT);
+  RCUTILS_CHECK_ARGUMENT_FOR_NULL(ros_response, RMW_RET_INVALID_ARGUMENT);
+  RCUTILS_CHECK_ARGUMENT_FOR_NULL(taken, RMW_RET_INVALID_ARGUMENT);
+  if (client->implementation_identifier != rmw_get_implementation_identifier()) {
+    return RMW_RET_INCORRECT_RMW_IMPLEMENTATION;
+  }
+
+  return hazcat_srv_clt_take_loaned(
+    &((srv_clt_info_t *)client->data)->queue, request_header, ros_response, taken);
+}
+
+rmw_ret_t
+rmw_hazcat_return_loaned_response_from_client(const rmw_client_t * client, void * ros_response)
+{
+  RCUTILS_CHECK_ARGUMENT_FOR_NULL(client, RMW_RET_INVALID_ARGUMENT);
+  RCUTILS_CHECK_ARGUMENT_FOR_NULL(ros_response, RMW_RET_INVALID_ARGUMENT);
+  if (client->implementation_identifier != rmw_get_implementation_identifier()) {
+    return RMW_RET_INCORRECT_RMW_IMPLEMENTATION;
+  }
 
-  RMW_SET_ERROR_MSG("rmw_take_response hasn't been implemented yet");
-  return RMW_RET_UNSUPPORTED;
+  return hazcat_srv_clt_return_taken(&((srv_clt_info_t *)client->data)->queue, ros_response);
 }
 
 #ifdef __cplusplus
@@ -12,12 +12,15 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <string.h>
+
 #include "rcutils/allocator.h"
 #include "rcutils/error_handling.h"
 #include "rcutils/logging_macros.h"
 #include "rcutils/strdup.h"
 #include "rcutils/types.h"
 
+#include "rmw/allocators.h"
 #include "rmw/error_handling.h"
 #include "rmw/rmw.h"
 #include "rmw/get_node_info_and_types.h"
@@ -30,10 +33,38 @@
 
 #include "hazcat/hazcat_message_queue.h"
 
+#include "rmw_hazcat/hazcat_pub_sub.h"
+#include "rmw_hazcat/hazcat_ros_graph.h"
+
 #ifdef __cplusplus
 extern "C"
 {
 #endif
+
+// Queue subscription counts include the subscriptions TRANSIENT_LOCAL publishers keep their
+// history with, which aren't subscriptions as far as ROS is concerned
+static size_t
+without_retainers(uint32_t sub_count, uint32_t retainers)
+{
+  return (sub_count > retainers) ? sub_count - retainers : 0;
+}
+
+static rmw_ret_t
+validate_topic_name(const char * topic_name)
+{
+  int validation_result = RMW_TOPIC_VALID;
+  rmw_ret_t ret = rmw_validate_full_topic_name(topic_name, &validation_result, NULL);
+  if (RMW_RET_OK != ret) {
+    return ret;
+  }
+  if (RMW_TOPIC_VALID != validation_result) {
+    const char * reason = rmw_full_topic_name_validation_result_string(validation_result);
+    RMW_SET_ERROR_MSG_WITH_FORMAT_STRING("topic_name argument is invalid: %s", reason);
+    return RMW_RET_INVALID_ARGUMENT;
+  }
+  return RMW_RET_OK;
+}
+
 rmw_ret_t
 rmw_count_publishers(
   const rmw_node_t * node,
@@ -46,19 +77,14 @@ rmw_count_publishers(
   if (node->implementation_identifier != rmw_get_implementation_identifier()) {
     return RMW_RET_INCORRECT_RMW_IMPLEMENTATION;
   }
-  int validation_result = RMW_NODE_NAME_VALID;
-  rmw_ret_t ret = rmw_validate_node_name(topic_name, &validation_result, NULL);
+  rmw_ret_t ret = validate_topic_name(topic_name);
   if (RMW_RET_OK != ret) {
     return ret;
   }
-  if (RMW_NODE_NAME_VALID != validation_result) {
-    const char * reason = rmw_node_name_validation_result_string(validation_result);
-    RMW_SET_ERROR_MSG_WITH_FORMAT_STRING("node_name argument is invalid: %s", reason);
-    return RMW_RET_INVALID_ARGUMENT;
-  }
 
-  RMW_SET_ERROR_MSG("rmw_count_publishers hasn't been implemented yet");
-  return RMW_RET_UNSUPPORTED;
+  hazcat_graph_topic_counts(topic_name, count, NULL);
+
+  return RMW_RET_OK;
 }
 
 rmw_ret_t
@@ -73,19 +99,14 @@ rmw_count_subscribers(
   if (node->implementation_identifier != rmw_get_implementation_identifier()) {
     return RMW_RET_INCORRECT_RMW_IMPLEMENTATION;
   }
-  int validation_result = RMW_NODE_NAME_VALID;
-  rmw_ret_t ret = rmw_validate_node_name(topic_name, &validation_result, NULL);
+  rmw_ret_t ret = validate_topic_name(topic_name);
   if (RMW_RET_OK != ret) {
     return ret;
   }
-  if (RMW_NODE_NAME_VALID != validation_result) {
-    const char * reason = rmw_node_name_validation_result_string(validation_result);
-    RMW_SET_ERROR_MSG_WITH_FORMAT_STRING("node_name argument is invalid: %s", reason);
-    return RMW_RET_INVALID_ARGUMENT;
-  }
 
-  RMW_SET_ERROR_MSG("rmw_count_subscribers hasn't been implemented yet");
-  return RMW_RET_UNSUPPORTED;
+  hazcat_graph_topic_counts(topic_name, NULL, count);
+
+  return RMW_RET_OK;
 }
 
 rmw_ret_t
@@ -99,7 +120,8 @@ rmw_subscription_count_matched_publishers(
     return RMW_RET_INCORRECT_RMW_IMPLEMENTATION;
   }
 
-  *publisher_count = ((pub_sub_data_t *)subscription->data)->mq->elem->pub_count;
+  *publisher_count =
+    __atomic_load_n(&((pub_sub_data_t *)subscription->data)->mq->elem->pub_count, __ATOMIC_RELAXED);
 
   return RMW_RET_OK;
 }
@@ -115,7 +137,10 @@ rmw_publisher_count_matched_subscriptions(
     return RMW_RET_INCORRECT_RMW_IMPLEMENTATION;
   }
 
-  *subscription_count = ((pub_sub_data_t *)publisher->data)->mq->elem->sub_count;
+  pub_sub_info_t * info = (pub_sub_info_t *)publisher->data;
+  *subscription_count = without_retainers(
+    __atomic_load_n(&info->data.mq->elem->sub_count, __ATOMIC_RELAXED),
+    (NULL == info->topic) ? 0 : __atomic_load_n(&info->topic->retainers, __ATOMIC_RELAXED));
 
   return RMW_RET_OK;
 }
@@ -13,9 +13,13 @@
 // limitations under the License.
 
 #include "rcutils/error_handling.h"
+#include "rmw/error_handling.h"
 #include "rmw/event.h"
 #include "rmw/rmw.h"
 
+#include "rmw_hazcat/hazcat_pub_sub.h"
+#include "rmw_hazcat/hazcat_qos.h"
+
 #ifdef __cplusplus
 extern "C"
 {
@@ -28,12 +32,17 @@ rmw_publisher_event_init(
 {
   RCUTILS_CHECK_ARGUMENT_FOR_NULL(rmw_event, RMW_RET_INVALID_ARGUMENT);
   RCUTILS_CHECK_ARGUMENT_FOR_NULL(publisher, RMW_RET_INVALID_ARGUMENT);
+  if (RMW_EVENT_OFFERED_DEADLINE_MISSED != event_type &&
+    RMW_EVENT_OFFERED_QOS_INCOMPATIBLE != event_type && RMW_EVENT_LIVELINESS_LOST != event_type)
+  {
+    RMW_SET_ERROR_MSG("Event type isn't a publisher event");
+    return RMW_RET_UNSUPPORTED;
+  }
 
   rmw_event->event_type = event_type;
-  rmw_event->implementation_identifier = rmw_get_implementation_identifier;
+  rmw_event->implementation_identifier = rmw_get_implementation_identifier();
   rmw_event->data = publisher;
 
-  /// @todo add publisher events support
   return RMW_RET_OK;
 }
 
@@ -45,12 +54,113 @@ rmw_subscription_event_init(
 {
   RCUTILS_CHECK_ARGUMENT_FOR_NULL(rmw_event, RMW_RET_INVALID_ARGUMENT);
   RCUTILS_CHECK_ARGUMENT_FOR_NULL(subscription, RMW_RET_INVALID_ARGUMENT);
+  if (RMW_EVENT_REQUESTED_DEADLINE_MISSED != event_type &&
+    RMW_EVENT_REQUESTED_QOS_INCOMPATIBLE != event_type && RMW_EVENT_MESSAGE_LOST != event_type &&
+    RMW_EVENT_LIVELINESS_CHANGED != event_type)
+  {
+    RMW_SET_ERROR_MSG("Event type isn't a subscription event");
+    return RMW_RET_UNSUPPORTED;
+  }
 
   rmw_event->event_type = event_type;
-  rmw_event->implementation_identifier = rmw_get_implementation_identifier;
+  rmw_event->implementation_identifier = rmw_get_implementation_identifier();
   rmw_event->data = subscription;
 
-  /// @todo add subscription events support
+  return RMW_RET_OK;
+}
+
+// Publisher or subscription an event was made for
+static pub_sub_info_t *
+event_endpoint(const rmw_event_t * event)
+{
+  switch (event->event_type) {
+    case RMW_EVENT_REQUESTED_DEADLINE_MISSED:
+    case RMW_EVENT_REQUESTED_QOS_INCOMPATIBLE:
+    case RMW_EVENT_MESSAGE_LOST:
+      return (pub_sub_info_t *)((const rmw_subscription_t *)event->data)->data;
+    case RMW_EVENT_OFFERED_DEADLINE_MISSED:
+    case RMW_EVENT_OFFERED_QOS_INCOMPATIBLE:
+      return (pub_sub_info_t *)((const rmw_publisher_t *)event->data)->data;
+    default:
+      return NULL;
+  }
+}
+
+// Messages lost by a subscription, whether it was lapped in its message queue or best effort ring
+static uint64_t
+messages_lost(pub_sub_info_t * info)
+{
+  uint64_t lost = hazcat_graph_add_lost(info->graph_id, 0);
+  if (NULL != info->best_effort) {
+    lost += info->best_effort->lost;
+  }
+  return lost;
+}
+
+bool
+hazcat_event_ready(const rmw_event_t * event)
+{
+  pub_sub_info_t * info = event_endpoint(event);
+  rmw_qos_policy_kind_t policy;
+  switch (event->event_type) {
+    case RMW_EVENT_REQUESTED_DEADLINE_MISSED:
+    case RMW_EVENT_OFFERED_DEADLINE_MISSED:
+      return hazcat_deadline_pending(&info->deadline);
+    case RMW_EVENT_REQUESTED_QOS_INCOMPATIBLE:
+    case RMW_EVENT_OFFERED_QOS_INCOMPATIBLE:
+      return hazcat_graph_incompatible(info->graph_id, &policy) > info->incompatible_reported;
+    case RMW_EVENT_MESSAGE_LOST:
+      // Losses are noticed when the next message is looked at
+      hazcat_subscription_ready(info);
+      return messages_lost(info) > info->lost_reported;
+    default:
+      return false;
+  }
+}
+
+rmw_ret_t
+rmw_take_event(const rmw_event_t * event_handle, void * event_info, bool * taken)
+{
+  RCUTILS_CHECK_ARGUMENT_FOR_NULL(event_handle, RMW_RET_INVALID_ARGUMENT);
+  RCUTILS_CHECK_ARGUMENT_FOR_NULL(event_info, RMW_RET_INVALID_ARGUMENT);
+  RCUTILS_CHECK_ARGUMENT_FOR_NULL(taken, RMW_RET_INVALID_ARGUMENT);
+  if (event_handle->implementation_identifier != rmw_get_implementation_identifier()) {
+    return RMW_RET_INCORRECT_RMW_IMPLEMENTATION;
+  }
+
+  // Statuses of the requested and offered side of an event have the same layout
+  pub_sub_info_t * info = event_endpoint(event_handle);
+  *taken = true;
+  switch (event_handle->event_type) {
+    case RMW_EVENT_REQUESTED_DEADLINE_MISSED:
+    case RMW_EVENT_OFFERED_DEADLINE_MISSED: {
+        rmw_requested_deadline_missed_status_t * status = event_info;
+        hazcat_deadline_take(&info->deadline, &status->total_count, &status->total_count_change);
+        break;
+      }
+    case RMW_EVENT_REQUESTED_QOS_INCOMPATIBLE:
+    case RMW_EVENT_OFFERED_QOS_INCOMPATIBLE: {
+        rmw_qos_incompatible_event_status_t * status = event_info;
+        uint32_t total = hazcat_graph_incompatible(info->graph_id, &status->last_policy_kind);
+        status->total_count = total;
+        status->total_count_change = total - info->incompatible_reported;
+        info->incompatible_reported = total;
+        break;
+      }
+    case RMW_EVENT_MESSAGE_LOST: {
+        rmw_message_lost_status_t * status = event_info;
+        uint64_t total = messages_lost(info);
+        status->total_count = total;
+        status->total_count_change = total - info->lost_reported;
+        info->lost_reported = total;
+        break;
+      }
+    default:
+      // Liveliness is never lost with this rmw
+      *taken = false;
+      break;
+  }
+
   return RMW_RET_OK;
 }
 #ifdef __cplusplus
@@ -20,6 +20,8 @@
 
 #include "hazcat/hazcat_message_queue.h"
 
+#include "rmw_hazcat/hazcat_ros_graph.h"
+
 #ifdef __cplusplus
 extern "C"
 {
@@ -133,10 +135,23 @@ rmw_init(const rmw_init_options_t * options, rmw_context_t * context)
   context->impl = (void *)-1;
   rmw_ret_t ret = rmw_init_options_copy(options, &context->options);
   if (RMW_RET_OK != ret) {
+    *context = rmw_get_zero_initialized_context();
     return ret;
   }
 
-  return hazcat_init();
+  ret = hazcat_init();
+  if (RMW_RET_OK != ret) {
+    rmw_init_options_fini(&context->options);
+    *context = rmw_get_zero_initialized_context();
+    return ret;
+  }
+  ret = hazcat_graph_init();
+  if (RMW_RET_OK != ret) {
+    hazcat_fini();
+    rmw_init_options_fini(&context->options);
+    *context = rmw_get_zero_initialized_context();
+  }
+  return ret;
 }
 
 rmw_ret_t
@@ -156,6 +171,10 @@ rmw_shutdown(rmw_context_t * context)
 
   context->impl = NULL;
 
+  rmw_ret_t ret = hazcat_graph_fini();
+  if (RMW_RET_OK != ret) {
+    return ret;
+  }
   return hazcat_fini();
 }
 
@@ -20,6 +20,7 @@
 #include "rmw/validate_node_name.h"
 
 #include "rmw_hazcat/hazcat_node.h"
+#include "rmw_hazcat/hazcat_ros_graph.h"
 
 #ifdef __cplusplus
 extern "C"
@@ -102,6 +103,18 @@ rmw_create_node(
 
   node->context = context;
 
+  ret = hazcat_graph_register_node(
+    name, namespace_, context->options.enclave,
+    ((construct_node_info__ *)node->data)->guard_condition,
+    &((construct_node_info__ *)node->data)->graph_id);
+  if (RMW_RET_OK != ret) {
+    rmw_free(node->namespace_);
+    rmw_free(node->name);
+    rmw_free(node->data);
+    rmw_free(node);
+    return NULL;
+  }
+
   return node;
 }
 
@@ -113,6 +126,11 @@ rmw_destroy_node(rmw_node_t * node)
     return RMW_RET_INCORRECT_RMW_IMPLEMENTATION;
   }
 
+  rmw_ret_t ret = hazcat_graph_unregister_node(((node_info_t *)node->data)->graph_id_);
+  if (RMW_RET_OK != ret) {
+    return ret;
+  }
+
   rmw_free(node->namespace_);
   rmw_free(node->name);
   rmw_free(node->data);
@@ -157,8 +175,7 @@ rmw_get_node_names(
     return RMW_RET_INVALID_ARGUMENT;
   }
 
-  RMW_SET_ERROR_MSG("rmw_node_get_graph_guard_condition hasn't been implemented yet");
-  return RMW_RET_UNSUPPORTED;
+  return hazcat_graph_get_node_names(node_names, node_namespaces, NULL);
 }
 
 rmw_ret_t
@@ -185,8 +202,7 @@ rmw_get_node_names_with_enclaves(
     return RMW_RET_INVALID_ARGUMENT;
   }
 
-  RMW_SET_ERROR_MSG("rmw_node_get_graph_guard_condition hasn't been implemented yet");
-  return RMW_RET_UNSUPPORTED;
+  return hazcat_graph_get_node_names(node_names, node_namespaces, enclaves);
 }
 #ifdef __cplusplus
 }
@@ -28,6 +28,8 @@
 #include "rmw/validate_namespace.h"
 #include "rmw/validate_node_name.h"
 
+#include "rmw_hazcat/hazcat_ros_graph.h"
+
 #ifdef __cplusplus
 extern "C"
 {
@@ -75,10 +77,10 @@ rmw_get_subscriber_names_and_types_by_node(
   if (RMW_RET_OK != ret) {
     return ret;
   }
-  (void) no_demangle; \
+  (void) no_demangle;
 
-  RMW_SET_ERROR_MSG("rmw_get_subscriber_names_and_types_by_node hasn't been implemented yet");
-  return RMW_RET_UNSUPPORTED;
+  return hazcat_graph_get_names_and_types(
+    GRAPH_SUBSCRIPTION, node_name, node_namespace, allocator, topic_names_and_types);
 }
 
 rmw_ret_t
@@ -126,8 +128,8 @@ rmw_get_publisher_names_and_types_by_node(
   }
   (void) no_demangle;
 
-  RMW_SET_ERROR_MSG("rmw_get_publisher_names_and_types_by_node hasn't been implemented yet");
-  return RMW_RET_UNSUPPORTED;
+  return hazcat_graph_get_names_and_types(
+    GRAPH_PUBLISHER, node_name, node_namespace, allocator, topic_names_and_types);
 }
 
 rmw_ret_t
@@ -173,8 +175,8 @@ rmw_get_service_names_and_types_by_node(
     return ret;
   }
 
-  RMW_SET_ERROR_MSG("rmw_get_service_names_and_types_by_node hasn't been implemented yet");
-  return RMW_RET_UNSUPPORTED;
+  return hazcat_graph_get_names_and_types(
+    GRAPH_SERVICE, node_name, node_namespace, allocator, service_names_and_types);
 }
 
 rmw_ret_t
@@ -191,14 +193,13 @@ rmw_get_service_names_and_types(
   }
   RCUTILS_CHECK_ALLOCATOR_WITH_MSG(
     allocator, "allocator argument is invalid", return RMW_RET_INVALID_ARGUMENT);
-  int validation_result = RMW_NODE_NAME_VALID;
   rmw_ret_t ret = rmw_names_and_types_check_zero(service_names_and_types);
   if (RMW_RET_OK != ret) {
     return ret;
   }
 
-  RMW_SET_ERROR_MSG("rmw_get_service_names_and_types hasn't been implemented yet");
-  return RMW_RET_UNSUPPORTED;
+  return hazcat_graph_get_names_and_types(
+    GRAPH_SERVICE | GRAPH_CLIENT, NULL, NULL, allocator, service_names_and_types);
 }
 
 rmw_ret_t
@@ -244,8 +245,8 @@ rmw_get_client_names_and_types_by_node(
     return ret;
   }
 
-  RMW_SET_ERROR_MSG("rmw_get_client_names_and_types_by_node hasn't been implemented yet");
-  return RMW_RET_UNSUPPORTED;
+  return hazcat_graph_get_names_and_types(
+    GRAPH_CLIENT, node_name, node_namespace, allocator, service_names_and_types);
 }
 
 rmw_ret_t
@@ -269,8 +270,8 @@ rmw_get_topic_names_and_types(
   }
   (void)no_demangle;
 
-  RMW_SET_ERROR_MSG("rmw_get_topic_names_and_types hasn't been implemented yet");
-  return RMW_RET_UNSUPPORTED;
+  return hazcat_graph_get_names_and_types(
+    GRAPH_PUBLISHER | GRAPH_SUBSCRIPTION, NULL, NULL, allocator, topic_names_and_types);
 }
 #ifdef __cplusplus
 }
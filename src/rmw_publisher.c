@@ -12,6 +12,10 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <stdint.h>
+#include <unistd.h>
+
+#include "rcutils/time.h"
 
 #include "rmw/error_handling.h"
 #include "rmw/rmw.h"
@@ -24,9 +28,16 @@
 #include "rmw/validate_namespace.h"
 #include "rmw/validate_node_name.h"
 
-#include "hazcat_allocators/cpu_ringbuf_allocator.h"
 #include "hazcat/hazcat_message_queue.h"
 
+#include "rmw_hazcat/hazcat_alloc.h"
+#include "rmw_hazcat/hazcat_mq.h"
+#include "rmw_hazcat/hazcat_node.h"
+#include "rmw_hazcat/hazcat_pub_sub.h"
+#include "rmw_hazcat/hazcat_qos.h"
+#include "rmw_hazcat/hazcat_ros_graph.h"
+#include "rmw_hazcat/hazcat_serialize.h"
+
 #ifdef __cplusplus
 extern "C"
 {
@@ -38,13 +49,270 @@ generate_gid()
   gid.implementation_identifier = rmw_get_implementation_identifier();
   memset(&gid.data[0], 0, RMW_GID_STORAGE_SIZE);
 
+  // Counter alone is only unique within this process, pid makes it unique on the host, which the
+  // ros graph relies on to tell endpoints apart
   static size_t dummy_guid = 0;
-  dummy_guid++;
-  memcpy(&gid.data[0], &dummy_guid, sizeof(size_t));
+  size_t guid = __atomic_add_fetch(&dummy_guid, 1, __ATOMIC_RELAXED);
+  pid_t pid = getpid();
+  memcpy(&gid.data[0], &guid, sizeof(size_t));
+  memcpy(&gid.data[sizeof(size_t)], &pid, sizeof(pid_t));
 
   return gid;
 }
 
+// Allocates from a publisher's allocator. On failure, crashed subscribers may be what's pinning
+// its memory, so reclaim their references and try once more
+rmw_ret_t
+allocate_message(hma_allocator_t * alloc, size_t size, hazcat_offset_t * offset)
+{
+  rmw_ret_t ret = hazcat_allocate(alloc, size, offset);
+  if (RMW_RET_BAD_ALLOC == ret && hazcat_graph_reclaim() > 0) {
+    ret = hazcat_allocate(alloc, size, offset);
+  }
+  return ret;
+}
+
+// How long a KEEP_ALL publisher waits on slow subscriptions before giving up, same as the default
+// max_blocking_time of DDS implementations
+#define KEEP_ALL_BLOCKING_TIME  RCUTILS_MS_TO_NS(100)
+
+// Whether the slot the next publish goes into has been read by every subscription
+static bool
+slot_drained(pub_sub_data_t * data)
+{
+  message_queue_t * mq = data->mq->elem;
+  uint32_t index = __atomic_load_n(&mq->index, __ATOMIC_ACQUIRE) % mq->len;
+  return 0 == __atomic_load_n(&hazcat_mq_ref_bits(mq, index)->interest_count, __ATOMIC_ACQUIRE);
+}
+
+// Whether this publisher's message in a queue entry, which is in its allocator. Publishers of a
+// topic may share an allocator, so it's told by the gid in the header
+static bool
+own_message(pub_sub_info_t * info, const entry_t * entry)
+{
+  hma_allocator_t * alloc = info->data.alloc;
+  if (entry->alloc_shmem_id != alloc->shmem_id) {
+    return false;
+  }
+  const msg_header_t * header = GET_PTR(alloc, entry->offset, msg_header_t);
+  return 0 == memcmp(header->publisher_gid, info->data.gid.data, RMW_GID_STORAGE_SIZE);
+}
+
+// Whether every message of this publisher still in the queue has been taken by every subscription.
+// Messages retained for late joiners only count as taken by the real subscriptions
+static bool
+all_acked(pub_sub_info_t * info)
+{
+  message_queue_t * mq = info->data.mq->elem;
+  int domain = hazcat_mq_domain_index(mq, info->data.alloc->domain);
+  if (-1 == domain) {
+    return true;
+  }
+
+  uint32_t len = mq->len;
+  uint32_t index = __atomic_load_n(&mq->index, __ATOMIC_ACQUIRE) % len;
+  uint32_t retained = 0;
+  if (NULL != info->retainer) {
+    uint32_t next = info->retainer->next_index;
+    retained = (index >= next) ? index - next : index + len - next;
+  }
+  for (uint32_t i = 0; i < len; i++) {
+    ref_bits_t * bits = hazcat_mq_ref_bits(mq, i);
+    uint16_t interest = __atomic_load_n(&bits->interest_count, __ATOMIC_ACQUIRE);
+    if (0 == interest || !(bits->availability & (1 << domain)) ||
+      !own_message(info, hazcat_mq_entry(mq, domain, i)))
+    {
+      continue;
+    }
+    // The retainer still holds the newest retained slots, the ones written just before index
+    uint32_t age = (index > i) ? index - i : index + len - i;
+    if (interest > ((age <= retained) ? 1 : 0)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// A TRANSIENT_LOCAL publisher keeps the last depth messages of its topic around for late joining
+// subscriptions. It does so with a subscription of its own, whose interest keeps those messages
+// in the queue, and which only reads a message once it falls out of that window
+static rmw_ret_t
+create_retainer(pub_sub_info_t * info, const char * topic_name)
+{
+  pub_sub_data_t * retainer = rmw_allocate(sizeof(pub_sub_data_t));
+  if (NULL == retainer) {
+    RMW_SET_ERROR_MSG("Unable to allocate memory for publisher history");
+    return RMW_RET_BAD_ALLOC;
+  }
+  retainer->alloc = info->data.alloc;
+  retainer->depth = info->data.depth;
+  retainer->msg_size = info->data.msg_size;
+  retainer->gid = generate_gid();
+  retainer->context = info->data.context;
+  sem_init(&retainer->lock, 0, 1);
+
+  rmw_ret_t ret = hazcat_register_subscription(retainer, topic_name);
+  if (RMW_RET_OK != ret) {
+    sem_destroy(&retainer->lock);
+    rmw_free(retainer);
+    return ret;
+  }
+  info->retainer = retainer;
+  return RMW_RET_OK;
+}
+
+// Reads (and so releases) the oldest retained message once depth of them are being held
+static void
+retire_retained(pub_sub_info_t * info, bool all)
+{
+  pub_sub_data_t * retainer = info->retainer;
+  message_queue_t * mq = retainer->mq->elem;
+  uint32_t len = mq->len;
+  uint32_t index = __atomic_load_n(&mq->index, __ATOMIC_ACQUIRE);
+  uint32_t next = retainer->next_index;
+  uint32_t held = (index >= next) ? index - next : index + len - next;
+  if (held > len) {
+    held = len;
+  }
+
+  for (; held > 0 && (all || held >= info->data.depth); held--) {
+    msg_ref_t msg_ref = hazcat_take(retainer);
+    if (NULL == msg_ref.msg) {
+      break;
+    }
+    hazcat_deallocate(msg_ref.alloc, hazcat_offset_of(msg_ref.alloc, msg_ref.msg));
+  }
+}
+
+static void
+destroy_retainer(pub_sub_info_t * info)
+{
+  retire_retained(info, true);
+  hazcat_graph_topic_depart(info->topic);
+  hazcat_unregister_subscription(info->retainer);
+  sem_destroy(&info->retainer->lock);
+  rmw_free(info->retainer);
+  info->retainer = NULL;
+}
+
+// Held by a publisher while it publishes a message, more than subscriptions could ever release, so
+// none of them frees it before the publisher knows how many took an interest
+#define PUBLISH_REFS  (1 << 24)
+
+// KEEP_LAST publishers overwrite the oldest slot whether or not it was read. Subscriptions that
+// hadn't taken its message never will, so their references are released before the slot is reused.
+// Queues with allocators counting references never span domains, so the entry of the publisher's
+// domain is the one they hold
+static void
+release_lapped(pub_sub_data_t * data)
+{
+  message_queue_t * mq = data->mq->elem;
+  int domain = hazcat_mq_domain_index(mq, data->alloc->domain);
+  uint32_t index = __atomic_load_n(&mq->index, __ATOMIC_ACQUIRE);
+  ref_bits_t * bits = hazcat_mq_ref_bits(mq, index % mq->len);
+  hazcat_mq_slot_lock(bits);
+  // Another publisher may have reused the slot meanwhile
+  uint32_t current = __atomic_load_n(&mq->index, __ATOMIC_ACQUIRE);
+  if (index != current || 0 == bits->interest_count) {
+    hazcat_mq_slot_unlock(bits);
+    return;
+  }
+  if (-1 != domain && (bits->availability & (1 << domain))) {
+    hazcat_share_entry(
+      hazcat_mq_entry(mq, domain, index % mq->len), data->alloc, -(int64_t)bits->interest_count);
+  }
+  bits->interest_count = 0;
+  bits->availability = 0;
+  hazcat_mq_slot_unlock(bits);
+}
+
+// Stamps a message's header and sends it. Hazcat messages must sit right after their header, and
+// are handed over to subscriptions once sent. Best effort ones are copied into the ring, and the
+// caller keeps ownership of them, as it does of any message that fails to send
+static rmw_ret_t
+send_message(pub_sub_info_t * info, msg_header_t * header, const void * msg, size_t size)
+{
+  rcutils_system_time_now(&header->source_timestamp);
+  int64_t lifespan = hazcat_qos_duration(info->qos.lifespan);
+  header->expiry = (0 == lifespan) ? 0 : header->source_timestamp + lifespan;
+  header->sequence_number = __atomic_add_fetch(&info->sequence_number, 1, __ATOMIC_RELAXED);
+  memcpy(header->publisher_gid, info->data.gid.data, RMW_GID_STORAGE_SIZE);
+  hazcat_deadline_message(&info->deadline, header->source_timestamp);
+
+  if (NULL != info->best_effort) {
+    return hazcat_be_publish(info->best_effort, header, sizeof(msg_header_t), msg, size);
+  }
+  release_lapped(&info->data);
+
+  // Each subscription with an interest releases a reference once done with the message, and the
+  // publisher's own is given up once it's published. Hazcat gives the message an interest for each
+  // subscription registered as it publishes, which is counted afterwards. Those registered since
+  // are counted too, which can only keep the message around longer than needed. Those that left
+  // since are added back, as they may have taken the message and released their reference first
+  hma_allocator_t * alloc = info->data.alloc;
+  hazcat_offset_t offset = hazcat_offset_of(alloc, header);
+  if (!hazcat_counts_references(alloc)) {
+    return hazcat_publish(&info->data, header, sizeof(msg_header_t) + size);
+  }
+  hazcat_share(alloc, offset, PUBLISH_REFS);
+  uint32_t departed = hazcat_graph_topic_departed(info->topic);
+  rmw_ret_t ret = hazcat_publish(&info->data, header, sizeof(msg_header_t) + size);
+  if (RMW_RET_OK != ret) {
+    hazcat_share(alloc, offset, -PUBLISH_REFS);
+    return ret;
+  }
+  int64_t interested = __atomic_load_n(&info->data.mq->elem->sub_count, __ATOMIC_SEQ_CST);
+  interested += (uint32_t)(hazcat_graph_topic_departed(info->topic) - departed);
+  hazcat_share(alloc, offset, interested - PUBLISH_REFS - 1);
+  return RMW_RET_OK;
+}
+
+// Makes room for a publish, allocating size bytes if offset is non-null. KEEP_LAST publishers
+// overwrite whatever is oldest, while KEEP_ALL publishers never overwrite a message a subscription
+// hasn't read yet. They sleep until subscriptions drain the next slot and free up memory, giving
+// up with RMW_RET_TIMEOUT after KEEP_ALL_BLOCKING_TIME
+static rmw_ret_t
+reserve_message(pub_sub_info_t * info, size_t size, hazcat_offset_t * offset)
+{
+  hma_allocator_t * alloc = info->data.alloc;
+  if (NULL != info->retainer) {
+    retire_retained(info, false);
+    hazcat_graph_set_cursor(info->graph_id, info->retainer->next_index);
+  }
+  if (RMW_QOS_POLICY_HISTORY_KEEP_ALL != info->qos.history) {
+    if (NULL != offset && RMW_RET_OK != allocate_message(alloc, size, offset)) {
+      RMW_SET_ERROR_MSG("unable to allocate memory for message");
+      return RMW_RET_ERROR;
+    }
+    return RMW_RET_OK;
+  }
+
+  rcutils_time_point_value_t start, now;
+  rcutils_steady_time_now(&start);
+  now = start;
+  bool reclaimed = false;
+  while (true) {
+    uint32_t seen = hazcat_graph_topic_prepare_wait(info->topic);
+    if (slot_drained(&info->data) &&
+      (NULL == offset || RMW_RET_OK == allocate_message(alloc, size, offset)))
+    {
+      hazcat_graph_topic_cancel_wait(info->topic);
+      return RMW_RET_OK;
+    }
+    if (RMW_RET_TIMEOUT ==
+      hazcat_graph_topic_wait(info->topic, seen, KEEP_ALL_BLOCKING_TIME - (now - start)))
+    {
+      // Crashed subscriptions never drain anything, so give reclaiming them one chance
+      if (reclaimed || 0 == hazcat_graph_reclaim()) {
+        RMW_SET_ERROR_MSG("Timed out waiting on subscriptions to keep up");
+        return RMW_RET_TIMEOUT;
+      }
+      reclaimed = true;
+    }
+    rcutils_steady_time_now(&now);
+  }
+}
+
 rmw_ret_t
 rmw_init_publisher_allocation(
   const rosidl_message_type_support_t * type_support,
@@ -100,10 +368,18 @@ rmw_create_publisher(
     RMW_SET_ERROR_MSG("Invalid QoS policy");
     return NULL;
   }
-  // if (qos_policies->durability == RMW_QOS_POLICY_DURABILITY_VOLATILE) {
-  //   RMW_SET_ERROR_MSG("All publishers have transient local durability in rmw_hazcat");
-  //   return NULL;
-  // }
+  const rosidl_message_type_support_t * ts = get_type_support(type_supports);
+  if (NULL == ts) {
+    RMW_SET_ERROR_MSG("Unsupported typesupport");
+    return NULL;
+  }
+  // Strings and sequences are flattened into shared memory, which relies on C's layout of them
+  if (!hazcat_c_type_support(ts) &&
+    !hazcat_fixed_size((const rosidl_typesupport_introspection_c__MessageMembers *)ts->data))
+  {
+    RMW_SET_ERROR_MSG("Messages with strings or sequences need the C introspection typesupport");
+    return NULL;
+  }
   // if (qos_policies->reliability == RMW_QOS_POLICY_RELIABILITY_BEST_EFFORT) {
   //   RMW_SET_ERROR_MSG("Best effort qos not supported in rmw_hazcat");
   //   return NULL;
@@ -122,35 +398,47 @@ rmw_create_publisher(
     RMW_SET_ERROR_MSG("Unable to allocate memory for publisher");
     return NULL;
   }
-  pub_sub_data_t * data = rmw_allocate(sizeof(pub_sub_data_t));
-  if (NULL == data) {
+  pub_sub_info_t * info = rmw_allocate(sizeof(pub_sub_info_t));
+  if (NULL == info) {
     RMW_SET_ERROR_MSG("Unable to allocate memory for publisher info");
     return NULL;
   }
+  pub_sub_data_t * data = &info->data;
 
   // Populate data->alloc with allocator specified (all other fields are set during registration)
+  data->depth = hazcat_qos_depth(qos_policies);
+  info->members = (const rosidl_typesupport_introspection_c__MessageMembers *)ts->data;
+  info->fixed_size = hazcat_fixed_size(info->members);
   data->alloc = (hma_allocator_t *)publisher_options->rmw_specific_publisher_payload;
   if (NULL == data->alloc) {
-    // TODO(nightduck): Replace hard coded values when serialization works
-    //                  Remove all together when TLSF allocator is done
-    data->alloc =
-      create_cpu_ringbuf_allocator(msg_size, qos_policies->depth);
+    data->alloc = hazcat_default_allocator(
+      info->members, topic_name, sizeof(msg_header_t) + msg_size, data->depth);
     if (NULL == data->alloc) {
       RMW_SET_ERROR_MSG("Unable to create allocator for publisher");
       return NULL;
     }
   }
-  data->depth = (qos_policies->depth > 1) ? qos_policies->depth : 1;
-  data->msg_size = msg_size;
+  data->msg_size = sizeof(msg_header_t) + msg_size;
   data->gid = generate_gid();
   data->context = node->context;
   sem_init(&data->lock, 0, 1);
+  info->qos = *qos_policies;
+  info->qos.depth = data->depth;
+  info->retainer = NULL;
+  info->best_effort = NULL;
+  info->topic = NULL;
+  info->sequence_number = 0;
+  info->incompatible_reported = 0;
+  if (RMW_RET_OK != hazcat_deadline_init(&info->deadline, qos_policies->deadline)) {
+    return NULL;
+  }
 
   pub->implementation_identifier = rmw_get_implementation_identifier();
-  pub->data = data;
+  pub->data = info;
   pub->topic_name = rmw_allocate(strlen(topic_name) + 1);
   pub->options = *publisher_options;
-  pub->can_loan_messages = true;
+  // Loans are handed out as they sit in shared memory, only fixed size messages read the same there
+  pub->can_loan_messages = info->fixed_size;
 
   if (NULL == pub->topic_name) {
     RMW_SET_ERROR_MSG("Unable to allocate string for publisher's topic name");
@@ -161,6 +449,58 @@ rmw_create_publisher(
   if (RMW_RET_OK != (ret = hazcat_register_publisher(pub->data, pub->topic_name))) {
     return NULL;
   }
+  if (RMW_QOS_POLICY_RELIABILITY_BEST_EFFORT == qos_policies->reliability) {
+    // Best effort publishes always overwrite the oldest message, and there's no history to keep
+    // for late joiners once it has
+    info->qos.history = RMW_QOS_POLICY_HISTORY_KEEP_LAST;
+    info->best_effort = rmw_allocate(sizeof(be_endpoint_t));
+    if (NULL == info->best_effort || RMW_RET_OK != (ret = hazcat_be_attach(
+        info->best_effort, pub->topic_name, data->msg_size, data->depth, false)))
+    {
+      rmw_free(info->best_effort);
+      hazcat_unregister_publisher(pub->data);
+      return NULL;
+    }
+  } else if (RMW_QOS_POLICY_DURABILITY_TRANSIENT_LOCAL == qos_policies->durability &&
+    RMW_RET_OK != (ret = create_retainer(info, pub->topic_name)))
+  {
+    hazcat_unregister_publisher(pub->data);
+    return NULL;
+  }
+
+  char type_name[GRAPH_NAME_LEN];
+  hazcat_graph_type_name(
+    info->members->message_namespace_, info->members->message_name_, type_name, GRAPH_NAME_LEN);
+  if (RMW_RET_OK != (ret = hazcat_graph_register_endpoint(
+      ((node_info_t *)node->data)->graph_id_, GRAPH_PUBLISHER, topic_name, type_name, &data->gid,
+      qos_policies, data->alloc->domain, hazcat_counts_references(data->alloc),
+      &info->graph_id)))
+  {
+    if (NULL != info->retainer) {
+      destroy_retainer(info);
+    }
+    if (NULL != info->best_effort) {
+      hazcat_be_detach(info->best_effort);
+      rmw_free(info->best_effort);
+    }
+    hazcat_unregister_publisher(pub->data);
+    return NULL;
+  }
+  info->topic = hazcat_graph_topic(info->graph_id);
+  if (NULL != info->retainer) {
+    hazcat_graph_set_cursor(info->graph_id, info->retainer->next_index);
+  }
+
+  // Last, so rmw_destroy_publisher can undo everything else if it fails
+  if (RMW_RET_OK != hazcat_advise_queue(info)) {
+    rmw_destroy_publisher(node, pub);
+    return NULL;
+  }
+  if (hazcat_mixes_domains(info)) {
+    rmw_destroy_publisher(node, pub);
+    RMW_SET_ERROR_MSG("Default allocators can't share a topic with other memory domains");
+    return NULL;
+  }
 
   return pub;
 }
@@ -177,13 +517,36 @@ rmw_destroy_publisher(rmw_node_t * node, rmw_publisher_t * publisher)
     return RMW_RET_INCORRECT_RMW_IMPLEMENTATION;
   }
 
+  // Let go of the history kept for late joiners while the topic is still ours to signal, then
+  // remove publisher from ros graph
+  pub_sub_info_t * info = (pub_sub_info_t *)publisher->data;
+  if (NULL != info->retainer) {
+    destroy_retainer(info);
+    hazcat_graph_topic_drained(info->topic);
+  }
+  rmw_ret_t ret = hazcat_graph_unregister_endpoint(info->graph_id);
+  if (RMW_RET_OK != ret) {
+    return ret;
+  }
+  if (NULL != info->best_effort) {
+    hazcat_be_detach(info->best_effort);
+    rmw_free(info->best_effort);
+  }
+
   // Remove publisher from it's message queue
-  rmw_ret_t ret = hazcat_unregister_publisher(publisher->data);
+  hazcat_unlock_queue(info);
+  ret = hazcat_unregister_publisher(publisher->data);
   if (RMW_RET_OK != ret) {
     return ret;
   }
 
   // Free all allocated memory associated with publisher
+  if (NULL == publisher->options.rmw_specific_publisher_payload) {
+    hazcat_release_default_allocator(
+      info->members, publisher->topic_name, info->data.alloc, info->data.msg_size,
+      info->data.depth);
+  }
+  hazcat_deadline_fini(&info->deadline);
   rmw_free(publisher->topic_name);
   rmw_free(publisher->data);
   rmw_publisher_free(publisher);
@@ -224,10 +587,38 @@ rmw_publisher_wait_for_all_acked(const rmw_publisher_t * publisher, rmw_time_t w
   if (publisher->implementation_identifier != rmw_get_implementation_identifier()) {
     return RMW_RET_INCORRECT_RMW_IMPLEMENTATION;
   }
-  (void)wait_timeout;
 
-  RMW_SET_ERROR_MSG("rmw_publisher_wait_for_all_acked hasn't been implemented yet");
-  return RMW_RET_UNSUPPORTED;
+  // Best effort messages are never acknowledged
+  pub_sub_info_t * info = (pub_sub_info_t *)publisher->data;
+  if (NULL != info->best_effort) {
+    return RMW_RET_OK;
+  }
+
+  // Zero means don't wait at all, anything too long to represent means wait forever
+  int64_t timeout = hazcat_qos_duration(wait_timeout);
+  if (0 == timeout && (0 != wait_timeout.sec || 0 != wait_timeout.nsec)) {
+    timeout = INT64_MAX;
+  }
+
+  // Subscriptions wake the topic's futex every time they take something
+  rcutils_time_point_value_t start, now;
+  rcutils_steady_time_now(&start);
+  now = start;
+  bool reclaimed = false;
+  while (true) {
+    uint32_t seen = hazcat_graph_topic_prepare_wait(info->topic);
+    if (all_acked(info)) {
+      hazcat_graph_topic_cancel_wait(info->topic);
+      return RMW_RET_OK;
+    }
+    if (RMW_RET_TIMEOUT == hazcat_graph_topic_wait(info->topic, seen, timeout - (now - start))) {
+      if (reclaimed || 0 == hazcat_graph_reclaim()) {
+        return RMW_RET_TIMEOUT;
+      }
+      reclaimed = true;
+    }
+    rcutils_steady_time_now(&now);
+  }
 }
 
 rmw_ret_t
@@ -239,14 +630,15 @@ rmw_publisher_get_actual_qos(const rmw_publisher_t * publisher, rmw_qos_profile_
     return RMW_RET_INCORRECT_RMW_IMPLEMENTATION;
   }
 
-  qos->history = RMW_QOS_POLICY_HISTORY_KEEP_LAST;
+  qos->history = ((pub_sub_info_t *)publisher->data)->qos.history;
   qos->depth = ((pub_sub_data_t *)publisher->data)->mq->elem->len;
-  qos->reliability = RMW_QOS_POLICY_RELIABILITY_RELIABLE;
-  qos->durability = RMW_QOS_POLICY_DURABILITY_VOLATILE;
-  qos->deadline.nsec = 0;
-  qos->deadline.sec = 0;
-  qos->lifespan.nsec = 0;
-  qos->lifespan.sec = 0;
+  qos->reliability = (NULL != ((pub_sub_info_t *)publisher->data)->best_effort) ?
+    RMW_QOS_POLICY_RELIABILITY_BEST_EFFORT : RMW_QOS_POLICY_RELIABILITY_RELIABLE;
+  qos->durability =
+    (NULL != ((pub_sub_info_t *)publisher->data)->retainer) ?
+    RMW_QOS_POLICY_DURABILITY_TRANSIENT_LOCAL : RMW_QOS_POLICY_DURABILITY_VOLATILE;
+  qos->deadline = ((pub_sub_info_t *)publisher->data)->qos.deadline;
+  qos->lifespan = ((pub_sub_info_t *)publisher->data)->qos.lifespan;
   qos->liveliness = RMW_QOS_POLICY_LIVELINESS_AUTOMATIC;
   qos->liveliness_lease_duration.nsec = 0;
   qos->liveliness_lease_duration.sec = 0;
@@ -268,19 +660,43 @@ rmw_publish(
   }
 
   // TODO(nightduck): Implement per-message size, in case messages are smaller than upper bound
-  size_t size = ((pub_sub_data_t *)publisher->data)->msg_size;
+  pub_sub_info_t * info = (pub_sub_info_t *)publisher->data;
+  size_t size = info->data.msg_size - sizeof(msg_header_t);
+  rmw_ret_t ret;
+  if (!info->fixed_size) {
+    // Only a copy goes into the ring, and its slots are too small for strings and sequences
+    if (NULL != info->best_effort) {
+      RMW_SET_ERROR_MSG("Best effort messages can't hold strings or sequences");
+      return RMW_RET_UNSUPPORTED;
+    }
+    if (RMW_RET_OK != (ret = hazcat_message_flattened_size(info->members, ros_message, &size))) {
+      return ret;
+    }
+  }
 
-  hma_allocator_t * alloc = ((pub_sub_data_t *)publisher->data)->alloc;
-  int offset = ALLOCATE(alloc, size);
-  if (offset < 0) {
-    RMW_SET_ERROR_MSG("unable to allocate memory for message.");
-    printf("Size requested: %d\n", size);
-    return RMW_RET_ERROR;
+  // Copied straight into the ring, no need for the allocator
+  if (NULL != info->best_effort) {
+    msg_header_t header;
+    return send_message(info, &header, ros_message, size);
   }
-  void * zc_msg = GET_PTR(alloc, offset, void);
-  memcpy(zc_msg, ros_message, size);
 
-  return hazcat_publish(publisher->data, zc_msg, size);
+  hma_allocator_t * alloc = info->data.alloc;
+  hazcat_offset_t offset;
+  if (RMW_RET_OK != (ret = reserve_message(info, sizeof(msg_header_t) + size, &offset))) {
+    return ret;
+  }
+  msg_header_t * header = GET_PTR(alloc, offset, msg_header_t);
+  if (info->fixed_size) {
+    memcpy(header + 1, ros_message, size);
+  } else if (RMW_RET_OK != (ret = hazcat_flatten(info->members, ros_message, header + 1, size))) {
+    hazcat_deallocate(alloc, offset);
+    return ret;
+  }
+
+  if (RMW_RET_OK != (ret = send_message(info, header, header + 1, size))) {
+    hazcat_deallocate(alloc, offset);
+  }
+  return ret;
 }
 
 rmw_ret_t
@@ -295,8 +711,33 @@ rmw_publish_serialized_message(
     return RMW_RET_INCORRECT_RMW_IMPLEMENTATION;
   }
 
-  RMW_SET_ERROR_MSG("rmw_publish_serialized_message hasn't been implemented yet");
-  return RMW_RET_UNSUPPORTED;
+  pub_sub_info_t * info = (pub_sub_info_t *)publisher->data;
+  // Only a copy goes into the ring, and its slots are too small for strings and sequences
+  if (NULL != info->best_effort && !info->fixed_size) {
+    RMW_SET_ERROR_MSG("Best effort serialized messages can't hold strings or sequences");
+    return RMW_RET_UNSUPPORTED;
+  }
+  size_t size;
+  rmw_ret_t ret = hazcat_flattened_size(info->members, serialized_message, &size);
+  if (RMW_RET_OK != ret) {
+    return ret;
+  }
+
+  // Deserialize straight into shared memory, rather than into the heap and copying it over after
+  hma_allocator_t * alloc = info->data.alloc;
+  hazcat_offset_t offset;
+  if (RMW_RET_OK != (ret = reserve_message(info, sizeof(msg_header_t) + size, &offset))) {
+    return ret;
+  }
+  msg_header_t * header = GET_PTR(alloc, offset, msg_header_t);
+  ret = hazcat_deserialize_flattened(info->members, serialized_message, header + 1, size);
+  if (RMW_RET_OK == ret) {
+    ret = send_message(info, header, header + 1, size);
+  }
+  if (RMW_RET_OK != ret || NULL != info->best_effort) {
+    hazcat_deallocate(alloc, offset);
+  }
+  return ret;
 }
 
 rmw_ret_t
@@ -315,6 +756,10 @@ rmw_borrow_loaned_message(
     RMW_SET_ERROR_MSG("Non-null message given to rmw_borrow_loaned_message");
     return RMW_RET_INVALID_ARGUMENT;
   }
+  if (!publisher->can_loan_messages) {
+    RMW_SET_ERROR_MSG("Messages with strings or sequences can't be loaned");
+    return RMW_RET_UNSUPPORTED;
+  }
 
   rmw_ret_t ret;
   size_t size;
@@ -325,12 +770,13 @@ rmw_borrow_loaned_message(
   }
 
   hma_allocator_t * alloc = ((pub_sub_data_t *)publisher->data)->alloc;
-  int offset = ALLOCATE(alloc, size);
-  if (offset < 0) {
-    RMW_SET_ERROR_MSG("unable to allocate memory for message");
-    return RMW_RET_ERROR;
+  hazcat_offset_t offset;
+  if (RMW_RET_OK !=
+    (ret = reserve_message(publisher->data, sizeof(msg_header_t) + size, &offset)))
+  {
+    return ret;
   }
-  *ros_message = GET_PTR(alloc, offset, void);
+  *ros_message = GET_PTR(alloc, offset, msg_header_t) + 1;
 
   return RMW_RET_OK;
 }
@@ -343,8 +789,7 @@ rmw_return_loaned_message_from_publisher(const rmw_publisher_t * publisher, void
 
   hma_allocator_t * alloc = ((pub_sub_data_t *)publisher->data)->alloc;
 
-  int offset = PTR_TO_OFFSET(alloc, loaned_message);
-  DEALLOCATE(alloc, offset);
+  hazcat_deallocate(alloc, hazcat_offset_of(alloc, (msg_header_t *)loaned_message - 1));
 
   return RMW_RET_OK;
 }
@@ -358,12 +803,27 @@ rmw_publish_loaned_message(
   RCUTILS_CHECK_ARGUMENT_FOR_NULL(publisher, RMW_RET_INVALID_ARGUMENT);
   RCUTILS_CHECK_ARGUMENT_FOR_NULL(ros_message, RMW_RET_INVALID_ARGUMENT);
 
-  hma_allocator_t * alloc = ((pub_sub_data_t *)publisher->data)->alloc;
+  pub_sub_info_t * info = (pub_sub_info_t *)publisher->data;
+  hma_allocator_t * alloc = info->data.alloc;
+  msg_header_t * header = (msg_header_t *)ros_message - 1;
 
   // TODO(nightduck): Implement per-message size, in case messages are smaller than upper bound
-  size_t size = ((pub_sub_data_t *)publisher->data)->msg_size;
+  size_t size = info->data.msg_size - sizeof(msg_header_t);
 
-  return hazcat_publish(publisher->data, ros_message, size);
+  // Best effort loans are only scratch space, the message is copied into the ring
+  if (NULL != info->best_effort) {
+    rmw_ret_t ret = send_message(info, header, ros_message, size);
+    hazcat_deallocate(alloc, hazcat_offset_of(alloc, header));
+    return ret;
+  }
+
+  // Memory was allocated when the message was borrowed, but the queue slot may still be in use
+  rmw_ret_t ret = reserve_message(info, 0, NULL);
+  if (RMW_RET_OK != ret) {
+    return ret;
+  }
+
+  return send_message(info, header, ros_message, size);
 }
 
 rmw_ret_t rmw_get_publishers_info_by_topic(
@@ -378,14 +838,14 @@ rmw_ret_t rmw_get_publishers_info_by_topic(
   if (node->implementation_identifier != rmw_get_implementation_identifier()) {
     return RMW_RET_INCORRECT_RMW_IMPLEMENTATION;
   }
-  int validation_result = RMW_NODE_NAME_VALID;
-  rmw_ret_t ret = rmw_validate_node_name(topic_name, &validation_result, NULL);
+  int validation_result = RMW_TOPIC_VALID;
+  rmw_ret_t ret = rmw_validate_full_topic_name(topic_name, &validation_result, NULL);
   if (RMW_RET_OK != ret) {
     return ret;
   }
-  if (RMW_NODE_NAME_VALID != validation_result) {
-    const char * reason = rmw_node_name_validation_result_string(validation_result);
-    RMW_SET_ERROR_MSG_WITH_FORMAT_STRING("node_name argument is invalid: %s", reason);
+  if (RMW_TOPIC_VALID != validation_result) {
+    const char * reason = rmw_full_topic_name_validation_result_string(validation_result);
+    RMW_SET_ERROR_MSG_WITH_FORMAT_STRING("topic_name argument is invalid: %s", reason);
     return RMW_RET_INVALID_ARGUMENT;
   }
   RCUTILS_CHECK_ALLOCATOR_WITH_MSG(
@@ -395,8 +855,7 @@ rmw_ret_t rmw_get_publishers_info_by_topic(
   }
   (void)no_mangle;
 
-  RMW_SET_ERROR_MSG("rmw_get_publishers_info_by_topic hasn't been implemented yet");
-  return RMW_RET_UNSUPPORTED;
+  return hazcat_graph_get_endpoints_info(GRAPH_PUBLISHER, topic_name, allocator, publishers_info);
 }
 
 rmw_publisher_options_t
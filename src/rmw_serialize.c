@@ -12,6 +12,7 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <stdint.h>
 #include <string.h>
 #include <stdio.h>
 
@@ -28,9 +29,7 @@
 #include "rosidl_typesupport_introspection_c/identifier.h"
 #include "rosidl_typesupport_introspection_c/message_introspection.h"
 
-const rosidl_message_type_support_t *
-get_type_support(
-  const rosidl_message_type_support_t * type_support);
+#include "rmw_hazcat/hazcat_serialize.h"
 
 rmw_ret_t
 serialize(
@@ -397,6 +396,577 @@ rmw_get_serialized_message_size(
 
   return RMW_RET_OK;
 }
+// Storage of flattened strings and sequences is padded so each one starts pointer aligned
+#define FLAT_ALIGN(x) (((x) + sizeof(void *) - 1) & ~(sizeof(void *) - 1))
+
+// Flattened strings and sequences hold the offset of their storage from the start of the block,
+// since the block is mapped at a different address in every process
+#define FLAT_OFFSET(base, ptr) ((void *)(uintptr_t)((const uint8_t *)(ptr) - (base)))
+#define FLAT_PTR(base, offset) ((base) + (uintptr_t)(offset))
+
+// Layout shared by rosidl_runtime_c strings and sequences of every element type
+typedef struct flat_sequence
+{
+  void * data;
+  size_t size;
+  size_t capacity;
+} flat_sequence_t;
+
+static bool
+is_sequence(const rosidl_typesupport_introspection_c__MessageMember * member)
+{
+  return member->is_array_ && (0 == member->array_size_ || member->is_upper_bound_);
+}
+
+// Size of one element of a primitive field, or 0 if the field isn't a primitive
+static size_t
+primitive_size(uint8_t type_id)
+{
+  switch (type_id) {
+    case rosidl_typesupport_introspection_c__ROS_TYPE_BOOL:
+      return sizeof(bool);
+    case rosidl_typesupport_introspection_c__ROS_TYPE_CHAR:
+      return sizeof(char);
+    case rosidl_typesupport_introspection_c__ROS_TYPE_BYTE:
+    case rosidl_typesupport_introspection_c__ROS_TYPE_UINT8:
+    case rosidl_typesupport_introspection_c__ROS_TYPE_INT8:
+      return sizeof(uint8_t);
+    case rosidl_typesupport_introspection_c__ROS_TYPE_INT16:
+    case rosidl_typesupport_introspection_c__ROS_TYPE_UINT16:
+      return sizeof(uint16_t);
+    case rosidl_typesupport_introspection_c__ROS_TYPE_FLOAT32:
+      return sizeof(float);
+    case rosidl_typesupport_introspection_c__ROS_TYPE_INT32:
+    case rosidl_typesupport_introspection_c__ROS_TYPE_UINT32:
+      return sizeof(uint32_t);
+    case rosidl_typesupport_introspection_c__ROS_TYPE_FLOAT64:
+      return sizeof(double);
+    case rosidl_typesupport_introspection_c__ROS_TYPE_INT64:
+    case rosidl_typesupport_introspection_c__ROS_TYPE_UINT64:
+      return sizeof(uint64_t);
+    default:
+      return 0;
+  }
+}
+
+static bool
+deserialize_primitives(ucdrBuffer * reader, uint8_t type_id, void * field, size_t count)
+{
+  switch (type_id) {
+    case rosidl_typesupport_introspection_c__ROS_TYPE_BOOL:
+      return ucdr_deserialize_array_bool(reader, (bool *)field, count);
+    case rosidl_typesupport_introspection_c__ROS_TYPE_CHAR:
+      return ucdr_deserialize_array_char(reader, (char *)field, count);
+    case rosidl_typesupport_introspection_c__ROS_TYPE_BYTE:
+    case rosidl_typesupport_introspection_c__ROS_TYPE_UINT8:
+      return ucdr_deserialize_array_uint8_t(reader, (uint8_t *)field, count);
+    case rosidl_typesupport_introspection_c__ROS_TYPE_INT8:
+      return ucdr_deserialize_array_int8_t(reader, (int8_t *)field, count);
+    case rosidl_typesupport_introspection_c__ROS_TYPE_FLOAT32:
+      return ucdr_deserialize_array_float(reader, (float *)field, count);
+    case rosidl_typesupport_introspection_c__ROS_TYPE_FLOAT64:
+      return ucdr_deserialize_array_double(reader, (double *)field, count);
+    case rosidl_typesupport_introspection_c__ROS_TYPE_INT16:
+      return ucdr_deserialize_array_int16_t(reader, (int16_t *)field, count);
+    case rosidl_typesupport_introspection_c__ROS_TYPE_UINT16:
+      return ucdr_deserialize_array_uint16_t(reader, (uint16_t *)field, count);
+    case rosidl_typesupport_introspection_c__ROS_TYPE_INT32:
+      return ucdr_deserialize_array_int32_t(reader, (int32_t *)field, count);
+    case rosidl_typesupport_introspection_c__ROS_TYPE_UINT32:
+      return ucdr_deserialize_array_uint32_t(reader, (uint32_t *)field, count);
+    case rosidl_typesupport_introspection_c__ROS_TYPE_INT64:
+      return ucdr_deserialize_array_int64_t(reader, (int64_t *)field, count);
+    case rosidl_typesupport_introspection_c__ROS_TYPE_UINT64:
+      return ucdr_deserialize_array_uint64_t(reader, (uint64_t *)field, count);
+    default:
+      return false;
+  }
+}
+
+// Walks a CDR buffer without writing anything, summing the tail storage strings and sequences need
+static rmw_ret_t
+flattened_tail_size(
+  const rosidl_typesupport_introspection_c__MessageMembers * members,
+  ucdrBuffer * reader,
+  size_t * tail)
+{
+  for (uint32_t i = 0; i < members->member_count_; i++) {
+    const rosidl_typesupport_introspection_c__MessageMember * member = members->members_ + i;
+    const rosidl_typesupport_introspection_c__MessageMembers * sub_members;
+
+    size_t count = 1;
+    if (is_sequence(member)) {
+      uint32_t len;
+      if (!ucdr_deserialize_uint32_t(reader, &len)) {
+        RMW_SET_ERROR_MSG("Serialized message is truncated");
+        return RMW_RET_ERROR;
+      }
+      count = len;
+    } else if (member->is_array_) {
+      count = member->array_size_;
+    }
+
+    rmw_ret_t ret;
+    size_t elem_size;
+    switch (member->type_id_) {
+      case rosidl_typesupport_introspection_c__ROS_TYPE_MESSAGE:
+        sub_members =
+          (const rosidl_typesupport_introspection_c__MessageMembers *)member->members_->data;
+        if (is_sequence(member)) {
+          *tail += FLAT_ALIGN(count * sub_members->size_of_);
+        }
+        for (size_t j = 0; j < count; j++) {
+          if (RMW_RET_OK != (ret = flattened_tail_size(sub_members, reader, tail))) {
+            return ret;
+          }
+        }
+        break;
+      case rosidl_typesupport_introspection_c__ROS_TYPE_STRING:
+        if (is_sequence(member)) {
+          *tail += FLAT_ALIGN(count * sizeof(flat_sequence_t));
+        }
+        for (size_t j = 0; j < count; j++) {
+          uint32_t len;
+          if (!ucdr_deserialize_uint32_t(reader, &len) || ucdr_buffer_remaining(reader) < len) {
+            RMW_SET_ERROR_MSG("Serialized message is truncated");
+            return RMW_RET_ERROR;
+          }
+          ucdr_advance_buffer(reader, len);
+          *tail += FLAT_ALIGN(len);
+        }
+        break;
+      default:
+        if (0 == (elem_size = primitive_size(member->type_id_))) {
+          RMW_SET_ERROR_MSG("Deserializing unknown type");
+          return RMW_RET_INVALID_ARGUMENT;
+        }
+        ucdr_align_to(reader, elem_size);
+        if (ucdr_buffer_remaining(reader) < count * elem_size) {
+          RMW_SET_ERROR_MSG("Serialized message is truncated");
+          return RMW_RET_ERROR;
+        }
+        ucdr_advance_buffer(reader, count * elem_size);
+        if (is_sequence(member)) {
+          *tail += FLAT_ALIGN(count * elem_size);
+        }
+        break;
+    }
+  }
+
+  return RMW_RET_OK;
+}
+
+// Same as deserialize(), except strings and sequences are carved out of [*tail, end) instead of
+// being allocated individually, and refer to their storage by its offset from base
+static rmw_ret_t
+deserialize_flattened(
+  void * ros_message,
+  const rosidl_typesupport_introspection_c__MessageMembers * members,
+  ucdrBuffer * reader,
+  const uint8_t * base,
+  uint8_t ** tail,
+  const uint8_t * end)
+{
+  for (uint32_t i = 0; i < members->member_count_; i++) {
+    const rosidl_typesupport_introspection_c__MessageMember * member = members->members_ + i;
+    const rosidl_typesupport_introspection_c__MessageMembers * sub_members = NULL;
+    char * field = (char *)(ros_message) + member->offset_;
+
+    size_t elem_size;
+    switch (member->type_id_) {
+      case rosidl_typesupport_introspection_c__ROS_TYPE_MESSAGE:
+        sub_members =
+          (const rosidl_typesupport_introspection_c__MessageMembers *)member->members_->data;
+        elem_size = sub_members->size_of_;
+        break;
+      case rosidl_typesupport_introspection_c__ROS_TYPE_STRING:
+        elem_size = sizeof(flat_sequence_t);
+        break;
+      default:
+        if (0 == (elem_size = primitive_size(member->type_id_))) {
+          RMW_SET_ERROR_MSG("Deserializing unknown type");
+          return RMW_RET_INVALID_ARGUMENT;
+        }
+        break;
+    }
+
+    // Elements of a sequence live in the tail, everything else lives in the message itself
+    size_t count = 1;
+    if (is_sequence(member)) {
+      uint32_t len;
+      if (!ucdr_deserialize_uint32_t(reader, &len) || *tail + len * elem_size > end) {
+        RMW_SET_ERROR_MSG("Serialized message doesn't fit in flattened block");
+        return RMW_RET_ERROR;
+      }
+      flat_sequence_t * seq = (flat_sequence_t *)field;
+      seq->data = FLAT_OFFSET(base, *tail);
+      seq->size = len;
+      seq->capacity = len;
+      field = (char *)*tail;
+      *tail += FLAT_ALIGN(len * elem_size);
+      count = len;
+    } else if (member->is_array_) {
+      count = member->array_size_;
+    }
+
+    rmw_ret_t ret;
+    switch (member->type_id_) {
+      case rosidl_typesupport_introspection_c__ROS_TYPE_MESSAGE:
+        for (size_t j = 0; j < count; j++) {
+          ret = deserialize_flattened(
+            field + j * elem_size, sub_members, reader, base, tail, end);
+          if (RMW_RET_OK != ret) {
+            return ret;
+          }
+        }
+        break;
+      case rosidl_typesupport_introspection_c__ROS_TYPE_STRING:
+        for (size_t j = 0; j < count; j++) {
+          flat_sequence_t * str = (flat_sequence_t *)field + j;
+          uint32_t len;
+          if (!ucdr_deserialize_uint32_t(reader, &len) || *tail + len > end ||
+            !ucdr_deserialize_array_char(reader, (char *)*tail, len))
+          {
+            RMW_SET_ERROR_MSG("Serialized message doesn't fit in flattened block");
+            return RMW_RET_ERROR;
+          }
+          str->data = FLAT_OFFSET(base, *tail);
+          str->size = (len > 0) ? len - 1 : 0;    // CDR lengths count the null terminator
+          str->capacity = len;
+          *tail += FLAT_ALIGN(len);
+        }
+        break;
+      default:
+        if (!deserialize_primitives(reader, member->type_id_, field, count)) {
+          RMW_SET_ERROR_MSG("Serialized message is truncated");
+          return RMW_RET_ERROR;
+        }
+        break;
+    }
+  }
+
+  return RMW_RET_OK;
+}
+
+// Size of one element of a member, or 0 if it's of a type that can't be flattened
+static size_t
+element_size(const rosidl_typesupport_introspection_c__MessageMember * member)
+{
+  switch (member->type_id_) {
+    case rosidl_typesupport_introspection_c__ROS_TYPE_MESSAGE:
+      return ((const rosidl_typesupport_introspection_c__MessageMembers *)
+             member->members_->data)->size_of_;
+    case rosidl_typesupport_introspection_c__ROS_TYPE_STRING:
+      return sizeof(flat_sequence_t);
+    default:
+      return primitive_size(member->type_id_);
+  }
+}
+
+// Sums the tail storage the strings and sequences of a message need once flattened
+static rmw_ret_t
+message_tail_size(
+  const rosidl_typesupport_introspection_c__MessageMembers * members,
+  const void * ros_message,
+  size_t * tail)
+{
+  for (uint32_t i = 0; i < members->member_count_; i++) {
+    const rosidl_typesupport_introspection_c__MessageMember * member = members->members_ + i;
+    const char * field = (const char *)ros_message + member->offset_;
+    size_t elem_size = element_size(member);
+    if (0 == elem_size) {
+      RMW_SET_ERROR_MSG("Flattening unknown type");
+      return RMW_RET_INVALID_ARGUMENT;
+    }
+
+    size_t count = 1;
+    if (is_sequence(member)) {
+      const flat_sequence_t * seq = (const flat_sequence_t *)field;
+      count = seq->size;
+      field = seq->data;
+      *tail += FLAT_ALIGN(count * elem_size);
+    } else if (member->is_array_) {
+      count = member->array_size_;
+    }
+
+    rmw_ret_t ret;
+    switch (member->type_id_) {
+      case rosidl_typesupport_introspection_c__ROS_TYPE_MESSAGE:
+        for (size_t j = 0; j < count; j++) {
+          ret = message_tail_size(
+            (const rosidl_typesupport_introspection_c__MessageMembers *)member->members_->data,
+            field + j * elem_size, tail);
+          if (RMW_RET_OK != ret) {
+            return ret;
+          }
+        }
+        break;
+      case rosidl_typesupport_introspection_c__ROS_TYPE_STRING:
+        for (size_t j = 0; j < count; j++) {
+          *tail += FLAT_ALIGN(((const flat_sequence_t *)field)[j].size + 1);
+        }
+        break;
+      default:
+        break;
+    }
+  }
+
+  return RMW_RET_OK;
+}
+
+// Copies a message into dst, carving its strings and sequences out of the tail as
+// deserialize_flattened() does. The tail was sized by message_tail_size()
+static void
+flatten_message(
+  const rosidl_typesupport_introspection_c__MessageMembers * members,
+  const void * ros_message,
+  void * dst,
+  const uint8_t * base,
+  uint8_t ** tail)
+{
+  for (uint32_t i = 0; i < members->member_count_; i++) {
+    const rosidl_typesupport_introspection_c__MessageMember * member = members->members_ + i;
+    const char * src_field = (const char *)ros_message + member->offset_;
+    char * dst_field = (char *)dst + member->offset_;
+    size_t elem_size = element_size(member);
+
+    size_t count = 1;
+    if (is_sequence(member)) {
+      const flat_sequence_t * src_seq = (const flat_sequence_t *)src_field;
+      flat_sequence_t * dst_seq = (flat_sequence_t *)dst_field;
+      count = src_seq->size;
+      dst_seq->data = FLAT_OFFSET(base, *tail);
+      dst_seq->size = count;
+      dst_seq->capacity = count;
+      src_field = src_seq->data;
+      dst_field = (char *)*tail;
+      *tail += FLAT_ALIGN(count * elem_size);
+    } else if (member->is_array_) {
+      count = member->array_size_;
+    }
+
+    switch (member->type_id_) {
+      case rosidl_typesupport_introspection_c__ROS_TYPE_MESSAGE:
+        for (size_t j = 0; j < count; j++) {
+          flatten_message(
+            (const rosidl_typesupport_introspection_c__MessageMembers *)member->members_->data,
+            src_field + j * elem_size, dst_field + j * elem_size, base, tail);
+        }
+        break;
+      case rosidl_typesupport_introspection_c__ROS_TYPE_STRING:
+        for (size_t j = 0; j < count; j++) {
+          const flat_sequence_t * src_str = (const flat_sequence_t *)src_field + j;
+          flat_sequence_t * dst_str = (flat_sequence_t *)dst_field + j;
+          if (src_str->size > 0) {
+            memcpy(*tail, src_str->data, src_str->size);
+          }
+          (*tail)[src_str->size] = '\0';
+          dst_str->data = FLAT_OFFSET(base, *tail);
+          dst_str->size = src_str->size;
+          dst_str->capacity = src_str->size + 1;
+          *tail += FLAT_ALIGN(src_str->size + 1);
+        }
+        break;
+      default:
+        if (count > 0) {
+          memcpy(dst_field, src_field, count * elem_size);
+        }
+        break;
+    }
+  }
+}
+
+// Copies a flattened message out into an initialized message, rebuilding its strings and
+// sequences in storage of its own
+static rmw_ret_t
+unflatten_message(
+  const rosidl_typesupport_introspection_c__MessageMembers * members,
+  const void * src,
+  void * ros_message,
+  const uint8_t * base)
+{
+  for (uint32_t i = 0; i < members->member_count_; i++) {
+    const rosidl_typesupport_introspection_c__MessageMember * member = members->members_ + i;
+    const char * src_field = (const char *)src + member->offset_;
+    char * dst_field = (char *)ros_message + member->offset_;
+    size_t elem_size = element_size(member);
+    if (0 == elem_size) {
+      RMW_SET_ERROR_MSG("Unflattening unknown type");
+      return RMW_RET_INVALID_ARGUMENT;
+    }
+
+    size_t count = 1;
+    if (is_sequence(member)) {
+      const flat_sequence_t * src_seq = (const flat_sequence_t *)src_field;
+      count = src_seq->size;
+      if (NULL == member->resize_function || !member->resize_function(dst_field, count)) {
+        RMW_SET_ERROR_MSG("Unable to resize sequence of taken message");
+        return RMW_RET_BAD_ALLOC;
+      }
+      src_field = (const char *)FLAT_PTR(base, src_seq->data);
+      dst_field = ((flat_sequence_t *)dst_field)->data;
+    } else if (member->is_array_) {
+      count = member->array_size_;
+    }
+
+    rmw_ret_t ret;
+    switch (member->type_id_) {
+      case rosidl_typesupport_introspection_c__ROS_TYPE_MESSAGE:
+        for (size_t j = 0; j < count; j++) {
+          ret = unflatten_message(
+            (const rosidl_typesupport_introspection_c__MessageMembers *)member->members_->data,
+            src_field + j * elem_size, dst_field + j * elem_size, base);
+          if (RMW_RET_OK != ret) {
+            return ret;
+          }
+        }
+        break;
+      case rosidl_typesupport_introspection_c__ROS_TYPE_STRING:
+        for (size_t j = 0; j < count; j++) {
+          const flat_sequence_t * src_str = (const flat_sequence_t *)src_field + j;
+          if (!rosidl_runtime_c__String__assignn(
+              (rosidl_runtime_c__String *)dst_field + j,
+              (const char *)FLAT_PTR(base, src_str->data), src_str->size))
+          {
+            RMW_SET_ERROR_MSG("Unable to copy string of taken message");
+            return RMW_RET_BAD_ALLOC;
+          }
+        }
+        break;
+      default:
+        if (count > 0) {
+          memcpy(dst_field, src_field, count * elem_size);
+        }
+        break;
+    }
+  }
+
+  return RMW_RET_OK;
+}
+
+bool
+hazcat_fixed_size(const rosidl_typesupport_introspection_c__MessageMembers * members)
+{
+  for (uint32_t i = 0; i < members->member_count_; i++) {
+    const rosidl_typesupport_introspection_c__MessageMember * member = members->members_ + i;
+    if (is_sequence(member) ||
+      rosidl_typesupport_introspection_c__ROS_TYPE_STRING == member->type_id_ ||
+      rosidl_typesupport_introspection_c__ROS_TYPE_WSTRING == member->type_id_)
+    {
+      return false;
+    }
+    if (rosidl_typesupport_introspection_c__ROS_TYPE_MESSAGE == member->type_id_ &&
+      !hazcat_fixed_size(
+        (const rosidl_typesupport_introspection_c__MessageMembers *)member->members_->data))
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+rmw_ret_t
+hazcat_flattened_size(
+  const rosidl_typesupport_introspection_c__MessageMembers * members,
+  const rmw_serialized_message_t * serialized_message,
+  size_t * size)
+{
+  RCUTILS_CHECK_ARGUMENT_FOR_NULL(members, RMW_RET_INVALID_ARGUMENT);
+  RCUTILS_CHECK_ARGUMENT_FOR_NULL(serialized_message, RMW_RET_INVALID_ARGUMENT);
+  RCUTILS_CHECK_ARGUMENT_FOR_NULL(size, RMW_RET_INVALID_ARGUMENT);
+
+  ucdrBuffer reader;
+  ucdr_init_buffer(&reader, serialized_message->buffer, serialized_message->buffer_length);
+
+  size_t tail = 0;
+  rmw_ret_t ret = flattened_tail_size(members, &reader, &tail);
+  if (RMW_RET_OK != ret) {
+    return ret;
+  }
+  *size = FLAT_ALIGN(members->size_of_) + tail;
+
+  return RMW_RET_OK;
+}
+
+rmw_ret_t
+hazcat_deserialize_flattened(
+  const rosidl_typesupport_introspection_c__MessageMembers * members,
+  const rmw_serialized_message_t * serialized_message,
+  void * block,
+  size_t size)
+{
+  RCUTILS_CHECK_ARGUMENT_FOR_NULL(members, RMW_RET_INVALID_ARGUMENT);
+  RCUTILS_CHECK_ARGUMENT_FOR_NULL(serialized_message, RMW_RET_INVALID_ARGUMENT);
+  RCUTILS_CHECK_ARGUMENT_FOR_NULL(block, RMW_RET_INVALID_ARGUMENT);
+  if (size < FLAT_ALIGN(members->size_of_)) {
+    RMW_SET_ERROR_MSG("Block is smaller than the message type");
+    return RMW_RET_INVALID_ARGUMENT;
+  }
+
+  ucdrBuffer reader;
+  ucdr_init_buffer(&reader, serialized_message->buffer, serialized_message->buffer_length);
+
+  uint8_t * tail = (uint8_t *)block + FLAT_ALIGN(members->size_of_);
+  return deserialize_flattened(block, members, &reader, block, &tail, (uint8_t *)block + size);
+}
+
+rmw_ret_t
+hazcat_message_flattened_size(
+  const rosidl_typesupport_introspection_c__MessageMembers * members,
+  const void * ros_message,
+  size_t * size)
+{
+  RCUTILS_CHECK_ARGUMENT_FOR_NULL(members, RMW_RET_INVALID_ARGUMENT);
+  RCUTILS_CHECK_ARGUMENT_FOR_NULL(ros_message, RMW_RET_INVALID_ARGUMENT);
+  RCUTILS_CHECK_ARGUMENT_FOR_NULL(size, RMW_RET_INVALID_ARGUMENT);
+
+  size_t tail = 0;
+  rmw_ret_t ret = message_tail_size(members, ros_message, &tail);
+  if (RMW_RET_OK != ret) {
+    return ret;
+  }
+  *size = FLAT_ALIGN(members->size_of_) + tail;
+
+  return RMW_RET_OK;
+}
+
+rmw_ret_t
+hazcat_flatten(
+  const rosidl_typesupport_introspection_c__MessageMembers * members,
+  const void * ros_message,
+  void * block,
+  size_t size)
+{
+  RCUTILS_CHECK_ARGUMENT_FOR_NULL(members, RMW_RET_INVALID_ARGUMENT);
+  RCUTILS_CHECK_ARGUMENT_FOR_NULL(ros_message, RMW_RET_INVALID_ARGUMENT);
+  RCUTILS_CHECK_ARGUMENT_FOR_NULL(block, RMW_RET_INVALID_ARGUMENT);
+  size_t needed;
+  rmw_ret_t ret = hazcat_message_flattened_size(members, ros_message, &needed);
+  if (RMW_RET_OK != ret) {
+    return ret;
+  }
+  if (size < needed) {
+    RMW_SET_ERROR_MSG("Block is smaller than the flattened message");
+    return RMW_RET_INVALID_ARGUMENT;
+  }
+
+  uint8_t * tail = (uint8_t *)block + FLAT_ALIGN(members->size_of_);
+  flatten_message(members, ros_message, block, block, &tail);
+  return RMW_RET_OK;
+}
+
+rmw_ret_t
+hazcat_unflatten(
+  const rosidl_typesupport_introspection_c__MessageMembers * members,
+  const void * block,
+  void * ros_message)
+{
+  RCUTILS_CHECK_ARGUMENT_FOR_NULL(members, RMW_RET_INVALID_ARGUMENT);
+  RCUTILS_CHECK_ARGUMENT_FOR_NULL(block, RMW_RET_INVALID_ARGUMENT);
+  RCUTILS_CHECK_ARGUMENT_FOR_NULL(ros_message, RMW_RET_INVALID_ARGUMENT);
+
+  return unflatten_message(members, block, ros_message, block);
+}
 #ifdef __cplusplus
 }
 #endif
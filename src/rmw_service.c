@@ -12,6 +12,8 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <string.h>
+
 #include "rmw/error_handling.h"
 #include "rmw/rmw.h"
 #include "rmw/get_node_info_and_types.h"
@@ -21,10 +23,109 @@
 
 #include "hazcat/hazcat_message_queue.h"
 
+#include "rmw_hazcat/hazcat_node.h"
+#include "rmw_hazcat/hazcat_ros_graph.h"
+#include "rmw_hazcat/hazcat_service_loans.h"
+#include "rmw_hazcat/hazcat_srv_clt.h"
+#include "rmw_hazcat/hazcat_typesupport.h"
+
 #ifdef __cplusplus
 extern "C"
 {
 #endif
+static void
+destroy_route(response_route_t * route)
+{
+  hazcat_unregister_publisher(&route->pub);
+  hazcat_srv_clt_fini_queue(&route->pub);
+  rmw_free(route);
+}
+
+// Publisher to the response queue of the client that sent request_id, created on first use
+static response_route_t *
+get_route(
+  const rmw_service_t * service, const rmw_request_id_t * request_id,
+  response_route_t *** link)
+{
+  srv_clt_info_t * info = (srv_clt_info_t *)service->data;
+  response_route_t ** it = &info->routes;
+  while (NULL != *it && 0 != memcmp(
+      (*it)->client.writer_guid, request_id->writer_guid, sizeof(request_id->writer_guid)))
+  {
+    it = &(*it)->next;
+  }
+  *link = it;
+  if (NULL != *it) {
+    return *it;
+  }
+
+  response_route_t * route = rmw_allocate(sizeof(response_route_t));
+  if (NULL == route) {
+    RMW_SET_ERROR_MSG("Unable to allocate memory for response route");
+    return NULL;
+  }
+  route->client = *request_id;
+  route->loans = 0;
+  if (RMW_RET_OK != hazcat_srv_clt_init_queue(
+      &route->pub, info->queue.context, info->members->response_members_->size_of_,
+      info->queue.depth))
+  {
+    rmw_free(route);
+    return NULL;
+  }
+  char topic[SRV_CLT_TOPIC_LEN];
+  hazcat_response_topic(service->service_name, request_id, topic, SRV_CLT_TOPIC_LEN);
+  if (RMW_RET_OK != hazcat_register_publisher(&route->pub, topic)) {
+    hazcat_srv_clt_fini_queue(&route->pub);
+    rmw_free(route);
+    return NULL;
+  }
+
+  route->next = NULL;
+  *it = route;
+  return route;
+}
+
+// Sends a response to the client that made the request, either copied from ros_response or, if
+// set, the borrowed message loan
+static rmw_ret_t
+respond(
+  const rmw_service_t * service, const rmw_request_id_t * request_header,
+  const void * ros_response, void * loan)
+{
+  srv_clt_info_t * info = (srv_clt_info_t *)service->data;
+  pthread_mutex_lock(&info->routes_lock);
+  response_route_t ** link;
+  response_route_t * route = get_route(service, request_header, &link);
+  if (NULL == route) {
+    pthread_mutex_unlock(&info->routes_lock);
+    return RMW_RET_ERROR;
+  }
+
+  rmw_ret_t ret = RMW_RET_OK;
+  if (NULL != loan) {
+    route->loans--;
+  }
+  if (0 < __atomic_load_n(&route->pub.mq->elem->sub_count, __ATOMIC_RELAXED)) {
+    ret = (NULL == loan) ?
+      hazcat_srv_clt_send(&route->pub, request_header, ros_response) :
+      hazcat_srv_clt_send_loaned(&route->pub, request_header, loan);
+  } else {
+    // Nobody subscribes to the response queue once the client is destroyed, so drop the
+    // response, and the route along with it when no other responses are on loan from it
+    if (NULL != loan) {
+      hazcat_srv_clt_return_borrowed(&route->pub, loan);
+    }
+    if (0 == route->loans) {
+      *link = route->next;
+      destroy_route(route);
+    }
+  }
+  pthread_mutex_unlock(&info->routes_lock);
+
+  return ret;
+}
+
 rmw_service_t *
 rmw_create_service(
   const rmw_node_t * node,
@@ -55,6 +156,11 @@ rmw_create_service(
     RMW_SET_ERROR_MSG("Invalid QoS policy");
     return NULL;
   }
+  const rosidl_service_type_support_t * ts = get_service_type_support(type_support);
+  if (NULL == ts) {
+    RMW_SET_ERROR_MSG("Unsupported typesupport");
+    return NULL;
+  }
 
   // rmw_ret_t ret;
   // size_t msg_size;
@@ -72,16 +178,58 @@ rmw_create_service(
 
   size_t len = strlen(service_name);
   srv->implementation_identifier = rmw_get_implementation_identifier();
-  srv->data = rmw_allocate(sizeof(srv_clt_data_t));
+  srv->service_name = NULL;
+  srv_clt_info_t * info = rmw_allocate(sizeof(srv_clt_info_t));
+  srv->data = info;
+  if (NULL == info) {
+    RMW_SET_ERROR_MSG("Unable to allocate memory for service info");
+    goto fail;
+  }
+  info->members = (const rosidl_typesupport_introspection_c__ServiceMembers *)ts->data;
+  info->routes = NULL;
+  pthread_mutex_init(&info->routes_lock, NULL);
   srv->service_name = rmw_allocate(strlen(service_name) + 1);
 
   if (NULL == srv->service_name) {
     RMW_SET_ERROR_MSG("Unable to allocate string for subscription's topic name");
-    return NULL;
+    goto fail_lock;
   }
   snprintf(srv->service_name, strlen(service_name) + 1, service_name);
 
+  char topic[SRV_CLT_TOPIC_LEN];
+  hazcat_request_topic(service_name, topic, SRV_CLT_TOPIC_LEN);
+  if (RMW_RET_OK != hazcat_srv_clt_init_queue(
+      &info->queue, node->context, info->members->request_members_->size_of_,
+      qos_policies->depth))
+  {
+    goto fail_lock;
+  }
+  if (RMW_RET_OK != hazcat_register_subscription(&info->queue, topic)) {
+    goto fail_queue;
+  }
+
+  char type_name[GRAPH_NAME_LEN];
+  hazcat_graph_type_name(
+    info->members->service_namespace_, info->members->service_name_, type_name, GRAPH_NAME_LEN);
+  if (RMW_RET_OK != hazcat_graph_register_endpoint(
+      ((node_info_t *)node->data)->graph_id_, GRAPH_SERVICE, service_name, type_name,
+      &info->queue.gid, qos_policies, info->queue.alloc->domain, false, &info->graph_id))
+  {
+    hazcat_unregister_subscription(&info->queue);
+    goto fail_queue;
+  }
+
   return srv;
+
+fail_queue:
+  hazcat_srv_clt_fini_queue(&info->queue);
+fail_lock:
+  pthread_mutex_destroy(&info->routes_lock);
+fail:
+  rmw_free(srv->service_name);
+  rmw_free(srv->data);
+  rmw_service_free(srv);
+  return NULL;
 }
 
 rmw_ret_t
@@ -96,6 +244,24 @@ rmw_destroy_service(rmw_node_t * node, rmw_service_t * service)
     return RMW_RET_INCORRECT_RMW_IMPLEMENTATION;
   }
 
+  srv_clt_info_t * info = (srv_clt_info_t *)service->data;
+  rmw_ret_t ret = hazcat_graph_unregister_endpoint(info->graph_id);
+  if (RMW_RET_OK != ret) {
+    return ret;
+  }
+
+  ret = hazcat_unregister_subscription(&info->queue);
+  if (RMW_RET_OK != ret) {
+    return ret;
+  }
+  hazcat_srv_clt_fini_queue(&info->queue);
+  while (NULL != info->routes) {
+    response_route_t * next = info->routes->next;
+    destroy_route(info->routes);
+    info->routes = next;
+  }
+  pthread_mutex_destroy(&info->routes_lock);
+
   rmw_free(service->data);
   rmw_free(service->service_name);
   rmw_service_free(service);
@@ -114,9 +280,12 @@ rmw_take_request(
   RCUTILS_CHECK_ARGUMENT_FOR_NULL(request_header, RMW_RET_INVALID_ARGUMENT);
   RCUTILS_CHECK_ARGUMENT_FOR_NULL(ros_request, RMW_RET_INVALID_ARGUMENT);
   RCUTILS_CHECK_ARGUMENT_FOR_NULL(taken, RMW_RET_INVALID_ARGUMENT);
+  if (service->implementation_identifier != rmw_get_implementation_identifier()) {
+    return RMW_RET_INCORRECT_RMW_IMPLEMENTATION;
+  }
 
-  RMW_SET_ERROR_MSG("rmw_take_request hasn't been implemented yet");
-  return RMW_RET_UNSUPPORTED;
+  return hazcat_srv_clt_take(
+    &((srv_clt_info_t *)service->data)->queue, request_header, ros_request, taken);
 }
 
 rmw_ret_t
@@ -128,9 +297,11 @@ rmw_send_response(
   RCUTILS_CHECK_ARGUMENT_FOR_NULL(service, RMW_RET_INVALID_ARGUMENT);
   RCUTILS_CHECK_ARGUMENT_FOR_NULL(request_header, RMW_RET_INVALID_ARGUMENT);
   RCUTILS_CHECK_ARGUMENT_FOR_NULL(ros_response, RMW_RET_INVALID_ARGUMENT);
+  if (service->implementation_identifier != rmw_get_implementation_identifier()) {
+    return RMW_RET_INCORRECT_RMW_IMPLEMENTATION;
+  }
 
-  RMW_SET_ERROR_MSG("rmw_send_response hasn't been implemented yet");
-  return RMW_RET_UNSUPPORTED;
+  return respond(service, request_header, ros_response, NULL);
 }
 
 rmw_ret_t
@@ -142,9 +313,118 @@ rmw_service_server_is_available(
   RCUTILS_CHECK_ARGUMENT_FOR_NULL(node, RMW_RET_INVALID_ARGUMENT);
   RCUTILS_CHECK_ARGUMENT_FOR_NULL(client, RMW_RET_INVALID_ARGUMENT);
   RCUTILS_CHECK_ARGUMENT_FOR_NULL(is_available, RMW_RET_INVALID_ARGUMENT);
+  if (client->implementation_identifier != rmw_get_implementation_identifier()) {
+    return RMW_RET_INCORRECT_RMW_IMPLEMENTATION;
+  }
+
+  // A service is exactly a subscription to the request queue the client publishes to
+  message_queue_t * mq = ((srv_clt_info_t *)client->data)->requests.mq->elem;
+  *is_available = 0 < __atomic_load_n(&mq->sub_count, __ATOMIC_RELAXED);
+
+  return RMW_RET_OK;
+}
+
+rmw_ret_t
+rmw_hazcat_take_loaned_request(
+  const rmw_service_t * service,
+  rmw_service_info_t * request_header,
+  void ** ros_request,
+  bool * taken)
+{
+  RCUTILS_CHECK_ARGUMENT_FOR_NULL(service, RMW_RET_INVALID_ARGUMENT);
+  RCUTILS_CHECK_ARGUMENT_FOR_NULL(request_header, RMW_RET_INVALID_ARGUMENT);
+  RCUTILS_CHECK_ARGUMENT_FOR_NULL(ros_request, RMW_RET_INVALID_ARGUMENT);
+  RCUTILS_CHECK_ARGUMENT_FOR_NULL(taken, RMW_RET_INVALID_ARGUMENT);
+  if (service->implementation_identifier != rmw_get_implementation_identifier()) {
+    return RMW_RET_INCORRECT_RMW_IMPLEMENTATION;
+  }
+
+  return hazcat_srv_clt_take_loaned(
+    &((srv_clt_info_t *)service->data)->queue, request_header, ros_request, taken);
+}
+
+rmw_ret_t
+rmw_hazcat_return_loaned_request_from_service(const rmw_service_t * service, void * ros_request)
+{
+  RCUTILS_CHECK_ARGUMENT_FOR_NULL(service, RMW_RET_INVALID_ARGUMENT);
+  RCUTILS_CHECK_ARGUMENT_FOR_NULL(ros_request, RMW_RET_INVALID_ARGUMENT);
+  if (service->implementation_identifier != rmw_get_implementation_identifier()) {
+    return RMW_RET_INCORRECT_RMW_IMPLEMENTATION;
+  }
+
+  return hazcat_srv_clt_return_taken(&((srv_clt_info_t *)service->data)->queue, ros_request);
+}
+
+rmw_ret_t
+rmw_hazcat_borrow_loaned_response(
+  const rmw_service_t * service,
+  const rmw_request_id_t * request_header,
+  void ** ros_response)
+{
+  RCUTILS_CHECK_ARGUMENT_FOR_NULL(service, RMW_RET_INVALID_ARGUMENT);
+  RCUTILS_CHECK_ARGUMENT_FOR_NULL(request_header, RMW_RET_INVALID_ARGUMENT);
+  RCUTILS_CHECK_ARGUMENT_FOR_NULL(ros_response, RMW_RET_INVALID_ARGUMENT);
+  if (service->implementation_identifier != rmw_get_implementation_identifier()) {
+    return RMW_RET_INCORRECT_RMW_IMPLEMENTATION;
+  }
+  if (NULL != *ros_response) {
+    RMW_SET_ERROR_MSG("Non-null message given to rmw_hazcat_borrow_loaned_response");
+    return RMW_RET_INVALID_ARGUMENT;
+  }
+
+  srv_clt_info_t * info = (srv_clt_info_t *)service->data;
+  pthread_mutex_lock(&info->routes_lock);
+  response_route_t ** link;
+  response_route_t * route = get_route(service, request_header, &link);
+  rmw_ret_t ret = RMW_RET_ERROR;
+  if (NULL != route && RMW_RET_OK == (ret = hazcat_srv_clt_borrow(&route->pub, ros_response))) {
+    route->loans++;
+  }
+  pthread_mutex_unlock(&info->routes_lock);
+
+  return ret;
+}
+
+rmw_ret_t
+rmw_hazcat_return_loaned_response_from_service(
+  const rmw_service_t * service,
+  const rmw_request_id_t * request_header,
+  void * ros_response)
+{
+  RCUTILS_CHECK_ARGUMENT_FOR_NULL(service, RMW_RET_INVALID_ARGUMENT);
+  RCUTILS_CHECK_ARGUMENT_FOR_NULL(request_header, RMW_RET_INVALID_ARGUMENT);
+  RCUTILS_CHECK_ARGUMENT_FOR_NULL(ros_response, RMW_RET_INVALID_ARGUMENT);
+  if (service->implementation_identifier != rmw_get_implementation_identifier()) {
+    return RMW_RET_INCORRECT_RMW_IMPLEMENTATION;
+  }
+
+  srv_clt_info_t * info = (srv_clt_info_t *)service->data;
+  pthread_mutex_lock(&info->routes_lock);
+  response_route_t ** link;
+  response_route_t * route = get_route(service, request_header, &link);
+  if (NULL != route) {
+    hazcat_srv_clt_return_borrowed(&route->pub, ros_response);
+    route->loans--;
+  }
+  pthread_mutex_unlock(&info->routes_lock);
+
+  return (NULL == route) ? RMW_RET_ERROR : RMW_RET_OK;
+}
+
+rmw_ret_t
+rmw_hazcat_send_loaned_response(
+  const rmw_service_t * service,
+  const rmw_request_id_t * request_header,
+  void * ros_response)
+{
+  RCUTILS_CHECK_ARGUMENT_FOR_NULL(service, RMW_RET_INVALID_ARGUMENT);
+  RCUTILS_CHECK_ARGUMENT_FOR_NULL(request_header, RMW_RET_INVALID_ARGUMENT);
+  RCUTILS_CHECK_ARGUMENT_FOR_NULL(ros_response, RMW_RET_INVALID_ARGUMENT);
+  if (service->implementation_identifier != rmw_get_implementation_identifier()) {
+    return RMW_RET_INCORRECT_RMW_IMPLEMENTATION;
+  }
 
-  RMW_SET_ERROR_MSG("rmw_service_server_is_available hasn't been implemented yet");
-  return RMW_RET_UNSUPPORTED;
+  return respond(service, request_header, NULL, ros_response);
 }
 #ifdef __cplusplus
 }
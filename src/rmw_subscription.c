@@ -24,13 +24,237 @@
 #include "rmw/validate_namespace.h"
 #include "rmw/validate_node_name.h"
 
-#include "hazcat_allocators/cpu_ringbuf_allocator.h"
 #include "hazcat/hazcat_message_queue.h"
 
+#include "rmw_hazcat/hazcat_alloc.h"
+#include "rmw_hazcat/hazcat_mq.h"
+#include "rmw_hazcat/hazcat_node.h"
+#include "rmw_hazcat/hazcat_pub_sub.h"
+#include "rmw_hazcat/hazcat_ros_graph.h"
+#include "rmw_hazcat/hazcat_serialize.h"
+
 #ifdef __cplusplus
 extern "C"
 {
 #endif
+// Frees a taken message, and lets KEEP_ALL publishers waiting on this subscription carry on. The
+// topic is null if the subscription couldn't be placed in the ros graph
+static void
+release_message(pub_sub_info_t * info, hma_allocator_t * alloc, void * msg)
+{
+  hazcat_deallocate(alloc, hazcat_offset_of(alloc, msg));
+  hazcat_graph_topic_drained(info->topic);
+}
+
+// Whether a message has outlived its publisher's lifespan. The time is only looked up once it's
+// needed, then reused for later messages
+static bool
+expired(const msg_header_t * header, rcutils_time_point_value_t * now)
+{
+  if (0 == header->expiry) {
+    return false;
+  }
+  if (0 == *now) {
+    rcutils_system_time_now(now);
+  }
+  return *now > header->expiry;
+}
+
+// Counts messages that never made it to the subscription, going by gaps in the sequence numbers of
+// the message's publisher. The count only goes up, so should threads sharing a publisher queue its
+// messages out of order, one skipped over is still counted lost when it turns up
+static void
+count_lost(pub_sub_info_t * info, const msg_header_t * header)
+{
+  publisher_seq_t * pubs = info->publishers;
+  int i = 0;
+  while (i < TRACKED_PUBLISHERS - 1 && 0 != pubs[i].sequence_number &&
+    0 != memcmp(pubs[i].gid, header->publisher_gid, RMW_GID_STORAGE_SIZE))
+  {
+    i++;
+  }
+  publisher_seq_t seq = pubs[i];
+  if (0 == seq.sequence_number ||
+    0 != memcmp(seq.gid, header->publisher_gid, RMW_GID_STORAGE_SIZE))
+  {
+    // First heard from, or forgotten, nothing to measure a gap from
+    memcpy(seq.gid, header->publisher_gid, RMW_GID_STORAGE_SIZE);
+    seq.sequence_number = header->sequence_number;
+  } else if (header->sequence_number > seq.sequence_number) {
+    if (header->sequence_number > seq.sequence_number + 1) {
+      hazcat_graph_add_lost(info->graph_id, header->sequence_number - seq.sequence_number - 1);
+    }
+    seq.sequence_number = header->sequence_number;
+  }
+  memmove(&pubs[1], &pubs[0], i * sizeof(publisher_seq_t));
+  pubs[0] = seq;
+}
+
+// With pending_lock held, whether a message passes the subscription's content filter, if it has one
+static bool
+accepted(const pub_sub_info_t * info, const void * msg)
+{
+  return NULL == info->filter || hazcat_filter_matches(info->filter, msg);
+}
+
+// With pending_lock held, makes the next message that hasn't expired and passes the content filter
+// pending, releasing any that don't. Also records how far the subscription has read in the ros
+// graph, so its remaining interest can be released should this process die
+static msg_ref_t
+next_message(pub_sub_info_t * info)
+{
+  rcutils_time_point_value_t now = 0;
+  while (NULL == info->pending.msg) {
+    msg_ref_t msg_ref = hazcat_take(&info->data);
+    hazcat_graph_set_cursor(info->graph_id, info->data.next_index);
+    if (NULL == msg_ref.msg) {
+      break;
+    }
+    count_lost(info, msg_ref.msg);
+    msg_header_t * header = msg_ref.msg;
+    if (expired(header, &now) || !accepted(info, header + 1)) {
+      release_message(info, msg_ref.alloc, msg_ref.msg);
+    } else {
+      info->pending = msg_ref;
+    }
+  }
+  return info->pending;
+}
+
+// Takes the next message that hasn't expired and passes the content filter, the message pointer is
+// to its header
+static msg_ref_t
+take_message(pub_sub_info_t * info)
+{
+  pthread_mutex_lock(&info->pending_lock);
+  msg_ref_t msg_ref = next_message(info);
+  info->pending.msg = NULL;
+  pthread_mutex_unlock(&info->pending_lock);
+
+  if (NULL != msg_ref.msg) {
+    hazcat_deadline_message(&info->deadline, ((msg_header_t *)msg_ref.msg)->source_timestamp);
+  }
+  return msg_ref;
+}
+
+// Copies the next best effort message that hasn't expired and passes the content filter out of the
+// ring. The filter is evaluated on the copy, which is overwritten by the next message if rejected
+static bool
+take_best_effort(pub_sub_info_t * info, msg_header_t * header, void * ros_message, size_t size)
+{
+  rcutils_time_point_value_t now = 0;
+  while (hazcat_be_take(info->best_effort, header, sizeof(msg_header_t), ros_message, size)) {
+    if (expired(header, &now)) {
+      continue;
+    }
+    pthread_mutex_lock(&info->pending_lock);
+    bool match = accepted(info, ros_message);
+    pthread_mutex_unlock(&info->pending_lock);
+    if (match) {
+      hazcat_deadline_message(&info->deadline, header->source_timestamp);
+      return true;
+    }
+  }
+  return false;
+}
+
+static void
+fill_message_info(const msg_header_t * header, rmw_message_info_t * message_info)
+{
+  message_info->source_timestamp = header->source_timestamp;
+  rcutils_system_time_now(&message_info->received_timestamp);
+  message_info->publication_sequence_number = header->sequence_number;
+  message_info->reception_sequence_number = RMW_MESSAGE_INFO_SEQUENCE_NUMBER_UNSUPPORTED;
+  message_info->publisher_gid.implementation_identifier = rmw_get_implementation_identifier();
+  memcpy(message_info->publisher_gid.data, header->publisher_gid, RMW_GID_STORAGE_SIZE);
+  message_info->from_intra_process = false;
+}
+
+bool
+hazcat_subscription_ready(pub_sub_info_t * info)
+{
+  if (NULL != info->best_effort && hazcat_be_ready(info->best_effort)) {
+    return true;
+  }
+  pthread_mutex_lock(&info->pending_lock);
+  bool ready = NULL != info->pending.msg ||
+    (info->data.next_index != info->data.mq->elem->index && NULL != next_message(info).msg);
+  pthread_mutex_unlock(&info->pending_lock);
+  return ready;
+}
+
+// Positions a TRANSIENT_LOCAL subscription to read the last depth messages still retained by
+// TRANSIENT_LOCAL publishers, by taking an interest in them, and a reference to them, as if it had
+// been registered when they were published. Nothing is copied, each late joiner reads the same
+// retained messages
+static void
+replay_retained(pub_sub_info_t * info)
+{
+  message_queue_t * mq = info->data.mq->elem;
+  int domain = hazcat_mq_domain_index(mq, info->data.alloc->domain);
+  uint32_t len = mq->len;
+  uint32_t index = __atomic_load_n(&mq->index, __ATOMIC_ACQUIRE) % len;
+  uint32_t first = index;
+  for (uint32_t k = 1; k <= len && k <= info->data.depth; k++) {
+    int i = (index + len - k) % len;
+    ref_bits_t * bits = hazcat_mq_ref_bits(mq, i);
+    hazcat_mq_slot_lock(bits);
+    bool retained = 0 != bits->availability && 0 < bits->interest_count;
+    if (retained) {
+      bits->interest_count++;
+      if (-1 != domain && (bits->availability & (1 << domain))) {
+        hazcat_share_entry(hazcat_mq_entry(mq, domain, i), NULL, 1);
+      }
+    }
+    hazcat_mq_slot_unlock(bits);
+    if (!retained) {
+      break;
+    }
+    first = i;
+  }
+  info->data.next_index = first;
+}
+
+static void
+free_filter(hazcat_filter_t * filter)
+{
+  if (NULL != filter) {
+    hazcat_filter_fini(filter);
+    rmw_free(filter);
+  }
+}
+
+// Compiles and installs a content filter, an empty expression removes it. Any message already
+// pending is checked against the new filter, so it only ever applies to whole messages
+static rmw_ret_t
+set_filter(pub_sub_info_t * info, const rmw_subscription_content_filter_options_t * options)
+{
+  hazcat_filter_t * filter = NULL;
+  if (NULL != options->filter_expression && '\0' != options->filter_expression[0]) {
+    filter = rmw_allocate(sizeof(hazcat_filter_t));
+    if (NULL == filter) {
+      RMW_SET_ERROR_MSG("Unable to allocate memory for content filter");
+      return RMW_RET_BAD_ALLOC;
+    }
+    rmw_ret_t ret = hazcat_filter_init(filter, info->members, options);
+    if (RMW_RET_OK != ret) {
+      rmw_free(filter);
+      return ret;
+    }
+  }
+
+  pthread_mutex_lock(&info->pending_lock);
+  hazcat_filter_t * old = info->filter;
+  info->filter = filter;
+  if (NULL != info->pending.msg && !accepted(info, (msg_header_t *)info->pending.msg + 1)) {
+    release_message(info, info->pending.alloc, info->pending.msg);
+    info->pending.msg = NULL;
+  }
+  pthread_mutex_unlock(&info->pending_lock);
+  free_filter(old);
+  return RMW_RET_OK;
+}
+
 rmw_ret_t
 rmw_init_subscription_allocation(
   const rosidl_message_type_support_t * type_supports,
@@ -86,6 +310,18 @@ rmw_create_subscription(
     RMW_SET_ERROR_MSG("Invalid QoS policy");
     return NULL;
   }
+  const rosidl_message_type_support_t * ts = get_type_support(type_supports);
+  if (NULL == ts) {
+    RMW_SET_ERROR_MSG("Unsupported typesupport");
+    return NULL;
+  }
+  // Strings and sequences are flattened into shared memory, which relies on C's layout of them
+  if (!hazcat_c_type_support(ts) &&
+    !hazcat_fixed_size((const rosidl_typesupport_introspection_c__MessageMembers *)ts->data))
+  {
+    RMW_SET_ERROR_MSG("Messages with strings or sequences need the C introspection typesupport");
+    return NULL;
+  }
 
   rmw_ret_t ret;
   size_t msg_size;
@@ -100,32 +336,59 @@ rmw_create_subscription(
     RMW_SET_ERROR_MSG("Unable to allocate memory for subscription");
     return NULL;
   }
-  pub_sub_data_t * data = rmw_allocate(sizeof(pub_sub_data_t));
-  if (NULL == data) {
+  pub_sub_info_t * info = rmw_allocate(sizeof(pub_sub_info_t));
+  if (NULL == info) {
     RMW_SET_ERROR_MSG("Unable to allocate memory for subscription info");
     return NULL;
   }
+  pub_sub_data_t * data = &info->data;
 
   // Populate data->alloc with allocator specified and data->history with qos setting
+  data->depth = hazcat_qos_depth(qos_policies);
+  info->members = (const rosidl_typesupport_introspection_c__MessageMembers *)ts->data;
+  info->fixed_size = hazcat_fixed_size(info->members);
   data->alloc = (hma_allocator_t *)subscription_options->rmw_specific_subscription_payload;
   if (NULL == data->alloc) {
-    // TODO(nightduck): Remove when TLSF allocator is done
-    data->alloc = create_cpu_ringbuf_allocator(msg_size, qos_policies->depth);
+    data->alloc = hazcat_default_allocator(
+      info->members, NULL, sizeof(msg_header_t) + msg_size, data->depth);
     if (NULL == data->alloc) {
       RMW_SET_ERROR_MSG("Unable to create allocator for subscription");
       return NULL;
     }
   }
-  data->depth = qos_policies->depth;
-  data->msg_size = msg_size;
+  data->msg_size = sizeof(msg_header_t) + msg_size;
+  data->gid = generate_gid();
   data->context = node->context;
   sem_init(&data->lock, 0, 1);
+  info->qos = *qos_policies;
+  info->qos.depth = data->depth;
+  info->best_effort = NULL;
+  info->topic = NULL;
+  info->pending.msg = NULL;
+  pthread_mutex_init(&info->pending_lock, NULL);
+  memset(info->publishers, 0, sizeof(info->publishers));
+  info->lost_reported = 0;
+  info->incompatible_reported = 0;
+  info->filter = NULL;
+  if (NULL != subscription_options->content_filter_options &&
+    RMW_RET_OK != set_filter(info, subscription_options->content_filter_options))
+  {
+    return NULL;
+  }
+  if (RMW_RET_OK != hazcat_deadline_init(&info->deadline, qos_policies->deadline)) {
+    return NULL;
+  }
 
   sub->implementation_identifier = rmw_get_implementation_identifier();
-  sub->data = data;
+  sub->data = info;
   sub->topic_name = rmw_allocate(strlen(topic_name) + 1);
   sub->options = *subscription_options;
-  sub->can_loan_messages = true;
+  sub->options.content_filter_options = NULL;
+  sub->is_cft_enabled = NULL != info->filter;
+  // Best effort messages are copied out of their ring, so there's nothing to loan. Flattened ones
+  // have to be copied out to be read at all
+  sub->can_loan_messages =
+    RMW_QOS_POLICY_RELIABILITY_BEST_EFFORT != qos_policies->reliability && info->fixed_size;
 
   if (NULL == sub->topic_name) {
     RMW_SET_ERROR_MSG("Unable to allocate string for subscription's topic name");
@@ -136,6 +399,50 @@ rmw_create_subscription(
   if (RMW_RET_OK != (ret = hazcat_register_subscription(sub->data, topic_name))) {
     return NULL;
   }
+  if (RMW_QOS_POLICY_RELIABILITY_BEST_EFFORT == qos_policies->reliability) {
+    info->best_effort = rmw_allocate(sizeof(be_endpoint_t));
+    if (NULL == info->best_effort || RMW_RET_OK != (ret = hazcat_be_attach(
+        info->best_effort, topic_name, data->msg_size, data->depth, true)))
+    {
+      rmw_free(info->best_effort);
+      hazcat_unregister_subscription(sub->data);
+      return NULL;
+    }
+  }
+
+  char type_name[GRAPH_NAME_LEN];
+  hazcat_graph_type_name(
+    info->members->message_namespace_, info->members->message_name_, type_name, GRAPH_NAME_LEN);
+  if (RMW_RET_OK != (ret = hazcat_graph_register_endpoint(
+      ((node_info_t *)node->data)->graph_id_, GRAPH_SUBSCRIPTION, topic_name, type_name,
+      &data->gid, qos_policies, data->alloc->domain, hazcat_counts_references(data->alloc),
+      &info->graph_id)))
+  {
+    if (NULL != info->best_effort) {
+      hazcat_be_detach(info->best_effort);
+      rmw_free(info->best_effort);
+    }
+    hazcat_unregister_subscription(sub->data);
+    return NULL;
+  }
+  info->topic = hazcat_graph_topic(info->graph_id);
+  if (RMW_QOS_POLICY_DURABILITY_TRANSIENT_LOCAL == qos_policies->durability &&
+    NULL != info->topic && 0 < __atomic_load_n(&info->topic->retainers, __ATOMIC_RELAXED))
+  {
+    replay_retained(info);
+  }
+  hazcat_graph_set_cursor(info->graph_id, data->next_index);
+
+  // Last, so rmw_destroy_subscription can undo everything else if it fails
+  if (RMW_RET_OK != hazcat_advise_queue(info)) {
+    rmw_destroy_subscription(node, sub);
+    return NULL;
+  }
+  if (hazcat_mixes_domains(info)) {
+    rmw_destroy_subscription(node, sub);
+    RMW_SET_ERROR_MSG("Default allocators can't share a topic with other memory domains");
+    return NULL;
+  }
 
   return sub;
 }
@@ -154,13 +461,40 @@ rmw_destroy_subscription(
     return RMW_RET_INCORRECT_RMW_IMPLEMENTATION;
   }
 
-  // Remove publisher from it's message queue
-  rmw_ret_t ret = hazcat_unregister_subscription(subscription->data);
+  // Release the message taken early, and tell publishers this subscription is leaving the queue,
+  // while the topic is still ours to signal
+  pub_sub_info_t * info = (pub_sub_info_t *)subscription->data;
+  if (NULL != info->pending.msg) {
+    release_message(info, info->pending.alloc, info->pending.msg);
+    info->pending.msg = NULL;
+  }
+  hazcat_graph_topic_depart(info->topic);
+
+  // Remove subscription from ros graph
+  rmw_ret_t ret = hazcat_graph_unregister_endpoint(info->graph_id);
+  if (RMW_RET_OK != ret) {
+    return ret;
+  }
+
+  // Remove subscription from it's message queue, and best effort ring
+  pthread_mutex_destroy(&info->pending_lock);
+  hazcat_unlock_queue(info);
+  ret = hazcat_unregister_subscription(subscription->data);
   if (RMW_RET_OK != ret) {
     return ret;
   }
+  if (NULL != info->best_effort) {
+    hazcat_be_detach(info->best_effort);
+    rmw_free(info->best_effort);
+  }
 
   // Free all allocated memory associated with publisher
+  if (NULL == subscription->options.rmw_specific_subscription_payload) {
+    hazcat_release_default_allocator(
+      info->members, NULL, info->data.alloc, info->data.msg_size, info->data.depth);
+  }
+  free_filter(info->filter);
+  hazcat_deadline_fini(&info->deadline);
   rmw_free(subscription->topic_name);
   rmw_free(subscription->data);
   rmw_publisher_free(subscription);
@@ -179,14 +513,16 @@ rmw_subscription_get_actual_qos(
     return RMW_RET_INCORRECT_RMW_IMPLEMENTATION;
   }
 
-  qos->history = RMW_QOS_POLICY_HISTORY_KEEP_LAST;
-  qos->depth = ((pub_sub_data_t *)subscription->data)->depth;
-  qos->reliability = RMW_QOS_POLICY_RELIABILITY_RELIABLE;
-  qos->durability = RMW_QOS_POLICY_DURABILITY_VOLATILE;
-  qos->deadline.nsec = 0;
-  qos->deadline.sec = 0;
-  qos->lifespan.nsec = 0;
-  qos->lifespan.sec = 0;
+  pub_sub_info_t * info = (pub_sub_info_t *)subscription->data;
+  qos->history = info->qos.history;
+  qos->depth = info->data.depth;
+  qos->reliability = (NULL != info->best_effort) ?
+    RMW_QOS_POLICY_RELIABILITY_BEST_EFFORT : RMW_QOS_POLICY_RELIABILITY_RELIABLE;
+  qos->durability =
+    (RMW_QOS_POLICY_DURABILITY_TRANSIENT_LOCAL == info->qos.durability) ?
+    RMW_QOS_POLICY_DURABILITY_TRANSIENT_LOCAL : RMW_QOS_POLICY_DURABILITY_VOLATILE;
+  qos->deadline = info->qos.deadline;
+  qos->lifespan = info->qos.lifespan;
   qos->liveliness = RMW_QOS_POLICY_LIVELINESS_AUTOMATIC;
   qos->liveliness_lease_duration.nsec = 0;
   qos->liveliness_lease_duration.sec = 0;
@@ -196,36 +532,102 @@ rmw_subscription_get_actual_qos(
 }
 
 rmw_ret_t
-rmw_take(
+rmw_subscription_set_content_filter(
+  rmw_subscription_t * subscription,
+  const rmw_subscription_content_filter_options_t * options)
+{
+  RCUTILS_CHECK_ARGUMENT_FOR_NULL(subscription, RMW_RET_INVALID_ARGUMENT);
+  RCUTILS_CHECK_ARGUMENT_FOR_NULL(options, RMW_RET_INVALID_ARGUMENT);
+  if (subscription->implementation_identifier != rmw_get_implementation_identifier()) {
+    return RMW_RET_INCORRECT_RMW_IMPLEMENTATION;
+  }
+
+  pub_sub_info_t * info = (pub_sub_info_t *)subscription->data;
+  rmw_ret_t ret = set_filter(info, options);
+  if (RMW_RET_OK == ret) {
+    subscription->is_cft_enabled = NULL != info->filter;
+  }
+  return ret;
+}
+
+rmw_ret_t
+rmw_subscription_get_content_filter(
   const rmw_subscription_t * subscription,
-  void * ros_message,
-  bool * taken,
-  rmw_subscription_allocation_t * allocation)
+  rcutils_allocator_t * allocator,
+  rmw_subscription_content_filter_options_t * options)
 {
   RCUTILS_CHECK_ARGUMENT_FOR_NULL(subscription, RMW_RET_INVALID_ARGUMENT);
-  RCUTILS_CHECK_ARGUMENT_FOR_NULL(ros_message, RMW_RET_INVALID_ARGUMENT);
-  RCUTILS_CHECK_ARGUMENT_FOR_NULL(taken, RMW_RET_INVALID_ARGUMENT);
+  RCUTILS_CHECK_ARGUMENT_FOR_NULL(allocator, RMW_RET_INVALID_ARGUMENT);
+  RCUTILS_CHECK_ARGUMENT_FOR_NULL(options, RMW_RET_INVALID_ARGUMENT);
   if (subscription->implementation_identifier != rmw_get_implementation_identifier()) {
     return RMW_RET_INCORRECT_RMW_IMPLEMENTATION;
   }
 
+  pub_sub_info_t * info = (pub_sub_info_t *)subscription->data;
+  rmw_ret_t ret;
+  pthread_mutex_lock(&info->pending_lock);
+  if (NULL == info->filter) {
+    RMW_SET_ERROR_MSG("Subscription doesn't have a content filter");
+    ret = RMW_RET_ERROR;
+  } else {
+    ret = rmw_subscription_content_filter_options_copy(&info->filter->options, allocator, options);
+  }
+  pthread_mutex_unlock(&info->pending_lock);
+  return ret;
+}
+
+// Copies the next message out, whether it came through the best effort ring or hazcat. Flattened
+// messages are rebuilt in the message's own storage, as their block is released right after
+static rmw_ret_t
+copy_message(
+  pub_sub_info_t * info, void * ros_message, rmw_message_info_t * message_info, bool * taken)
+{
   // TODO(nightduck): Implement per-message size, in case messages are smaller than upper bound
-  size_t size = ((pub_sub_data_t *)subscription->data)->msg_size;
+  size_t size = info->data.msg_size - sizeof(msg_header_t);
+
+  msg_header_t header;
+  *taken = false;
+  if (NULL != info->best_effort && take_best_effort(info, &header, ros_message, size)) {
+    if (NULL != message_info) {
+      fill_message_info(&header, message_info);
+    }
+    *taken = true;
+    return RMW_RET_OK;
+  }
 
-  msg_ref_t msg_ref = hazcat_take(subscription->data);
+  msg_ref_t msg_ref = take_message(info);
   if (NULL == msg_ref.msg) {
-    *taken = false;
     return RMW_RET_OK;
+  }
+  rmw_ret_t ret = RMW_RET_OK;
+  if (info->fixed_size) {
+    memcpy(ros_message, (msg_header_t *)msg_ref.msg + 1, size);
   } else {
-    *taken = true;
+    ret = hazcat_unflatten(info->members, (msg_header_t *)msg_ref.msg + 1, ros_message);
   }
+  if (NULL != message_info) {
+    fill_message_info(msg_ref.msg, message_info);
+  }
+  release_message(info, msg_ref.alloc, msg_ref.msg);
+  *taken = RMW_RET_OK == ret;
+  return ret;
+}
 
-  memcpy(ros_message, msg_ref.msg, size);
-
-  int offset = PTR_TO_OFFSET(msg_ref.alloc, msg_ref.msg);
-  DEALLOCATE(msg_ref.alloc, offset);
+rmw_ret_t
+rmw_take(
+  const rmw_subscription_t * subscription,
+  void * ros_message,
+  bool * taken,
+  rmw_subscription_allocation_t * allocation)
+{
+  RCUTILS_CHECK_ARGUMENT_FOR_NULL(subscription, RMW_RET_INVALID_ARGUMENT);
+  RCUTILS_CHECK_ARGUMENT_FOR_NULL(ros_message, RMW_RET_INVALID_ARGUMENT);
+  RCUTILS_CHECK_ARGUMENT_FOR_NULL(taken, RMW_RET_INVALID_ARGUMENT);
+  if (subscription->implementation_identifier != rmw_get_implementation_identifier()) {
+    return RMW_RET_INCORRECT_RMW_IMPLEMENTATION;
+  }
 
-  return RMW_RET_OK;
+  return copy_message((pub_sub_info_t *)subscription->data, ros_message, NULL, taken);
 }
 
 rmw_ret_t
@@ -244,26 +646,7 @@ rmw_take_with_info(
     return RMW_RET_INCORRECT_RMW_IMPLEMENTATION;
   }
 
-  // TODO(nightduck): Populate message_info
-  (void *)message_info;
-
-  // TODO(nightduck): Implement per-message size, in case messages are smaller than upper bound
-  size_t size = ((pub_sub_data_t *)subscription->data)->msg_size;
-
-  msg_ref_t msg_ref = hazcat_take(subscription->data);
-  if (NULL == msg_ref.msg) {
-    *taken = false;
-    return RMW_RET_OK;
-  } else {
-    *taken = true;
-  }
-
-  memcpy(ros_message, msg_ref.msg, size);
-
-  int offset = PTR_TO_OFFSET(msg_ref.alloc, msg_ref.msg);
-  DEALLOCATE(msg_ref.alloc, offset);
-
-  return RMW_RET_OK;
+  return copy_message((pub_sub_info_t *)subscription->data, ros_message, message_info, taken);
 }
 
 rmw_ret_t
@@ -304,6 +687,23 @@ rmw_take_serialized_message_with_info(
   return RMW_RET_UNSUPPORTED;
 }
 
+// Takes the next message without copying, handing out the message after its header
+static void *
+loan_message(pub_sub_info_t * info, rmw_message_info_t * message_info)
+{
+  msg_ref_t msg_ref = take_message(info);
+  if (NULL == msg_ref.msg) {
+    // TODO(nightduck): Check for errors in hazcat_take
+    return NULL;
+  }
+  if (NULL != message_info) {
+    fill_message_info(msg_ref.msg, message_info);
+  }
+  // The queue slot is free now, the memory only once the loan is returned
+  hazcat_graph_topic_drained(info->topic);
+  return (msg_header_t *)msg_ref.msg + 1;
+}
+
 rmw_ret_t
 rmw_take_loaned_message(
   const rmw_subscription_t * subscription,
@@ -318,15 +718,13 @@ rmw_take_loaned_message(
     return RMW_RET_INCORRECT_RMW_IMPLEMENTATION;
   }
 
-  msg_ref_t msg_ref = hazcat_take(subscription->data);
-  *loaned_message = msg_ref.msg;
-  if (NULL == *loaned_message) {
-    *taken = false;
-  } else {
-    *taken = true;
+  if (!subscription->can_loan_messages) {
+    RMW_SET_ERROR_MSG("Subscription can't loan messages");
+    return RMW_RET_UNSUPPORTED;
   }
 
-  // TODO(nightduck): Check for errors in hazcat_take
+  *loaned_message = loan_message((pub_sub_info_t *)subscription->data, NULL);
+  *taken = NULL != *loaned_message;
 
   return RMW_RET_OK;
 }
@@ -347,18 +745,13 @@ rmw_take_loaned_message_with_info(
     return RMW_RET_INCORRECT_RMW_IMPLEMENTATION;
   }
 
-  // TODO(nightduck): Populate message_info
-  (void *)message_info;
-
-  msg_ref_t msg_ref = hazcat_take(subscription->data);
-  *loaned_message = msg_ref.msg;
-  if (NULL == *loaned_message) {
-    *taken = false;
-  } else {
-    *taken = true;
+  if (!subscription->can_loan_messages) {
+    RMW_SET_ERROR_MSG("Subscription can't loan messages");
+    return RMW_RET_UNSUPPORTED;
   }
 
-  // TODO(nightduck): Check for errors in hazcat_take
+  *loaned_message = loan_message((pub_sub_info_t *)subscription->data, message_info);
+  *taken = NULL != *loaned_message;
 
   return RMW_RET_OK;
 }
@@ -374,29 +767,18 @@ rmw_return_loaned_message_from_subscription(
   }
 
   // This is a work-around since this rmw discards the allocator reference after hazcat_take
-  hma_allocator_t * alloc = get_matching_alloc(subscription, loaned_message);
+  msg_header_t * header = (msg_header_t *)loaned_message - 1;
+  hma_allocator_t * alloc = get_matching_alloc(subscription, header);
   if (NULL == alloc) {
     RMW_SET_ERROR_MSG("Returning message that wasn't loaned");
     return RMW_RET_ERROR;
   }
 
-  int offset = PTR_TO_OFFSET(alloc, loaned_message);
-  DEALLOCATE(alloc, offset);
+  release_message((pub_sub_info_t *)subscription->data, alloc, header);
 
   return RMW_RET_OK;
 }
 
-rmw_ret_t
-rmw_take_event(const rmw_event_t * event_handle, void * event_info, bool * taken)
-{
-  RCUTILS_CHECK_ARGUMENT_FOR_NULL(event_handle, RMW_RET_INVALID_ARGUMENT);
-  RCUTILS_CHECK_ARGUMENT_FOR_NULL(event_info, RMW_RET_INVALID_ARGUMENT);
-  RCUTILS_CHECK_ARGUMENT_FOR_NULL(taken, RMW_RET_INVALID_ARGUMENT);
-
-  RMW_SET_ERROR_MSG("rmw_take_event hasn't been implemented yet");
-  return RMW_RET_UNSUPPORTED;
-}
-
 rmw_ret_t
 rmw_take_sequence(
   const rmw_subscription_t * subscription,
@@ -462,14 +844,14 @@ rmw_get_subscriptions_info_by_topic(
   if (node->implementation_identifier != rmw_get_implementation_identifier()) {
     return RMW_RET_INCORRECT_RMW_IMPLEMENTATION;
   }
-  int validation_result = RMW_NODE_NAME_VALID;
-  rmw_ret_t ret = rmw_validate_node_name(topic_name, &validation_result, NULL);
+  int validation_result = RMW_TOPIC_VALID;
+  rmw_ret_t ret = rmw_validate_full_topic_name(topic_name, &validation_result, NULL);
   if (RMW_RET_OK != ret) {
     return ret;
   }
-  if (RMW_NODE_NAME_VALID != validation_result) {
-    const char * reason = rmw_node_name_validation_result_string(validation_result);
-    RMW_SET_ERROR_MSG_WITH_FORMAT_STRING("node_name argument is invalid: %s", reason);
+  if (RMW_TOPIC_VALID != validation_result) {
+    const char * reason = rmw_full_topic_name_validation_result_string(validation_result);
+    RMW_SET_ERROR_MSG_WITH_FORMAT_STRING("topic_name argument is invalid: %s", reason);
     return RMW_RET_INVALID_ARGUMENT;
   }
   RCUTILS_CHECK_ALLOCATOR_WITH_MSG(
@@ -479,8 +861,8 @@ rmw_get_subscriptions_info_by_topic(
   }
   (void)no_mangle;
 
-  RMW_SET_ERROR_MSG("rmw_get_subscriptions_info_by_topic hasn't been implemented yet");
-  return RMW_RET_UNSUPPORTED;
+  return hazcat_graph_get_endpoints_info(
+    GRAPH_SUBSCRIPTION, topic_name, allocator, subscriptions_info);
 }
 #ifdef __cplusplus
 }
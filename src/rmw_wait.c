@@ -23,6 +23,10 @@
 
 #include "hazcat/types.h"
 
+#include "rmw_hazcat/hazcat_pub_sub.h"
+#include "rmw_hazcat/hazcat_qos.h"
+#include "rmw_hazcat/hazcat_srv_clt.h"
+
 #ifdef __cplusplus
 extern "C"
 {
@@ -113,7 +117,122 @@ set_all_null(
   }
 }
 
+// Sets events with nothing to take to NULL, and returns how many are left
+static int
+check_events(rmw_events_t * events)
+{
+  int ready = 0;
+  if (NULL != events) {
+    for (int i = 0; i < events->event_count; i++) {
+      if (hazcat_event_ready(events->events[i])) {
+        ready++;
+      } else {
+        events->events[i] = NULL;
+      }
+    }
+  }
+  return ready;
+}
+
+static bool
+any_event_ready(const rmw_events_t * events)
+{
+  if (NULL != events) {
+    for (int i = 0; i < events->event_count; i++) {
+      if (hazcat_event_ready(events->events[i])) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
 #ifdef __linux__
+// Services and clients wait on the queue they take from, same as a subscription
+static int
+add_queue(int epollfd, pub_sub_data_t * queue)
+{
+  struct epoll_event ev = {.events = EPOLLIN, .data.fd = queue->mq->signalfd};
+  if (-1 == epoll_ctl(epollfd, EPOLL_CTL_ADD, queue->mq->signalfd, &ev) && EEXIST != errno) {
+    perror("epoll_ctl: ");
+    return -1;
+  }
+  return 0;
+}
+
+static int
+remove_queue(int epollfd, pub_sub_data_t * queue)
+{
+  struct epoll_event ev = {.events = EPOLLHUP, .data.fd = queue->mq->signalfd};
+  if (-1 == epoll_ctl(epollfd, EPOLL_CTL_DEL, queue->mq->signalfd, &ev) && ENOENT != errno) {
+    perror("epoll_ctl: ");
+    return -1;
+  }
+  return 0;
+}
+
+// Best effort subscriptions are also woken through their ring's socket. It doesn't count towards
+// the wait set's length, as the event list is only sized for one event per entity. Publishers
+// only wake subscriptions armed for it, every wait
+static int
+epoll_best_effort(int epollfd, int op, const pub_sub_data_t * sub)
+{
+  be_endpoint_t * best_effort = ((const pub_sub_info_t *)sub)->best_effort;
+  if (NULL == best_effort) {
+    return 0;
+  }
+  struct epoll_event ev = {.events = EPOLLIN, .data.fd = best_effort->sock};
+  if (-1 == epoll_ctl(epollfd, op, best_effort->sock, &ev) && EEXIST != errno && ENOENT != errno) {
+    perror("epoll_ctl: ");
+    return -1;
+  }
+  if (EPOLL_CTL_ADD == op) {
+    hazcat_be_arm(best_effort);
+  }
+  return 0;
+}
+
+// Deadline events wake on their endpoint's deadline timer, lost messages on the same files that
+// wake the subscription, since messages are only lost when new ones are published. Incompatible
+// QoS has nothing to wake on, it's only noticed whenever the wait set returns
+static int
+epoll_event_source(int epollfd, int op, const rmw_event_t * event)
+{
+  int fd = -1;
+  switch (event->event_type) {
+    case RMW_EVENT_REQUESTED_DEADLINE_MISSED:
+    case RMW_EVENT_OFFERED_DEADLINE_MISSED: {
+        // Both handles keep their info in data
+        deadline_t * deadline = &((pub_sub_info_t *)((const rmw_publisher_t *)event->data)->data)
+          ->deadline;
+        if (EPOLL_CTL_ADD == op) {
+          hazcat_deadline_arm(deadline);
+        }
+        fd = deadline->timer;
+        break;
+      }
+    case RMW_EVENT_MESSAGE_LOST: {
+        const pub_sub_data_t * sub = ((const rmw_subscription_t *)event->data)->data;
+        fd = sub->mq->signalfd;
+        if (-1 == epoll_best_effort(epollfd, op, sub)) {
+          return -1;
+        }
+        break;
+      }
+    default:
+      break;
+  }
+  if (-1 == fd) {
+    return 0;
+  }
+  struct epoll_event ev = {.events = EPOLLIN, .data.fd = fd};
+  if (-1 == epoll_ctl(epollfd, op, fd, &ev) && EEXIST != errno && ENOENT != errno) {
+    perror("epoll_ctl: ");
+    return -1;
+  }
+  return 0;
+}
+
 int
 clear_epoll(
   rmw_subscriptions_t * subscriptions,
@@ -133,6 +252,10 @@ clear_epoll(
         perror("epoll_ctl: ");
         return -1;
       }
+      if (-1 == epoll_best_effort(epollfd, EPOLL_CTL_DEL, sub)) {
+        RMW_SET_ERROR_MSG("Unable to remove subscription from epoll");
+        return -1;
+      }
     }
   }
 
@@ -147,6 +270,39 @@ clear_epoll(
       }
     }
   }
+
+  if (NULL != services) {
+    for (int i = 0; i < services->service_count; i++) {
+      RCUTILS_CHECK_ARGUMENT_FOR_NULL(services->services[i], RMW_RET_ERROR);
+      srv_clt_info_t * srv = (srv_clt_info_t *)services->services[i];
+      if (-1 == remove_queue(epollfd, &srv->queue)) {
+        RMW_SET_ERROR_MSG("Unable to remove service from epoll");
+        return -1;
+      }
+    }
+  }
+
+  if (NULL != clients) {
+    for (int i = 0; i < clients->client_count; i++) {
+      RCUTILS_CHECK_ARGUMENT_FOR_NULL(clients->clients[i], RMW_RET_ERROR);
+      srv_clt_info_t * clt = (srv_clt_info_t *)clients->clients[i];
+      if (-1 == remove_queue(epollfd, &clt->queue)) {
+        RMW_SET_ERROR_MSG("Unable to remove client from epoll");
+        return -1;
+      }
+    }
+  }
+
+  if (NULL != events) {
+    for (int i = 0; i < events->event_count; i++) {
+      RCUTILS_CHECK_ARGUMENT_FOR_NULL(events->events[i], RMW_RET_ERROR);
+      if (-1 == epoll_event_source(epollfd, EPOLL_CTL_DEL, events->events[i])) {
+        RMW_SET_ERROR_MSG("Unable to remove event from epoll");
+        return -1;
+      }
+    }
+  }
+  return 0;
 }
 #endif
 
@@ -182,8 +338,8 @@ rmw_wait(
 
   // Each message queue associated with a topic has an rmw_guard_condition. We collect all of them
   // from each subscription's topic, add them all to a poll/epoll. Similar approach for services
-  // and clients. guard_conditions are just added directly. No strategy for events. Waiting on the
-  // poll/epoll will reveal which topics or guards are ready
+  // and clients. guard_conditions are just added directly, and events by whatever signals them.
+  // Waiting on the poll/epoll will reveal which topics or guards are ready
 
   if (NULL != subscriptions) {
     for (int i = 0; i < subscriptions->subscriber_count; i++) {
@@ -196,6 +352,10 @@ rmw_wait(
         RMW_SET_ERROR_MSG("Unable to wait on subscription");
         return RMW_RET_ERROR;
       }
+      if (-1 == epoll_best_effort(ws->epollfd, EPOLL_CTL_ADD, sub)) {
+        RMW_SET_ERROR_MSG("Unable to wait on subscription");
+        return RMW_RET_ERROR;
+      }
       #else
       // TODO(nightduck): Use poll instead
       #endif
@@ -221,6 +381,51 @@ rmw_wait(
     }
   }
 
+  if (NULL != services) {
+    for (int i = 0; i < services->service_count; i++) {
+      #ifdef __linux__
+      RCUTILS_CHECK_ARGUMENT_FOR_NULL(services->services[i], RMW_RET_ERROR);
+      if (-1 == add_queue(ws->epollfd, &((srv_clt_info_t *)services->services[i])->queue)) {
+        RMW_SET_ERROR_MSG("Unable to wait on service");
+        return RMW_RET_ERROR;
+      }
+      #else
+      // TODO(nightduck): Use poll instead
+      #endif
+      ws->len++;
+    }
+  }
+
+  if (NULL != clients) {
+    for (int i = 0; i < clients->client_count; i++) {
+      #ifdef __linux__
+      RCUTILS_CHECK_ARGUMENT_FOR_NULL(clients->clients[i], RMW_RET_ERROR);
+      if (-1 == add_queue(ws->epollfd, &((srv_clt_info_t *)clients->clients[i])->queue)) {
+        RMW_SET_ERROR_MSG("Unable to wait on client");
+        return RMW_RET_ERROR;
+      }
+      #else
+      // TODO(nightduck): Use poll instead
+      #endif
+      ws->len++;
+    }
+  }
+
+  if (NULL != events) {
+    for (int i = 0; i < events->event_count; i++) {
+      #ifdef __linux__
+      RCUTILS_CHECK_ARGUMENT_FOR_NULL(events->events[i], RMW_RET_ERROR);
+      if (-1 == epoll_event_source(ws->epollfd, EPOLL_CTL_ADD, events->events[i])) {
+        RMW_SET_ERROR_MSG("Unable to wait on event");
+        return RMW_RET_ERROR;
+      }
+      #else
+      // TODO(nightduck): Use poll instead
+      #endif
+      ws->len++;
+    }
+  }
+
   if (ws->len == 0) {
     // Nothing to wait on, just return
     return RMW_RET_TIMEOUT;
@@ -233,13 +438,18 @@ rmw_wait(
   } else {
     timeout = wait_timeout->sec * 1000 + wait_timeout->nsec / 1000000;
   }
+  bool events_ready = any_event_ready(events);
+  if (events_ready) {
+    // Nothing will signal what's already there to take
+    timeout = 0;
+  }
   #ifdef __linux__
   int ready = epoll_wait(ws->epollfd, ws->evlist, ws->len, timeout);
   if (ready == -1) {
     RMW_SET_ERROR_MSG("rmw_wait error in epoll_wait");
     perror("epoll_wait: ");
     return RMW_RET_ERROR;
-  } else if (ready == 0) {
+  } else if (ready == 0 && !events_ready && !any_event_ready(events)) {
     // Uncomment if you can't make guarantees about persistence of executable-to-executor assignment
     clear_epoll(subscriptions, guard_conditions, services, clients, events, ws->epollfd);
 
@@ -272,9 +482,8 @@ rmw_wait(
   if (NULL != subscriptions) {
     for (int i = 0; i < subscriptions->subscriber_count; i++) {
       // if next index and my index equal, set pointer to null, because no message available
-      pub_sub_data_t * sub = (pub_sub_data_t *)subscriptions->subscribers[i];
-      message_queue_t * mq = sub->mq->elem;
-      if (sub->next_index == mq->index) {
+      // Expired messages don't count, they're released here
+      if (!hazcat_subscription_ready((pub_sub_info_t *)subscriptions->subscribers[i])) {
         subscriptions->subscribers[i] = NULL;
       }
     }
@@ -289,8 +498,24 @@ rmw_wait(
     }
   }
 
-  // Services, clients, and events not supported
-  set_all_null(NULL, NULL, services, clients, events);
+  if (NULL != services) {
+    for (int i = 0; i < services->service_count; i++) {
+      pub_sub_data_t * queue = &((srv_clt_info_t *)services->services[i])->queue;
+      if (queue->next_index == queue->mq->elem->index) {
+        services->services[i] = NULL;
+      }
+    }
+  }
+  if (NULL != clients) {
+    for (int i = 0; i < clients->client_count; i++) {
+      pub_sub_data_t * queue = &((srv_clt_info_t *)clients->clients[i])->queue;
+      if (queue->next_index == queue->mq->elem->index) {
+        clients->clients[i] = NULL;
+      }
+    }
+  }
+
+  check_events(events);
 
   return RMW_RET_OK;
 }
@@ -0,0 +1,545 @@
+// Copyright 2022 Washington University in St Louis
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include <sys/mman.h>
+#include <sys/shm.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstring>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "osrf_testing_tools_cpp/scope_exit.hpp"
+
+#include "rcutils/allocator.h"
+#include "rcutils/strdup.h"
+
+#include "rmw/error_handling.h"
+#include "rmw/rmw.h"
+
+#include "rosidl_runtime_c/string_functions.h"
+
+#include "test_msgs/msg/basic_types.h"
+#include "test_msgs/msg/empty.h"
+#include "test_msgs/msg/strings.h"
+
+#include "hazcat/hazcat_message_queue.h"
+
+#include "rmw_hazcat/hazcat_alloc.h"
+
+// Offset of a new allocation, or -1 if there's no room
+static int64_t
+allocate(hma_allocator_t * alloc, size_t size)
+{
+  hazcat_offset_t offset;
+  if (RMW_RET_OK != hazcat_allocate(alloc, size, &offset)) {
+    return -1;
+  }
+  return static_cast<int64_t>(offset);
+}
+
+TEST(TestTlsf, out_of_order_free) {
+  hma_allocator_t * alloc = hazcat_tlsf_create(4096, 0);
+  ASSERT_NE(nullptr, alloc);
+  EXPECT_EQ(TLSF_STRATEGY, alloc->strategy);
+  EXPECT_EQ(0u, alloc->domain);
+
+  int64_t a = allocate(alloc, 1000);
+  int64_t b = allocate(alloc, 1000);
+  int64_t c = allocate(alloc, 1000);
+  ASSERT_GT(a, 0);
+  ASSERT_GT(b, 0);
+  ASSERT_GT(c, 0);
+  EXPECT_EQ(0, a % TLSF_ALIGN);
+  EXPECT_GE(b, a + 1000);
+  EXPECT_GE(c, b + 1000);
+
+  // A ring buffer can't free b before a, nor reuse the hole it leaves
+  hazcat_deallocate(alloc, b);
+  EXPECT_EQ(b, allocate(alloc, 1000));
+  hazcat_deallocate(alloc, a);
+  hazcat_deallocate(alloc, c);
+  hazcat_deallocate(alloc, b);
+
+  // Everything merged back into one block
+  tlsf_allocator_t * tlsf = reinterpret_cast<tlsf_allocator_t *>(alloc);
+  EXPECT_EQ(a, allocate(alloc, tlsf->pool_size - sizeof(tlsf_block_t)));
+  EXPECT_EQ(-1, allocate(alloc, 1));
+  shmdt(alloc);
+}
+
+TEST(TestTlsf, variable_sizes) {
+  hma_allocator_t * alloc = hazcat_tlsf_create(1 << 20, 0);
+  ASSERT_NE(nullptr, alloc);
+  uint8_t * base = reinterpret_cast<uint8_t *>(alloc);
+
+  std::vector<int64_t> offsets;
+  std::vector<size_t> sizes;
+  for (size_t i = 0; i < 200; i++) {
+    size_t size = 1 + (i * 7919) % 3000;
+    int64_t offset = allocate(alloc, size);
+    ASSERT_GT(offset, 0);
+    memset(base + offset, static_cast<int>(i), size);
+    offsets.push_back(offset);
+    sizes.push_back(size);
+  }
+  // Free every other one, then fill the holes with different sizes
+  for (size_t i = 0; i < offsets.size(); i += 2) {
+    hazcat_deallocate(alloc, offsets[i]);
+  }
+  for (size_t i = 0; i < offsets.size(); i += 2) {
+    sizes[i] = 1 + (i * 104729) % 1500;
+    offsets[i] = allocate(alloc, sizes[i]);
+    ASSERT_GT(offsets[i], 0);
+    memset(base + offsets[i], static_cast<int>(i), sizes[i]);
+  }
+  for (size_t i = 0; i < offsets.size(); i++) {
+    for (size_t k = 0; k < sizes[i]; k++) {
+      ASSERT_EQ(static_cast<uint8_t>(i), base[offsets[i] + k]) << "message " << i << " overlaps";
+    }
+  }
+  shmdt(alloc);
+}
+
+// Each subscription that takes a message releases its own reference, the last one frees it
+TEST(TestTlsf, shared_references) {
+  hma_allocator_t * alloc = hazcat_tlsf_create(4096, 0);
+  ASSERT_NE(nullptr, alloc);
+  tlsf_allocator_t * tlsf = reinterpret_cast<tlsf_allocator_t *>(alloc);
+  int64_t a = allocate(alloc, 100);
+  int64_t b = allocate(alloc, 100);
+  ASSERT_GT(a, 0);
+  ASSERT_GT(b, 0);
+  tlsf_block_t * block =
+    reinterpret_cast<tlsf_block_t *>(reinterpret_cast<uint8_t *>(alloc) + a) - 1;
+
+  hazcat_share(alloc, a, 2);
+  hazcat_deallocate(alloc, a);
+  hazcat_deallocate(alloc, a);
+  EXPECT_FALSE(block->size & TLSF_BLOCK_FREE);
+  hazcat_deallocate(alloc, a);
+  EXPECT_TRUE(block->size & TLSF_BLOCK_FREE);
+  // One release too many is ignored, rather than freeing whatever is there next
+  hazcat_deallocate(alloc, a);
+  hazcat_deallocate(alloc, b);
+  EXPECT_EQ(a, allocate(alloc, tlsf->pool_size - sizeof(tlsf_block_t)));
+  shmdt(alloc);
+}
+
+TEST(TestTlsf, shared_between_processes) {
+  hma_allocator_t * alloc = hazcat_tlsf_create(4096, 0);
+  ASSERT_NE(nullptr, alloc);
+  int64_t first = allocate(alloc, 100);
+  ASSERT_GT(first, 0);
+
+  // Another process frees this one's message and allocates its own, by attaching through the id
+  int shmem_id = alloc->shmem_id;
+  pid_t pid = fork();
+  ASSERT_NE(-1, pid);
+  if (0 == pid) {
+    hma_allocator_t * other = reinterpret_cast<hma_allocator_t *>(shmat(shmem_id, NULL, 0));
+    if (reinterpret_cast<void *>(-1) == other) {
+      _exit(1);
+    }
+    hazcat_deallocate(other, first);
+    int64_t offset = allocate(other, 200);
+    _exit(offset == first ? 0 : 2);
+  }
+  int status;
+  ASSERT_EQ(pid, waitpid(pid, &status, 0));
+  ASSERT_TRUE(WIFEXITED(status));
+  EXPECT_EQ(0, WEXITSTATUS(status));
+
+  // The child's block is still held
+  EXPECT_NE(first, allocate(alloc, 100));
+  shmdt(alloc);
+}
+
+TEST(TestTlsf, beyond_2gb) {
+  // Message queues couldn't reference blocks past the limit, so such pools are never made
+  EXPECT_EQ(nullptr, hazcat_tlsf_create(3ull << 30, 0));
+  rmw_reset_error();
+  EXPECT_EQ(nullptr, hazcat_tlsf_create(HAZCAT_QUEUE_OFFSET_MAX, 0));
+  rmw_reset_error();
+  EXPECT_EQ(nullptr, hazcat_slab_create(1 << 20, 1 << 12, 0));
+  rmw_reset_error();
+}
+
+TEST(TestTlsf, huge_pages) {
+  // Whether or not huge pages are available, the allocator works the same
+  hma_allocator_t * alloc = hazcat_tlsf_create(4 << 20, HAZCAT_SEGMENT_HUGE_PAGES);
+  ASSERT_NE(nullptr, alloc);
+  int64_t offset = allocate(alloc, 3 << 20);
+  ASSERT_GT(offset, 0);
+  memset(reinterpret_cast<uint8_t *>(alloc) + offset, 0xA5, 3 << 20);
+  hazcat_deallocate(alloc, offset);
+  shmdt(alloc);
+}
+
+TEST(TestTlsf, locked) {
+  size_t before = hazcat_segment_locked_bytes();
+  hma_allocator_t * alloc = hazcat_tlsf_create(256 << 10, HAZCAT_SEGMENT_LOCKED);
+  if (nullptr == alloc) {
+    // RLIMIT_MEMLOCK is too low here, which must fail creation rather than go unnoticed
+    EXPECT_EQ(before, hazcat_segment_locked_bytes());
+    rmw_reset_error();
+    return;
+  }
+  EXPECT_GE(hazcat_segment_locked_bytes(), before + (256 << 10));
+
+  // Every page is resident before anything is allocated
+  std::vector<unsigned char> resident((256 << 10) / getpagesize());
+  ASSERT_EQ(0, mincore(alloc, 256 << 10, resident.data()));
+  for (unsigned char page : resident) {
+    EXPECT_TRUE(page & 1);
+  }
+
+  // Locking the mapping again only takes another reference, it stays locked until both are dropped
+  size_t locked = hazcat_segment_locked_bytes();
+  ASSERT_EQ(RMW_RET_OK, hazcat_segment_advise(alloc, 256 << 10, HAZCAT_SEGMENT_LOCKED));
+  EXPECT_EQ(locked, hazcat_segment_locked_bytes());
+  hazcat_segment_unlock(alloc);
+  EXPECT_EQ(locked, hazcat_segment_locked_bytes());
+  hazcat_segment_unlock(alloc);
+  EXPECT_EQ(before, hazcat_segment_locked_bytes());
+  shmdt(alloc);
+}
+
+TEST(TestTlsf, numa_node) {
+  hma_allocator_t * alloc = hazcat_tlsf_create(1 << 20, HAZCAT_SEGMENT_NODE(0));
+  ASSERT_NE(nullptr, alloc);
+  int64_t offset = allocate(alloc, 512 << 10);
+  ASSERT_GT(offset, 0);
+  uint8_t * msg = reinterpret_cast<uint8_t *>(alloc) + offset;
+  memset(msg, 0xA5, 512 << 10);
+  // Every machine has a node 0
+  EXPECT_EQ(0, hazcat_segment_node(alloc));
+  EXPECT_EQ(0, hazcat_segment_node(msg + (256 << 10)));
+  hazcat_deallocate(alloc, offset);
+  shmdt(alloc);
+
+  alloc = hazcat_tlsf_create(1 << 20, HAZCAT_SEGMENT_INTERLEAVE);
+  ASSERT_NE(nullptr, alloc);
+  EXPECT_LE(0, hazcat_segment_node(alloc));
+  shmdt(alloc);
+}
+
+TEST(TestSlab, size_classes) {
+  EXPECT_EQ(64u, hazcat_slab_size_class(1));
+  EXPECT_EQ(64u, hazcat_slab_size_class(64));
+  EXPECT_EQ(128u, hazcat_slab_size_class(65));
+  EXPECT_EQ(192u, hazcat_slab_size_class(129));
+  EXPECT_EQ(256u, hazcat_slab_size_class(193));
+  EXPECT_EQ(3u << 20, hazcat_slab_size_class((2u << 20) + 1));
+}
+
+TEST(TestSlab, reuses_warmest_slot) {
+  hma_allocator_t * alloc = hazcat_slab_create(128, 4, 0);
+  ASSERT_NE(nullptr, alloc);
+  EXPECT_EQ(SLAB_STRATEGY, alloc->strategy);
+
+  int64_t slots[4];
+  for (int i = 0; i < 4; i++) {
+    slots[i] = allocate(alloc, 100);
+    ASSERT_GT(slots[i], 0);
+    EXPECT_EQ(0, slots[i] % SLAB_ALIGN);
+  }
+  EXPECT_EQ(-1, allocate(alloc, 100));
+  EXPECT_EQ(-1, allocate(alloc, 129));
+
+  // Freed in any order, the last one freed is the first handed out
+  hazcat_deallocate(alloc, slots[2]);
+  hazcat_deallocate(alloc, slots[0]);
+  EXPECT_EQ(slots[0], allocate(alloc, 1));
+  EXPECT_EQ(slots[2], allocate(alloc, 1));
+  shmdt(alloc);
+}
+
+// A slot shared by several subscriptions goes back on the free stack once, after the last of them
+// releases it, however many times it's released
+TEST(TestSlab, shared_references) {
+  hma_allocator_t * alloc = hazcat_slab_create(64, 4, 0);
+  ASSERT_NE(nullptr, alloc);
+  int64_t slot = allocate(alloc, 64);
+  ASSERT_GT(slot, 0);
+
+  hazcat_share(alloc, slot, 2);
+  hazcat_deallocate(alloc, slot);
+  hazcat_deallocate(alloc, slot);
+  int64_t other = allocate(alloc, 64);
+  EXPECT_NE(slot, other);
+  hazcat_deallocate(alloc, slot);
+  hazcat_deallocate(alloc, slot);
+  hazcat_deallocate(alloc, slot);
+
+  // Pushed twice, it would be handed out twice here
+  std::set<int64_t> offsets = {other};
+  for (int i = 0; i < 3; i++) {
+    int64_t offset = allocate(alloc, 64);
+    ASSERT_GT(offset, 0);
+    EXPECT_TRUE(offsets.insert(offset).second) << "slot " << offset << " handed out twice";
+  }
+  EXPECT_EQ(-1, allocate(alloc, 64));
+  shmdt(alloc);
+}
+
+TEST(TestSlab, concurrent) {
+  const int threads = 4;
+  const int per_thread = 64;
+  hma_allocator_t * alloc = hazcat_slab_create(64, threads * per_thread, 0);
+  ASSERT_NE(nullptr, alloc);
+
+  // Every thread churns through its share of slots, then holds on to them. No slot is ever handed
+  // to two threads at once
+  std::vector<std::vector<int64_t>> held(threads);
+  std::vector<std::thread> workers;
+  for (int t = 0; t < threads; t++) {
+    workers.emplace_back(
+      [&, t]() {
+        for (int round = 0; round < 1000; round++) {
+          for (int i = 0; i < per_thread; i++) {
+            held[t].push_back(allocate(alloc, 64));
+          }
+          if (round < 999) {
+            for (int64_t offset : held[t]) {
+              hazcat_deallocate(alloc, offset);
+            }
+            held[t].clear();
+          }
+        }
+      });
+  }
+  for (auto & worker : workers) {
+    worker.join();
+  }
+  std::set<int64_t> offsets;
+  for (auto & slots : held) {
+    for (int64_t offset : slots) {
+      EXPECT_GT(offset, 0);
+      EXPECT_TRUE(offsets.insert(offset).second) << "slot " << offset << " handed out twice";
+    }
+  }
+  EXPECT_EQ(-1, allocate(alloc, 64));
+  shmdt(alloc);
+}
+
+class TestDefaultAllocator : public ::testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    rmw_init_options_t options = rmw_get_zero_initialized_init_options();
+    rmw_ret_t ret = rmw_init_options_init(&options, rcutils_get_default_allocator());
+    ASSERT_EQ(RMW_RET_OK, ret) << rcutils_get_error_string().str;
+    OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+    {
+      rmw_ret_t ret = rmw_init_options_fini(&options);
+      EXPECT_EQ(RMW_RET_OK, ret) << rmw_get_error_string().str;
+    });
+    options.enclave = rcutils_strdup("/", rcutils_get_default_allocator());
+    ASSERT_STREQ("/", options.enclave);
+    context = rmw_get_zero_initialized_context();
+    ret = rmw_init(&options, &context);
+    ASSERT_EQ(RMW_RET_OK, ret) << rcutils_get_error_string().str;
+    node = rmw_create_node(&context, "alloc_test_node", "/alloc_test", 1, true);
+    ASSERT_NE(nullptr, node) << rcutils_get_error_string().str;
+  }
+
+  void TearDown() override
+  {
+    rmw_ret_t ret = rmw_destroy_node(node);
+    EXPECT_EQ(RMW_RET_OK, ret) << rcutils_get_error_string().str;
+    ret = rmw_shutdown(&context);
+    EXPECT_EQ(RMW_RET_OK, ret) << rcutils_get_error_string().str;
+    ret = rmw_context_fini(&context);
+    EXPECT_EQ(RMW_RET_OK, ret) << rcutils_get_error_string().str;
+  }
+
+  const rosidl_message_type_support_t * ts =
+    ROSIDL_GET_MSG_TYPE_SUPPORT(test_msgs, msg, BasicTypes);
+  rmw_publisher_options_t pub_options = rmw_get_default_publisher_options();
+  rmw_subscription_options_t sub_options = rmw_get_default_subscription_options();
+  rmw_context_t context;
+  rmw_node_t * node;
+};
+
+TEST_F(TestDefaultAllocator, shared_by_type) {
+  rmw_qos_profile_t qos = rmw_qos_profile_default;
+  rmw_publisher_t * first = rmw_create_publisher(node, ts, "/shared_a", &qos, &pub_options);
+  ASSERT_NE(nullptr, first) << rcutils_get_error_string().str;
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    EXPECT_EQ(RMW_RET_OK, rmw_destroy_publisher(node, first)) << rcutils_get_error_string().str;
+  });
+  rmw_publisher_t * second = rmw_create_publisher(node, ts, "/shared_b", &qos, &pub_options);
+  ASSERT_NE(nullptr, second) << rcutils_get_error_string().str;
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    EXPECT_EQ(RMW_RET_OK, rmw_destroy_publisher(node, second)) << rcutils_get_error_string().str;
+  });
+  rmw_subscription_t * sub = rmw_create_subscription(node, ts, "/shared_b", &qos, &sub_options);
+  ASSERT_NE(nullptr, sub) << rcutils_get_error_string().str;
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    EXPECT_EQ(RMW_RET_OK, rmw_destroy_subscription(node, sub)) << rcutils_get_error_string().str;
+  });
+
+  // The first endpoint of the type has its own pool, the rest share one slab between them
+  hma_allocator_t * first_alloc = reinterpret_cast<pub_sub_data_t *>(first->data)->alloc;
+  hma_allocator_t * second_alloc = reinterpret_cast<pub_sub_data_t *>(second->data)->alloc;
+  EXPECT_EQ(TLSF_STRATEGY, first_alloc->strategy);
+  EXPECT_EQ(SLAB_STRATEGY, second_alloc->strategy);
+  EXPECT_EQ(second_alloc, reinterpret_cast<pub_sub_data_t *>(sub->data)->alloc);
+
+  test_msgs__msg__BasicTypes msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.int64_value = 42;
+  ASSERT_EQ(RMW_RET_OK, rmw_publish(second, &msg, nullptr)) << rcutils_get_error_string().str;
+  msg.int64_value = 0;
+  bool taken = false;
+  ASSERT_EQ(RMW_RET_OK, rmw_take(sub, &msg, &taken, nullptr));
+  EXPECT_TRUE(taken);
+  EXPECT_EQ(42, msg.int64_value);
+}
+
+TEST_F(TestDefaultAllocator, shared_by_topic) {
+  rmw_qos_profile_t qos = rmw_qos_profile_default;
+  rmw_publisher_t * first = rmw_create_publisher(node, ts, "/shared_topic", &qos, &pub_options);
+  ASSERT_NE(nullptr, first) << rcutils_get_error_string().str;
+  rmw_publisher_t * second = rmw_create_publisher(node, ts, "/shared_topic", &qos, &pub_options);
+  ASSERT_NE(nullptr, second) << rcutils_get_error_string().str;
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    EXPECT_EQ(RMW_RET_OK, rmw_destroy_publisher(node, second)) << rcutils_get_error_string().str;
+  });
+  qos.depth *= 2;
+  rmw_publisher_t * deeper = rmw_create_publisher(node, ts, "/shared_topic", &qos, &pub_options);
+  ASSERT_NE(nullptr, deeper) << rcutils_get_error_string().str;
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    EXPECT_EQ(RMW_RET_OK, rmw_destroy_publisher(node, deeper)) << rcutils_get_error_string().str;
+  });
+  qos.depth /= 2;
+  rmw_subscription_t * sub =
+    rmw_create_subscription(node, ts, "/shared_topic", &qos, &sub_options);
+  ASSERT_NE(nullptr, sub) << rcutils_get_error_string().str;
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    EXPECT_EQ(RMW_RET_OK, rmw_destroy_subscription(node, sub)) << rcutils_get_error_string().str;
+  });
+
+  // Publishers of a topic share an allocator, unless it's too shallow for them
+  hma_allocator_t * alloc = reinterpret_cast<pub_sub_data_t *>(first->data)->alloc;
+  EXPECT_EQ(alloc, reinterpret_cast<pub_sub_data_t *>(second->data)->alloc);
+  EXPECT_NE(alloc, reinterpret_cast<pub_sub_data_t *>(deeper->data)->alloc);
+
+  // The allocator outlives the publisher it was made for
+  ASSERT_EQ(RMW_RET_OK, rmw_destroy_publisher(node, first)) << rcutils_get_error_string().str;
+  test_msgs__msg__BasicTypes msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.int64_value = 42;
+  ASSERT_EQ(RMW_RET_OK, rmw_publish(second, &msg, nullptr)) << rcutils_get_error_string().str;
+  msg.int64_value = 0;
+  bool taken = false;
+  ASSERT_EQ(RMW_RET_OK, rmw_take(sub, &msg, &taken, nullptr));
+  EXPECT_TRUE(taken);
+  EXPECT_EQ(42, msg.int64_value);
+
+  // And publishers joining later still share it
+  rmw_publisher_t * third = rmw_create_publisher(node, ts, "/shared_topic", &qos, &pub_options);
+  ASSERT_NE(nullptr, third) << rcutils_get_error_string().str;
+  EXPECT_EQ(alloc, reinterpret_cast<pub_sub_data_t *>(third->data)->alloc);
+  EXPECT_EQ(RMW_RET_OK, rmw_destroy_publisher(node, third)) << rcutils_get_error_string().str;
+}
+
+TEST_F(TestDefaultAllocator, small_messages_skip_tlsf) {
+  // Header and message together fit in one cache line, so even the first publisher gets a slab
+  const rosidl_message_type_support_t * empty_ts =
+    ROSIDL_GET_MSG_TYPE_SUPPORT(test_msgs, msg, Empty);
+  rmw_qos_profile_t qos = rmw_qos_profile_default;
+  rmw_publisher_t * pub = rmw_create_publisher(node, empty_ts, "/small", &qos, &pub_options);
+  ASSERT_NE(nullptr, pub) << rcutils_get_error_string().str;
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    EXPECT_EQ(RMW_RET_OK, rmw_destroy_publisher(node, pub)) << rcutils_get_error_string().str;
+  });
+  rmw_subscription_t * sub = rmw_create_subscription(node, empty_ts, "/small", &qos, &sub_options);
+  ASSERT_NE(nullptr, sub) << rcutils_get_error_string().str;
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    EXPECT_EQ(RMW_RET_OK, rmw_destroy_subscription(node, sub)) << rcutils_get_error_string().str;
+  });
+
+  hma_allocator_t * alloc = reinterpret_cast<pub_sub_data_t *>(pub->data)->alloc;
+  ASSERT_EQ(SLAB_STRATEGY, alloc->strategy);
+  EXPECT_EQ(
+    static_cast<uint32_t>(SLAB_ALIGN), reinterpret_cast<slab_allocator_t *>(alloc)->slot_size);
+
+  test_msgs__msg__Empty msg;
+  memset(&msg, 0, sizeof(msg));
+  for (int i = 0; i < 3; i++) {
+    ASSERT_EQ(RMW_RET_OK, rmw_publish(pub, &msg, nullptr)) << rcutils_get_error_string().str;
+    bool taken = false;
+    ASSERT_EQ(RMW_RET_OK, rmw_take(sub, &msg, &taken, nullptr));
+    EXPECT_TRUE(taken);
+  }
+}
+
+TEST_F(TestDefaultAllocator, variable_size_types_skip_slabs) {
+  // Flattened strings can outgrow any slab slot, so every endpoint of the type gets its own pool
+  const rosidl_message_type_support_t * strings_ts =
+    ROSIDL_GET_MSG_TYPE_SUPPORT(test_msgs, msg, Strings);
+  rmw_qos_profile_t qos = rmw_qos_profile_default;
+  rmw_publisher_t * first = rmw_create_publisher(node, strings_ts, "/var_a", &qos, &pub_options);
+  ASSERT_NE(nullptr, first) << rcutils_get_error_string().str;
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    EXPECT_EQ(RMW_RET_OK, rmw_destroy_publisher(node, first)) << rcutils_get_error_string().str;
+  });
+  rmw_publisher_t * second = rmw_create_publisher(node, strings_ts, "/var_b", &qos, &pub_options);
+  ASSERT_NE(nullptr, second) << rcutils_get_error_string().str;
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    EXPECT_EQ(RMW_RET_OK, rmw_destroy_publisher(node, second)) << rcutils_get_error_string().str;
+  });
+  rmw_subscription_t * sub =
+    rmw_create_subscription(node, strings_ts, "/var_b", &qos, &sub_options);
+  ASSERT_NE(nullptr, sub) << rcutils_get_error_string().str;
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    EXPECT_EQ(RMW_RET_OK, rmw_destroy_subscription(node, sub)) << rcutils_get_error_string().str;
+  });
+
+  EXPECT_EQ(TLSF_STRATEGY, reinterpret_cast<pub_sub_data_t *>(first->data)->alloc->strategy);
+  EXPECT_EQ(TLSF_STRATEGY, reinterpret_cast<pub_sub_data_t *>(second->data)->alloc->strategy);
+  EXPECT_EQ(TLSF_STRATEGY, reinterpret_cast<pub_sub_data_t *>(sub->data)->alloc->strategy);
+
+  test_msgs__msg__Strings msg;
+  ASSERT_TRUE(test_msgs__msg__Strings__init(&msg));
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT({test_msgs__msg__Strings__fini(&msg);});
+  std::string long_string(1000, 'x');
+  ASSERT_TRUE(rosidl_runtime_c__String__assign(&msg.string_value, long_string.c_str()));
+  ASSERT_EQ(RMW_RET_OK, rmw_publish(second, &msg, nullptr)) << rcutils_get_error_string().str;
+  ASSERT_TRUE(rosidl_runtime_c__String__assign(&msg.string_value, ""));
+  bool taken = false;
+  ASSERT_EQ(RMW_RET_OK, rmw_take(sub, &msg, &taken, nullptr)) << rcutils_get_error_string().str;
+  EXPECT_TRUE(taken);
+  EXPECT_EQ(long_string, msg.string_value.data);
+}
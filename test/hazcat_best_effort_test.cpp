@@ -0,0 +1,289 @@
+// Copyright 2022 Washington University in St Louis
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <fcntl.h>
+#include <gtest/gtest.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "rmw/error_handling.h"
+
+#include "rmw_hazcat/hazcat_best_effort.h"
+
+#define MSG_SIZE        24
+#define RING_DEPTH      16
+#define READERS         4
+#define MESSAGES        200000
+
+// Creates a ring the way an endpoint would, but with slots stride bytes apart
+static bool
+create_ring(const char * topic_name, uint32_t stride)
+{
+  std::string file_name = std::string(BE_FILE_PREFIX) + topic_name;
+  for (size_t i = 1; i < file_name.size(); i++) {
+    if ('/' == file_name[i]) {
+      file_name[i] = '.';
+    }
+  }
+  int fd = shm_open(file_name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0666);
+  if (-1 == fd) {
+    return false;
+  }
+  size_t size = sizeof(be_ring_t) + RING_DEPTH * stride;
+  void * addr = MAP_FAILED;
+  if (0 == ftruncate(fd, size)) {
+    addr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  }
+  close(fd);
+  if (MAP_FAILED == addr) {
+    shm_unlink(file_name.c_str());
+    return false;
+  }
+  be_ring_t * ring = reinterpret_cast<be_ring_t *>(addr);
+  ring->len = RING_DEPTH;
+  ring->msg_size = MSG_SIZE;
+  ring->stride = stride;
+  __atomic_store_n(&ring->magic, BE_MAGIC, __ATOMIC_RELEASE);
+  munmap(addr, size);
+  return true;
+}
+
+struct Result
+{
+  uint64_t taken;
+  uint64_t lost;
+};
+
+// One publisher against READERS readers spinning on the ring, each on its own thread. Readers
+// poll rather than register for wake ups, so publishing costs no system calls
+static Result
+contend(const char * topic_name)
+{
+  be_endpoint_t pub;
+  be_endpoint_t subs[READERS];
+  EXPECT_EQ(RMW_RET_OK, hazcat_be_attach(&pub, topic_name, MSG_SIZE, RING_DEPTH, false));
+  for (int i = 0; i < READERS; i++) {
+    EXPECT_EQ(RMW_RET_OK, hazcat_be_attach(&subs[i], topic_name, MSG_SIZE, RING_DEPTH, false));
+  }
+
+  std::atomic<bool> done(false);
+  std::atomic<int> started(0);
+  std::atomic<uint64_t> taken(0);
+  std::vector<std::thread> readers;
+  for (int i = 0; i < READERS; i++) {
+    readers.emplace_back(
+      [&, i]() {
+        uint64_t header;
+        uint8_t msg[MSG_SIZE];
+        uint64_t count = 0;
+        started++;
+        while (!done.load(std::memory_order_relaxed)) {
+          count += hazcat_be_take(&subs[i], &header, sizeof(header), msg, sizeof(msg));
+        }
+        while (hazcat_be_take(&subs[i], &header, sizeof(header), msg, sizeof(msg))) {
+          count++;
+        }
+        taken += count;
+      });
+  }
+  while (READERS != started.load()) {
+    std::this_thread::yield();
+  }
+
+  uint8_t msg[MSG_SIZE - sizeof(uint64_t)] = {0};
+  for (uint64_t i = 0; i < MESSAGES; i++) {
+    hazcat_be_publish(&pub, &i, sizeof(i), msg, sizeof(msg));
+  }
+  done = true;
+  for (auto & reader : readers) {
+    reader.join();
+  }
+
+  Result result;
+  result.taken = taken;
+  result.lost = 0;
+  for (int i = 0; i < READERS; i++) {
+    result.lost += subs[i].lost;
+    hazcat_be_detach(&subs[i]);
+  }
+  hazcat_be_detach(&pub);
+  return result;
+}
+
+TEST(TestBestEffort, slots_on_own_cache_line) {
+  be_endpoint_t pub;
+  ASSERT_EQ(RMW_RET_OK, hazcat_be_attach(&pub, "/be_padded", MSG_SIZE, RING_DEPTH, false)) <<
+    rmw_get_error_string().str;
+  EXPECT_EQ(0u, sizeof(be_ring_t) % BE_CACHE_LINE);
+  EXPECT_EQ(0u, offsetof(be_ring_t, head) % BE_CACHE_LINE);
+  EXPECT_EQ(0u, pub.ring->stride % BE_CACHE_LINE);
+  EXPECT_GE(pub.ring->stride, sizeof(be_slot_t) + MSG_SIZE);
+  hazcat_be_detach(&pub);
+}
+
+// Rings keep the stride they were made with, so endpoints still read ones laid out differently
+TEST(TestBestEffort, packed_ring) {
+  uint32_t packed = (sizeof(be_slot_t) + MSG_SIZE + 7) & ~7u;
+  ASSERT_TRUE(create_ring("/be_packed", packed));
+  be_endpoint_t pub, sub;
+  ASSERT_EQ(RMW_RET_OK, hazcat_be_attach(&pub, "/be_packed", MSG_SIZE, RING_DEPTH, false)) <<
+    rmw_get_error_string().str;
+  ASSERT_EQ(RMW_RET_OK, hazcat_be_attach(&sub, "/be_packed", MSG_SIZE, RING_DEPTH, true)) <<
+    rmw_get_error_string().str;
+  EXPECT_EQ(packed, pub.ring->stride);
+
+  for (uint64_t i = 0; i < 2 * RING_DEPTH; i++) {
+    uint64_t msg[2] = {i, ~i};
+    ASSERT_EQ(RMW_RET_OK, hazcat_be_publish(&pub, &i, sizeof(i), msg, sizeof(msg)));
+  }
+  for (uint64_t i = RING_DEPTH; i < 2 * RING_DEPTH; i++) {
+    uint64_t header, msg[2];
+    ASSERT_TRUE(hazcat_be_take(&sub, &header, sizeof(header), msg, sizeof(msg)));
+    EXPECT_EQ(i, header);
+    EXPECT_EQ(i, msg[0]);
+    EXPECT_EQ(~i, msg[1]);
+  }
+  EXPECT_EQ(static_cast<uint64_t>(RING_DEPTH), sub.lost);
+
+  hazcat_be_detach(&sub);
+  hazcat_be_detach(&pub);
+}
+
+// Readers are only sent a wake up once armed, whether by a later publish or one already waiting
+TEST(TestBestEffort, armed_wake_ups) {
+  be_endpoint_t pub, sub;
+  ASSERT_EQ(RMW_RET_OK, hazcat_be_attach(&pub, "/be_wake", MSG_SIZE, RING_DEPTH, false)) <<
+    rmw_get_error_string().str;
+  ASSERT_EQ(RMW_RET_OK, hazcat_be_attach(&sub, "/be_wake", MSG_SIZE, RING_DEPTH, true)) <<
+    rmw_get_error_string().str;
+  char buffer[16];
+  uint64_t header = 0, msg[2] = {0, 0};
+
+  ASSERT_EQ(RMW_RET_OK, hazcat_be_publish(&pub, &header, sizeof(header), msg, sizeof(msg)));
+  EXPECT_EQ(-1, recv(sub.sock, buffer, sizeof(buffer), MSG_DONTWAIT));
+  hazcat_be_arm(&sub);
+  EXPECT_EQ(1, recv(sub.sock, buffer, sizeof(buffer), MSG_DONTWAIT));
+  EXPECT_TRUE(hazcat_be_take(&sub, &header, sizeof(header), msg, sizeof(msg)));
+
+  hazcat_be_arm(&sub);
+  EXPECT_EQ(-1, recv(sub.sock, buffer, sizeof(buffer), MSG_DONTWAIT));
+  ASSERT_EQ(RMW_RET_OK, hazcat_be_publish(&pub, &header, sizeof(header), msg, sizeof(msg)));
+  ASSERT_EQ(RMW_RET_OK, hazcat_be_publish(&pub, &header, sizeof(header), msg, sizeof(msg)));
+  EXPECT_EQ(1, recv(sub.sock, buffer, sizeof(buffer), MSG_DONTWAIT));
+  EXPECT_EQ(-1, recv(sub.sock, buffer, sizeof(buffer), MSG_DONTWAIT));
+  EXPECT_TRUE(hazcat_be_ready(&sub));
+
+  hazcat_be_detach(&sub);
+  hazcat_be_detach(&pub);
+}
+
+// Entries of readers whose process died without detaching are freed up once they're all taken
+TEST(TestBestEffort, dead_readers_reclaimed) {
+  be_endpoint_t pub, sub;
+  ASSERT_EQ(RMW_RET_OK, hazcat_be_attach(&pub, "/be_dead", MSG_SIZE, RING_DEPTH, false)) <<
+    rmw_get_error_string().str;
+  pid_t pid = fork();
+  ASSERT_NE(-1, pid);
+  if (0 == pid) {
+    be_endpoint_t readers[BE_MAX_READERS];
+    for (auto & reader : readers) {
+      if (RMW_RET_OK != hazcat_be_attach(&reader, "/be_dead", MSG_SIZE, RING_DEPTH, true)) {
+        _exit(1);
+      }
+    }
+    _exit(0);
+  }
+  int status;
+  ASSERT_EQ(pid, waitpid(pid, &status, 0));
+  ASSERT_TRUE(WIFEXITED(status));
+  ASSERT_EQ(0, WEXITSTATUS(status));
+
+  EXPECT_EQ(RMW_RET_OK, hazcat_be_attach(&sub, "/be_dead", MSG_SIZE, RING_DEPTH, true)) <<
+    rmw_get_error_string().str;
+  hazcat_be_detach(&sub);
+  // The dead readers' references on the ring are never given back
+  shm_unlink(pub.file_name);
+  hazcat_be_detach(&pub);
+}
+
+// Publishers lapping each other on a short ring never leave a torn message for readers to take
+TEST(TestBestEffort, concurrent_publishers) {
+  be_endpoint_t pubs[READERS], sub;
+  for (int i = 0; i < READERS; i++) {
+    ASSERT_EQ(RMW_RET_OK, hazcat_be_attach(&pubs[i], "/be_publishers", MSG_SIZE, 2, false)) <<
+      rmw_get_error_string().str;
+  }
+  ASSERT_EQ(RMW_RET_OK, hazcat_be_attach(&sub, "/be_publishers", MSG_SIZE, 2, false)) <<
+    rmw_get_error_string().str;
+
+  std::atomic<bool> done(false);
+  uint64_t taken = 0, torn = 0;
+  std::thread reader(
+    [&]() {
+      uint64_t header, msg[2];
+      bool finished = false;
+      while (!finished) {
+        finished = done.load();
+        while (hazcat_be_take(&sub, &header, sizeof(header), msg, sizeof(msg))) {
+          taken++;
+          torn += (msg[0] != header || msg[1] != ~header);
+        }
+      }
+    });
+  std::vector<std::thread> publishers;
+  for (int i = 0; i < READERS; i++) {
+    publishers.emplace_back(
+      [&, i]() {
+        for (uint64_t j = 0; j < MESSAGES / READERS; j++) {
+          uint64_t header = j * READERS + i;
+          uint64_t msg[2] = {header, ~header};
+          hazcat_be_publish(&pubs[i], &header, sizeof(header), msg, sizeof(msg));
+        }
+      });
+  }
+  for (auto & publisher : publishers) {
+    publisher.join();
+  }
+  done = true;
+  reader.join();
+
+  EXPECT_EQ(0u, torn);
+  EXPECT_EQ(static_cast<uint64_t>(MESSAGES), taken + sub.lost);
+  hazcat_be_detach(&sub);
+  for (int i = 0; i < READERS; i++) {
+    hazcat_be_detach(&pubs[i]);
+  }
+}
+
+// Slots padded to a cache line, and slots packed 8 bytes apart whose stamps and messages straddle
+// lines shared with their neighbours, both hold up to readers spinning on them
+TEST(TestBestEffort, layout_under_contention) {
+  uint32_t packed = (sizeof(be_slot_t) + MSG_SIZE + 7) & ~7u;
+  ASSERT_TRUE(create_ring("/be_contended_packed", packed));
+  Result packed_result = contend("/be_contended_packed");
+  Result padded_result = contend("/be_contended_padded");
+
+  // Everything published was either taken or counted lost by every reader
+  EXPECT_EQ(static_cast<uint64_t>(READERS) * MESSAGES, packed_result.taken + packed_result.lost);
+  EXPECT_EQ(static_cast<uint64_t>(READERS) * MESSAGES, padded_result.taken + padded_result.lost);
+}
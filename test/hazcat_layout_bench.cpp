@@ -0,0 +1,207 @@
+// Copyright 2022 Washington University in St Louis
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Times best effort publishing against readers spinning on the same ring, with slots padded to a
+// cache line each and with slots packed 8 bytes apart, whose stamps and messages share lines with
+// their neighbours. Not run by ctest, as timings depend on the machine. Usage:
+//   hazcat_layout_bench [messages]
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "rmw_hazcat/hazcat_best_effort.h"
+
+#define MSG_SIZE        24
+#define RING_DEPTH      16
+#define MAX_READERS     8
+#define MESSAGES        1000000
+#define RUNS            5
+
+static std::string
+ring_file_name(const std::string & topic_name)
+{
+  std::string file_name = std::string(BE_FILE_PREFIX) + topic_name;
+  for (size_t i = 1; i < file_name.size(); i++) {
+    if ('/' == file_name[i]) {
+      file_name[i] = '.';
+    }
+  }
+  return file_name;
+}
+
+// Creates a ring the way an endpoint would, but with slots stride bytes apart
+static bool
+create_ring(const std::string & topic_name, uint32_t stride)
+{
+  std::string file_name = ring_file_name(topic_name);
+  int fd = shm_open(file_name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0666);
+  if (-1 == fd) {
+    return false;
+  }
+  size_t size = sizeof(be_ring_t) + RING_DEPTH * stride;
+  void * addr = MAP_FAILED;
+  if (0 == ftruncate(fd, size)) {
+    addr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  }
+  close(fd);
+  if (MAP_FAILED == addr) {
+    shm_unlink(file_name.c_str());
+    return false;
+  }
+  be_ring_t * ring = reinterpret_cast<be_ring_t *>(addr);
+  ring->len = RING_DEPTH;
+  ring->msg_size = MSG_SIZE;
+  ring->stride = stride;
+  __atomic_store_n(&ring->magic, BE_MAGIC, __ATOMIC_RELEASE);
+  munmap(addr, size);
+  return true;
+}
+
+struct Result
+{
+  double ns_per_msg;
+  uint64_t taken;
+  uint64_t lost;
+};
+
+// One publisher against the given number of readers polling the ring, each on its own thread
+static bool
+contend(const std::string & topic_name, int readers, uint64_t messages, Result * result)
+{
+  be_endpoint_t pub;
+  be_endpoint_t subs[MAX_READERS];
+  if (RMW_RET_OK != hazcat_be_attach(&pub, topic_name.c_str(), MSG_SIZE, RING_DEPTH, false)) {
+    return false;
+  }
+  for (int i = 0; i < readers; i++) {
+    if (RMW_RET_OK !=
+      hazcat_be_attach(&subs[i], topic_name.c_str(), MSG_SIZE, RING_DEPTH, false))
+    {
+      while (i-- > 0) {
+        hazcat_be_detach(&subs[i]);
+      }
+      hazcat_be_detach(&pub);
+      return false;
+    }
+  }
+
+  std::atomic<bool> done(false);
+  std::atomic<int> started(0);
+  std::atomic<uint64_t> taken(0);
+  std::vector<std::thread> threads;
+  for (int i = 0; i < readers; i++) {
+    threads.emplace_back(
+      [&, i]() {
+        uint64_t header;
+        uint8_t msg[MSG_SIZE];
+        uint64_t count = 0;
+        started++;
+        while (!done.load(std::memory_order_relaxed)) {
+          count += hazcat_be_take(&subs[i], &header, sizeof(header), msg, sizeof(msg));
+        }
+        while (hazcat_be_take(&subs[i], &header, sizeof(header), msg, sizeof(msg))) {
+          count++;
+        }
+        taken += count;
+      });
+  }
+  while (readers != started.load()) {
+    std::this_thread::yield();
+  }
+
+  uint8_t msg[MSG_SIZE - sizeof(uint64_t)] = {0};
+  auto start = std::chrono::steady_clock::now();
+  for (uint64_t i = 0; i < messages; i++) {
+    hazcat_be_publish(&pub, &i, sizeof(i), msg, sizeof(msg));
+  }
+  auto end = std::chrono::steady_clock::now();
+  done = true;
+  for (auto & thread : threads) {
+    thread.join();
+  }
+
+  result->ns_per_msg = std::chrono::duration<double, std::nano>(end - start).count() / messages;
+  result->taken = taken;
+  result->lost = 0;
+  for (int i = 0; i < readers; i++) {
+    result->lost += subs[i].lost;
+    hazcat_be_detach(&subs[i]);
+  }
+  hazcat_be_detach(&pub);
+  return true;
+}
+
+// Median of RUNS runs, by publish time
+static bool
+measure(const char * layout, int readers, uint64_t messages, Result * median)
+{
+  std::vector<Result> results;
+  for (int run = 0; run < RUNS; run++) {
+    std::string topic_name = "/layout_bench_" + std::to_string(getpid()) + "_" + layout;
+    if (std::string("packed") == layout) {
+      uint32_t stride = (sizeof(be_slot_t) + MSG_SIZE + 7) & ~7u;
+      if (!create_ring(topic_name, stride)) {
+        return false;
+      }
+    }
+    Result result;
+    if (!contend(topic_name, readers, messages, &result)) {
+      shm_unlink(ring_file_name(topic_name).c_str());
+      return false;
+    }
+    results.push_back(result);
+  }
+  std::sort(
+    results.begin(), results.end(),
+    [](const Result & a, const Result & b) {return a.ns_per_msg < b.ns_per_msg;});
+  *median = results[results.size() / 2];
+  return true;
+}
+
+int
+main(int argc, char ** argv)
+{
+  uint64_t messages = (argc > 1) ? strtoull(argv[1], NULL, 10) : MESSAGES;
+  if (0 == messages) {
+    fprintf(stderr, "usage: %s [messages]\n", argv[0]);
+    return 1;
+  }
+
+  printf("%llu messages of %d bytes, ring of %d slots, median of %d runs\n",
+    (unsigned long long)messages, MSG_SIZE, RING_DEPTH, RUNS);
+  printf("readers  layout  ns/msg   taken/reader  lost/reader\n");
+  for (int readers = 1; readers <= MAX_READERS; readers *= 2) {
+    for (const char * layout : {"packed", "padded"}) {
+      Result result;
+      if (!measure(layout, readers, messages, &result)) {
+        fprintf(stderr, "unable to set up a %s ring\n", layout);
+        return 1;
+      }
+      printf("%7d  %-6s  %6.1f  %12llu  %11llu\n", readers, layout, result.ns_per_msg,
+        (unsigned long long)(result.taken / readers), (unsigned long long)(result.lost / readers));
+    }
+  }
+  return 0;
+}
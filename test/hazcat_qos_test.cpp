@@ -0,0 +1,632 @@
+// Copyright 2022 Washington University in St Louis
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+
+#include "osrf_testing_tools_cpp/scope_exit.hpp"
+
+#include "rcutils/allocator.h"
+#include "rcutils/strdup.h"
+
+#include "rmw/error_handling.h"
+#include "rmw/event.h"
+#include "rmw/rmw.h"
+
+#include "test_msgs/msg/basic_types.h"
+
+class TestQos : public ::testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    rmw_init_options_t options = rmw_get_zero_initialized_init_options();
+    rmw_ret_t ret = rmw_init_options_init(&options, rcutils_get_default_allocator());
+    ASSERT_EQ(RMW_RET_OK, ret) << rcutils_get_error_string().str;
+    OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+    {
+      rmw_ret_t ret = rmw_init_options_fini(&options);
+      EXPECT_EQ(RMW_RET_OK, ret) << rmw_get_error_string().str;
+    });
+    options.enclave = rcutils_strdup("/", rcutils_get_default_allocator());
+    ASSERT_STREQ("/", options.enclave);
+    context = rmw_get_zero_initialized_context();
+    ret = rmw_init(&options, &context);
+    ASSERT_EQ(RMW_RET_OK, ret) << rcutils_get_error_string().str;
+    node = rmw_create_node(&context, "qos_test_node", "/qos_test", 1, true);
+    ASSERT_NE(nullptr, node) << rcutils_get_error_string().str;
+  }
+
+  void TearDown() override
+  {
+    rmw_ret_t ret = rmw_destroy_node(node);
+    EXPECT_EQ(RMW_RET_OK, ret) << rcutils_get_error_string().str;
+    ret = rmw_shutdown(&context);
+    EXPECT_EQ(RMW_RET_OK, ret) << rcutils_get_error_string().str;
+    ret = rmw_context_fini(&context);
+    EXPECT_EQ(RMW_RET_OK, ret) << rcutils_get_error_string().str;
+  }
+
+  const rosidl_message_type_support_t * ts =
+    ROSIDL_GET_MSG_TYPE_SUPPORT(test_msgs, msg, BasicTypes);
+  rmw_publisher_options_t pub_options = rmw_get_default_publisher_options();
+  rmw_subscription_options_t sub_options = rmw_get_default_subscription_options();
+  rmw_context_t context;
+  rmw_node_t * node;
+};
+
+TEST_F(TestQos, keep_all_backpressure) {
+  rmw_qos_profile_t qos = rmw_qos_profile_default;
+  qos.history = RMW_QOS_POLICY_HISTORY_KEEP_ALL;
+  qos.depth = 2;
+  rmw_publisher_t * pub = rmw_create_publisher(node, ts, "/keep_all", &qos, &pub_options);
+  ASSERT_NE(nullptr, pub) << rcutils_get_error_string().str;
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    EXPECT_EQ(RMW_RET_OK, rmw_destroy_publisher(node, pub)) << rcutils_get_error_string().str;
+  });
+  rmw_subscription_t * sub = rmw_create_subscription(node, ts, "/keep_all", &qos, &sub_options);
+  ASSERT_NE(nullptr, sub) << rcutils_get_error_string().str;
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    EXPECT_EQ(RMW_RET_OK, rmw_destroy_subscription(node, sub)) << rcutils_get_error_string().str;
+  });
+
+  rmw_qos_profile_t actual;
+  ASSERT_EQ(RMW_RET_OK, rmw_publisher_get_actual_qos(pub, &actual));
+  EXPECT_EQ(RMW_QOS_POLICY_HISTORY_KEEP_ALL, actual.history);
+
+  // Fill the queue, then the next publish has nowhere to go until the subscription catches up
+  test_msgs__msg__BasicTypes msg;
+  memset(&msg, 0, sizeof(msg));
+  for (int i = 0; i < 2; i++) {
+    msg.int64_value = i;
+    ASSERT_EQ(RMW_RET_OK, rmw_publish(pub, &msg, nullptr)) << rcutils_get_error_string().str;
+  }
+  EXPECT_EQ(RMW_RET_TIMEOUT, rmw_publish(pub, &msg, nullptr));
+  rmw_reset_error();
+
+  bool taken = false;
+  for (int i = 0; i < 2; i++) {
+    ASSERT_EQ(RMW_RET_OK, rmw_take(sub, &msg, &taken, nullptr));
+    EXPECT_TRUE(taken);
+  }
+  EXPECT_EQ(RMW_RET_OK, rmw_publish(pub, &msg, nullptr)) << rcutils_get_error_string().str;
+}
+
+// Every subscription reads its own reference to each message, so one taking it doesn't free it
+// from under the others
+TEST_F(TestQos, shared_by_subscriptions) {
+  rmw_qos_profile_t qos = rmw_qos_profile_default;
+  qos.depth = 4;
+  rmw_publisher_t * pub = rmw_create_publisher(node, ts, "/shared", &qos, &pub_options);
+  ASSERT_NE(nullptr, pub) << rcutils_get_error_string().str;
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    EXPECT_EQ(RMW_RET_OK, rmw_destroy_publisher(node, pub)) << rcutils_get_error_string().str;
+  });
+  rmw_subscription_t * first = rmw_create_subscription(node, ts, "/shared", &qos, &sub_options);
+  ASSERT_NE(nullptr, first) << rcutils_get_error_string().str;
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    EXPECT_EQ(RMW_RET_OK, rmw_destroy_subscription(node, first)) <<
+      rcutils_get_error_string().str;
+  });
+  rmw_subscription_t * second = rmw_create_subscription(node, ts, "/shared", &qos, &sub_options);
+  ASSERT_NE(nullptr, second) << rcutils_get_error_string().str;
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    EXPECT_EQ(RMW_RET_OK, rmw_destroy_subscription(node, second)) <<
+      rcutils_get_error_string().str;
+  });
+
+  // The first subscription keeps up, so anything it frees early is reused by the next publish
+  // before the second gets to read it
+  test_msgs__msg__BasicTypes msg;
+  memset(&msg, 0, sizeof(msg));
+  bool taken = false;
+  for (int round = 0; round < 20; round++) {
+    for (int i = 0; i < 2; i++) {
+      msg.int64_value = 2 * round + i;
+      ASSERT_EQ(RMW_RET_OK, rmw_publish(pub, &msg, nullptr)) << rcutils_get_error_string().str;
+      ASSERT_EQ(RMW_RET_OK, rmw_take(first, &msg, &taken, nullptr));
+      ASSERT_TRUE(taken);
+      EXPECT_EQ(2 * round + i, msg.int64_value);
+    }
+    for (int i = 0; i < 2; i++) {
+      ASSERT_EQ(RMW_RET_OK, rmw_take(second, &msg, &taken, nullptr));
+      ASSERT_TRUE(taken);
+      EXPECT_EQ(2 * round + i, msg.int64_value);
+    }
+  }
+
+  // Messages neither subscription takes are released when the queue laps them
+  for (int i = 0; i < 100; i++) {
+    ASSERT_EQ(RMW_RET_OK, rmw_publish(pub, &msg, nullptr)) << rcutils_get_error_string().str;
+  }
+}
+
+TEST_F(TestQos, transient_local_late_joiner) {
+  rmw_qos_profile_t qos = rmw_qos_profile_default;
+  qos.durability = RMW_QOS_POLICY_DURABILITY_TRANSIENT_LOCAL;
+  qos.depth = 2;
+  rmw_publisher_t * pub = rmw_create_publisher(node, ts, "/latched", &qos, &pub_options);
+  ASSERT_NE(nullptr, pub) << rcutils_get_error_string().str;
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    EXPECT_EQ(RMW_RET_OK, rmw_destroy_publisher(node, pub)) << rcutils_get_error_string().str;
+  });
+
+  rmw_qos_profile_t actual;
+  ASSERT_EQ(RMW_RET_OK, rmw_publisher_get_actual_qos(pub, &actual));
+  EXPECT_EQ(RMW_QOS_POLICY_DURABILITY_TRANSIENT_LOCAL, actual.durability);
+  size_t count = 1;
+  ASSERT_EQ(RMW_RET_OK, rmw_publisher_count_matched_subscriptions(pub, &count));
+  EXPECT_EQ(0u, count);
+
+  // Only the last depth messages are kept
+  test_msgs__msg__BasicTypes msg;
+  memset(&msg, 0, sizeof(msg));
+  for (int i = 0; i < 3; i++) {
+    msg.int64_value = i;
+    ASSERT_EQ(RMW_RET_OK, rmw_publish(pub, &msg, nullptr)) << rcutils_get_error_string().str;
+  }
+
+  rmw_subscription_t * late = rmw_create_subscription(node, ts, "/latched", &qos, &sub_options);
+  ASSERT_NE(nullptr, late) << rcutils_get_error_string().str;
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    EXPECT_EQ(RMW_RET_OK, rmw_destroy_subscription(node, late)) << rcutils_get_error_string().str;
+  });
+  rmw_qos_profile_t volatile_qos = qos;
+  volatile_qos.durability = RMW_QOS_POLICY_DURABILITY_VOLATILE;
+  rmw_subscription_t * sub =
+    rmw_create_subscription(node, ts, "/latched", &volatile_qos, &sub_options);
+  ASSERT_NE(nullptr, sub) << rcutils_get_error_string().str;
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    EXPECT_EQ(RMW_RET_OK, rmw_destroy_subscription(node, sub)) << rcutils_get_error_string().str;
+  });
+
+  bool taken = false;
+  for (int i = 1; i < 3; i++) {
+    ASSERT_EQ(RMW_RET_OK, rmw_take(late, &msg, &taken, nullptr));
+    ASSERT_TRUE(taken);
+    EXPECT_EQ(i, msg.int64_value);
+  }
+  ASSERT_EQ(RMW_RET_OK, rmw_take(late, &msg, &taken, nullptr));
+  EXPECT_FALSE(taken);
+  ASSERT_EQ(RMW_RET_OK, rmw_take(sub, &msg, &taken, nullptr));
+  EXPECT_FALSE(taken);
+
+  // The replayed messages held their own references, so lapping them after the late joiner let
+  // go of them releases each block once, and later messages don't land in a block still in use
+  for (int i = 3; i < 9; i++) {
+    msg.int64_value = i;
+    ASSERT_EQ(RMW_RET_OK, rmw_publish(pub, &msg, nullptr)) << rcutils_get_error_string().str;
+    ASSERT_EQ(RMW_RET_OK, rmw_take(late, &msg, &taken, nullptr));
+    ASSERT_TRUE(taken);
+    EXPECT_EQ(i, msg.int64_value);
+  }
+}
+
+TEST_F(TestQos, best_effort_overwrites) {
+  rmw_qos_profile_t qos = rmw_qos_profile_sensor_data;
+  qos.depth = 2;
+  rmw_publisher_t * pub = rmw_create_publisher(node, ts, "/best_effort", &qos, &pub_options);
+  ASSERT_NE(nullptr, pub) << rcutils_get_error_string().str;
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    EXPECT_EQ(RMW_RET_OK, rmw_destroy_publisher(node, pub)) << rcutils_get_error_string().str;
+  });
+  rmw_subscription_t * sub = rmw_create_subscription(node, ts, "/best_effort", &qos, &sub_options);
+  ASSERT_NE(nullptr, sub) << rcutils_get_error_string().str;
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    EXPECT_EQ(RMW_RET_OK, rmw_destroy_subscription(node, sub)) << rcutils_get_error_string().str;
+  });
+  rmw_qos_profile_t reliable_qos = rmw_qos_profile_default;
+  rmw_publisher_t * reliable =
+    rmw_create_publisher(node, ts, "/best_effort", &reliable_qos, &pub_options);
+  ASSERT_NE(nullptr, reliable) << rcutils_get_error_string().str;
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    EXPECT_EQ(RMW_RET_OK, rmw_destroy_publisher(node, reliable)) <<
+      rcutils_get_error_string().str;
+  });
+
+  rmw_qos_profile_t actual;
+  ASSERT_EQ(RMW_RET_OK, rmw_subscription_get_actual_qos(sub, &actual));
+  EXPECT_EQ(RMW_QOS_POLICY_RELIABILITY_BEST_EFFORT, actual.reliability);
+  EXPECT_FALSE(sub->can_loan_messages);
+
+  // Publisher never waits on the subscription, which only sees the latest depth messages
+  test_msgs__msg__BasicTypes msg;
+  memset(&msg, 0, sizeof(msg));
+  for (int i = 0; i < 5; i++) {
+    msg.int64_value = i;
+    ASSERT_EQ(RMW_RET_OK, rmw_publish(pub, &msg, nullptr)) << rcutils_get_error_string().str;
+  }
+
+  rmw_wait_set_t * ws = rmw_create_wait_set(&context, 1);
+  ASSERT_NE(nullptr, ws) << rcutils_get_error_string().str;
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    EXPECT_EQ(RMW_RET_OK, rmw_destroy_wait_set(ws)) << rcutils_get_error_string().str;
+  });
+  void * storage[1] = {sub->data};
+  rmw_subscriptions_t subscriptions = {1, storage};
+  rmw_time_t timeout = {1, 0};
+  ASSERT_EQ(RMW_RET_OK, rmw_wait(&subscriptions, nullptr, nullptr, nullptr, nullptr, ws, &timeout));
+  EXPECT_NE(nullptr, subscriptions.subscribers[0]);
+
+  bool taken = false;
+  for (int i = 3; i < 5; i++) {
+    ASSERT_EQ(RMW_RET_OK, rmw_take(sub, &msg, &taken, nullptr));
+    ASSERT_TRUE(taken);
+    EXPECT_EQ(i, msg.int64_value);
+  }
+
+  // Reliable publishers reach best effort subscriptions too
+  msg.int64_value = 42;
+  ASSERT_EQ(RMW_RET_OK, rmw_publish(reliable, &msg, nullptr)) << rcutils_get_error_string().str;
+  ASSERT_EQ(RMW_RET_OK, rmw_take(sub, &msg, &taken, nullptr));
+  ASSERT_TRUE(taken);
+  EXPECT_EQ(42, msg.int64_value);
+  ASSERT_EQ(RMW_RET_OK, rmw_take(sub, &msg, &taken, nullptr));
+  EXPECT_FALSE(taken);
+}
+
+TEST_F(TestQos, lifespan_expires) {
+  rmw_qos_profile_t qos = rmw_qos_profile_default;
+  qos.lifespan = {0, 50000000};
+  rmw_publisher_t * pub = rmw_create_publisher(node, ts, "/lifespan", &qos, &pub_options);
+  ASSERT_NE(nullptr, pub) << rcutils_get_error_string().str;
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    EXPECT_EQ(RMW_RET_OK, rmw_destroy_publisher(node, pub)) << rcutils_get_error_string().str;
+  });
+  rmw_subscription_t * sub = rmw_create_subscription(node, ts, "/lifespan", &qos, &sub_options);
+  ASSERT_NE(nullptr, sub) << rcutils_get_error_string().str;
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    EXPECT_EQ(RMW_RET_OK, rmw_destroy_subscription(node, sub)) << rcutils_get_error_string().str;
+  });
+
+  rmw_qos_profile_t actual;
+  ASSERT_EQ(RMW_RET_OK, rmw_publisher_get_actual_qos(pub, &actual));
+  EXPECT_EQ(50000000u, actual.lifespan.nsec);
+
+  // First message outlives its lifespan before it's taken, the second doesn't
+  test_msgs__msg__BasicTypes msg;
+  memset(&msg, 0, sizeof(msg));
+  ASSERT_EQ(RMW_RET_OK, rmw_publish(pub, &msg, nullptr)) << rcutils_get_error_string().str;
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  msg.int64_value = 1;
+  ASSERT_EQ(RMW_RET_OK, rmw_publish(pub, &msg, nullptr)) << rcutils_get_error_string().str;
+
+  bool taken = false;
+  rmw_message_info_t info = rmw_get_zero_initialized_message_info();
+  ASSERT_EQ(RMW_RET_OK, rmw_take_with_info(sub, &msg, &taken, &info, nullptr));
+  ASSERT_TRUE(taken);
+  EXPECT_EQ(1, msg.int64_value);
+  EXPECT_EQ(2u, info.publication_sequence_number);
+  EXPECT_NE(0, info.source_timestamp);
+  ASSERT_EQ(RMW_RET_OK, rmw_take(sub, &msg, &taken, nullptr));
+  EXPECT_FALSE(taken);
+}
+
+TEST_F(TestQos, deadline_missed) {
+  rmw_qos_profile_t qos = rmw_qos_profile_default;
+  qos.deadline = {0, 20000000};
+  rmw_subscription_t * sub = rmw_create_subscription(node, ts, "/deadline", &qos, &sub_options);
+  ASSERT_NE(nullptr, sub) << rcutils_get_error_string().str;
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    EXPECT_EQ(RMW_RET_OK, rmw_destroy_subscription(node, sub)) << rcutils_get_error_string().str;
+  });
+  rmw_event_t event = rmw_get_zero_initialized_event();
+  ASSERT_EQ(
+    RMW_RET_OK, rmw_subscription_event_init(&event, sub, RMW_EVENT_REQUESTED_DEADLINE_MISSED));
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+  rmw_wait_set_t * ws = rmw_create_wait_set(&context, 1);
+  ASSERT_NE(nullptr, ws) << rcutils_get_error_string().str;
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    EXPECT_EQ(RMW_RET_OK, rmw_destroy_wait_set(ws)) << rcutils_get_error_string().str;
+  });
+  void * storage[1] = {&event};
+  rmw_events_t events = {1, storage};
+  rmw_time_t timeout = {0, 0};
+  ASSERT_EQ(RMW_RET_OK, rmw_wait(nullptr, nullptr, nullptr, nullptr, &events, ws, &timeout));
+  EXPECT_NE(nullptr, events.events[0]);
+
+  rmw_requested_deadline_missed_status_t status;
+  bool taken = false;
+  ASSERT_EQ(RMW_RET_OK, rmw_take_event(&event, &status, &taken));
+  ASSERT_TRUE(taken);
+  EXPECT_GE(status.total_count, 2);
+  EXPECT_EQ(status.total_count, status.total_count_change);
+}
+
+TEST_F(TestQos, message_lost) {
+  rmw_qos_profile_t qos = rmw_qos_profile_default;
+  qos.depth = 2;
+  rmw_publisher_t * pub = rmw_create_publisher(node, ts, "/lost", &qos, &pub_options);
+  ASSERT_NE(nullptr, pub) << rcutils_get_error_string().str;
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    EXPECT_EQ(RMW_RET_OK, rmw_destroy_publisher(node, pub)) << rcutils_get_error_string().str;
+  });
+  rmw_subscription_t * sub = rmw_create_subscription(node, ts, "/lost", &qos, &sub_options);
+  ASSERT_NE(nullptr, sub) << rcutils_get_error_string().str;
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    EXPECT_EQ(RMW_RET_OK, rmw_destroy_subscription(node, sub)) << rcutils_get_error_string().str;
+  });
+  rmw_event_t event = rmw_get_zero_initialized_event();
+  ASSERT_EQ(RMW_RET_OK, rmw_subscription_event_init(&event, sub, RMW_EVENT_MESSAGE_LOST));
+
+  test_msgs__msg__BasicTypes msg;
+  memset(&msg, 0, sizeof(msg));
+  bool taken = false;
+  ASSERT_EQ(RMW_RET_OK, rmw_publish(pub, &msg, nullptr)) << rcutils_get_error_string().str;
+  ASSERT_EQ(RMW_RET_OK, rmw_take(sub, &msg, &taken, nullptr));
+  ASSERT_TRUE(taken);
+
+  // Lap the subscription, so the oldest of these are overwritten before it reads them
+  for (int i = 0; i < 8; i++) {
+    ASSERT_EQ(RMW_RET_OK, rmw_publish(pub, &msg, nullptr)) << rcutils_get_error_string().str;
+  }
+
+  rmw_wait_set_t * ws = rmw_create_wait_set(&context, 1);
+  ASSERT_NE(nullptr, ws) << rcutils_get_error_string().str;
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    EXPECT_EQ(RMW_RET_OK, rmw_destroy_wait_set(ws)) << rcutils_get_error_string().str;
+  });
+  void * storage[1] = {&event};
+  rmw_events_t events = {1, storage};
+  rmw_time_t timeout = {1, 0};
+  ASSERT_EQ(RMW_RET_OK, rmw_wait(nullptr, nullptr, nullptr, nullptr, &events, ws, &timeout));
+  EXPECT_NE(nullptr, events.events[0]);
+
+  rmw_message_lost_status_t status;
+  ASSERT_EQ(RMW_RET_OK, rmw_take_event(&event, &status, &taken));
+  ASSERT_TRUE(taken);
+  EXPECT_GT(status.total_count, 0u);
+  EXPECT_EQ(status.total_count, status.total_count_change);
+  ASSERT_EQ(RMW_RET_OK, rmw_take_event(&event, &status, &taken));
+  EXPECT_EQ(0u, status.total_count_change);
+}
+
+// Losses are counted per publisher, so messages from two publishers interleaved in the queue
+// aren't taken for gaps, and each missed message is counted once
+TEST_F(TestQos, message_lost_two_publishers) {
+  rmw_qos_profile_t qos = rmw_qos_profile_default;
+  qos.depth = 2;
+  rmw_publisher_t * pubs[2];
+  for (auto & pub : pubs) {
+    pub = rmw_create_publisher(node, ts, "/lost_two", &qos, &pub_options);
+    ASSERT_NE(nullptr, pub) << rcutils_get_error_string().str;
+  }
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    for (auto & pub : pubs) {
+      EXPECT_EQ(RMW_RET_OK, rmw_destroy_publisher(node, pub)) << rcutils_get_error_string().str;
+    }
+  });
+  rmw_subscription_t * sub = rmw_create_subscription(node, ts, "/lost_two", &qos, &sub_options);
+  ASSERT_NE(nullptr, sub) << rcutils_get_error_string().str;
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    EXPECT_EQ(RMW_RET_OK, rmw_destroy_subscription(node, sub)) << rcutils_get_error_string().str;
+  });
+  rmw_event_t event = rmw_get_zero_initialized_event();
+  ASSERT_EQ(RMW_RET_OK, rmw_subscription_event_init(&event, sub, RMW_EVENT_MESSAGE_LOST));
+
+  test_msgs__msg__BasicTypes msg;
+  memset(&msg, 0, sizeof(msg));
+  bool taken = false;
+  for (int i = 0; i < 4; i++) {
+    ASSERT_EQ(RMW_RET_OK, rmw_publish(pubs[i % 2], &msg, nullptr));
+    ASSERT_EQ(RMW_RET_OK, rmw_take(sub, &msg, &taken, nullptr));
+    ASSERT_TRUE(taken);
+  }
+  rmw_message_lost_status_t status;
+  ASSERT_EQ(RMW_RET_OK, rmw_take_event(&event, &status, &taken));
+  EXPECT_EQ(0u, status.total_count);
+
+  // Lap the subscription, then take whatever is left. Everything else was lost
+  const uint64_t published = 16;
+  for (uint64_t i = 0; i < published; i++) {
+    ASSERT_EQ(RMW_RET_OK, rmw_publish(pubs[i % 2], &msg, nullptr));
+  }
+  uint64_t count = 0;
+  do {
+    ASSERT_EQ(RMW_RET_OK, rmw_take(sub, &msg, &taken, nullptr));
+    count += taken;
+  } while (taken);
+  ASSERT_GE(count, 2u);
+  ASSERT_EQ(RMW_RET_OK, rmw_take_event(&event, &status, &taken));
+  EXPECT_EQ(published - count, status.total_count);
+  EXPECT_EQ(status.total_count, status.total_count_change);
+  ASSERT_EQ(RMW_RET_OK, rmw_take_event(&event, &status, &taken));
+  EXPECT_EQ(0u, status.total_count_change);
+}
+
+TEST_F(TestQos, incompatible_qos) {
+  rmw_qos_profile_t qos = rmw_qos_profile_default;
+  rmw_subscription_t * sub = rmw_create_subscription(node, ts, "/incompatible", &qos, &sub_options);
+  ASSERT_NE(nullptr, sub) << rcutils_get_error_string().str;
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    EXPECT_EQ(RMW_RET_OK, rmw_destroy_subscription(node, sub)) << rcutils_get_error_string().str;
+  });
+  rmw_event_t event = rmw_get_zero_initialized_event();
+  ASSERT_EQ(
+    RMW_RET_OK, rmw_subscription_event_init(&event, sub, RMW_EVENT_REQUESTED_QOS_INCOMPATIBLE));
+
+  // Reliable subscriptions never see messages from best effort publishers
+  rmw_qos_profile_t best_effort = rmw_qos_profile_sensor_data;
+  rmw_publisher_t * pub =
+    rmw_create_publisher(node, ts, "/incompatible", &best_effort, &pub_options);
+  ASSERT_NE(nullptr, pub) << rcutils_get_error_string().str;
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    EXPECT_EQ(RMW_RET_OK, rmw_destroy_publisher(node, pub)) << rcutils_get_error_string().str;
+  });
+
+  rmw_requested_qos_incompatible_event_status_t status;
+  bool taken = false;
+  ASSERT_EQ(RMW_RET_OK, rmw_take_event(&event, &status, &taken));
+  ASSERT_TRUE(taken);
+  EXPECT_EQ(1, status.total_count);
+  EXPECT_EQ(1, status.total_count_change);
+  EXPECT_EQ(RMW_QOS_POLICY_RELIABILITY, status.last_policy_kind);
+}
+
+TEST_F(TestQos, wait_for_all_acked) {
+  rmw_qos_profile_t qos = rmw_qos_profile_default;
+  rmw_publisher_t * pub = rmw_create_publisher(node, ts, "/acked", &qos, &pub_options);
+  ASSERT_NE(nullptr, pub) << rcutils_get_error_string().str;
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    EXPECT_EQ(RMW_RET_OK, rmw_destroy_publisher(node, pub)) << rcutils_get_error_string().str;
+  });
+  rmw_subscription_t * sub = rmw_create_subscription(node, ts, "/acked", &qos, &sub_options);
+  ASSERT_NE(nullptr, sub) << rcutils_get_error_string().str;
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    EXPECT_EQ(RMW_RET_OK, rmw_destroy_subscription(node, sub)) << rcutils_get_error_string().str;
+  });
+
+  test_msgs__msg__BasicTypes msg;
+  memset(&msg, 0, sizeof(msg));
+  ASSERT_EQ(RMW_RET_OK, rmw_publish(pub, &msg, nullptr)) << rcutils_get_error_string().str;
+  EXPECT_EQ(RMW_RET_TIMEOUT, rmw_publisher_wait_for_all_acked(pub, {0, 10000000}));
+
+  // Woken as soon as the subscription takes the message
+  std::thread taker([&]() {
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+      bool taken = false;
+      EXPECT_EQ(RMW_RET_OK, rmw_take(sub, &msg, &taken, nullptr));
+      EXPECT_TRUE(taken);
+    });
+  EXPECT_EQ(RMW_RET_OK, rmw_publisher_wait_for_all_acked(pub, {1, 0}));
+  taker.join();
+
+  // Publishers of a topic share an allocator, but only wait on their own messages
+  rmw_publisher_t * other = rmw_create_publisher(node, ts, "/acked", &qos, &pub_options);
+  ASSERT_NE(nullptr, other) << rcutils_get_error_string().str;
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    EXPECT_EQ(RMW_RET_OK, rmw_destroy_publisher(node, other)) << rcutils_get_error_string().str;
+  });
+  ASSERT_EQ(RMW_RET_OK, rmw_publish(other, &msg, nullptr)) << rcutils_get_error_string().str;
+  EXPECT_EQ(RMW_RET_OK, rmw_publisher_wait_for_all_acked(pub, {0, 10000000}));
+  EXPECT_EQ(RMW_RET_TIMEOUT, rmw_publisher_wait_for_all_acked(other, {0, 10000000}));
+}
+
+TEST_F(TestQos, content_filter) {
+  rcutils_allocator_t allocator = rcutils_get_default_allocator();
+  rmw_subscription_content_filter_options_t filter =
+    rmw_get_zero_initialized_content_filter_options();
+  const char * params[] = {"2"};
+  ASSERT_EQ(
+    RMW_RET_OK, rmw_subscription_content_filter_options_init(
+      "int64_value > %0 AND NOT bool_value = TRUE", 1, params, &allocator, &filter));
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    EXPECT_EQ(RMW_RET_OK, rmw_subscription_content_filter_options_fini(&filter, &allocator));
+  });
+  sub_options.content_filter_options = &filter;
+
+  rmw_qos_profile_t qos = rmw_qos_profile_default;
+  qos.depth = 8;
+  rmw_publisher_t * pub = rmw_create_publisher(node, ts, "/filtered", &qos, &pub_options);
+  ASSERT_NE(nullptr, pub) << rcutils_get_error_string().str;
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    EXPECT_EQ(RMW_RET_OK, rmw_destroy_publisher(node, pub)) << rcutils_get_error_string().str;
+  });
+  rmw_subscription_t * sub = rmw_create_subscription(node, ts, "/filtered", &qos, &sub_options);
+  ASSERT_NE(nullptr, sub) << rcutils_get_error_string().str;
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    EXPECT_EQ(RMW_RET_OK, rmw_destroy_subscription(node, sub)) << rcutils_get_error_string().str;
+  });
+  EXPECT_TRUE(sub->is_cft_enabled);
+
+  test_msgs__msg__BasicTypes msg;
+  memset(&msg, 0, sizeof(msg));
+  for (int i = 0; i < 6; i++) {
+    msg.int64_value = i;
+    msg.bool_value = (4 == i);
+    ASSERT_EQ(RMW_RET_OK, rmw_publish(pub, &msg, nullptr)) << rcutils_get_error_string().str;
+  }
+
+  // Only 3 and 5 pass, the rest are released without ever being copied out
+  bool taken = false;
+  ASSERT_EQ(RMW_RET_OK, rmw_take(sub, &msg, &taken, nullptr));
+  ASSERT_TRUE(taken);
+  EXPECT_EQ(3, msg.int64_value);
+  ASSERT_EQ(RMW_RET_OK, rmw_take(sub, &msg, &taken, nullptr));
+  ASSERT_TRUE(taken);
+  EXPECT_EQ(5, msg.int64_value);
+  ASSERT_EQ(RMW_RET_OK, rmw_take(sub, &msg, &taken, nullptr));
+  EXPECT_FALSE(taken);
+
+  rmw_subscription_content_filter_options_t current =
+    rmw_get_zero_initialized_content_filter_options();
+  ASSERT_EQ(RMW_RET_OK, rmw_subscription_get_content_filter(sub, &allocator, &current));
+  EXPECT_STREQ("int64_value > %0 AND NOT bool_value = TRUE", current.filter_expression);
+  ASSERT_EQ(1u, current.expression_parameters.size);
+  EXPECT_STREQ("2", current.expression_parameters.data[0]);
+  EXPECT_EQ(RMW_RET_OK, rmw_subscription_content_filter_options_fini(&current, &allocator));
+
+  // Bad expressions leave the filter as it was
+  rmw_subscription_content_filter_options_t bad =
+    rmw_get_zero_initialized_content_filter_options();
+  ASSERT_EQ(
+    RMW_RET_OK, rmw_subscription_content_filter_options_init(
+      "no_such_field = 1", 0, nullptr, &allocator, &bad));
+  EXPECT_NE(RMW_RET_OK, rmw_subscription_set_content_filter(sub, &bad));
+  rmw_reset_error();
+  EXPECT_TRUE(sub->is_cft_enabled);
+  EXPECT_EQ(RMW_RET_OK, rmw_subscription_content_filter_options_fini(&bad, &allocator));
+
+  // An empty expression takes everything again
+  rmw_subscription_content_filter_options_t none =
+    rmw_get_zero_initialized_content_filter_options();
+  ASSERT_EQ(
+    RMW_RET_OK, rmw_subscription_content_filter_options_init(
+      "", 0, nullptr, &allocator, &none));
+  ASSERT_EQ(RMW_RET_OK, rmw_subscription_set_content_filter(sub, &none));
+  EXPECT_FALSE(sub->is_cft_enabled);
+  EXPECT_EQ(RMW_RET_OK, rmw_subscription_content_filter_options_fini(&none, &allocator));
+  EXPECT_NE(RMW_RET_OK, rmw_subscription_get_content_filter(sub, &allocator, &current));
+  rmw_reset_error();
+
+  msg.int64_value = 0;
+  ASSERT_EQ(RMW_RET_OK, rmw_publish(pub, &msg, nullptr)) << rcutils_get_error_string().str;
+  ASSERT_EQ(RMW_RET_OK, rmw_take(sub, &msg, &taken, nullptr));
+  EXPECT_TRUE(taken);
+}
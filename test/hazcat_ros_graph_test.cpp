@@ -0,0 +1,334 @@
+// Copyright 2022 Washington University in St Louis
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <thread>
+
+#include "osrf_testing_tools_cpp/scope_exit.hpp"
+
+#include "rcutils/allocator.h"
+#include "rcutils/strdup.h"
+
+#include "rmw/error_handling.h"
+#include "rmw/rmw.h"
+
+#include "test_msgs/msg/basic_types.h"
+
+#include "rmw_hazcat/hazcat_ros_graph.h"
+
+class TestRosGraph : public ::testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    rmw_init_options_t options = rmw_get_zero_initialized_init_options();
+    rmw_ret_t ret = rmw_init_options_init(&options, rcutils_get_default_allocator());
+    ASSERT_EQ(RMW_RET_OK, ret) << rcutils_get_error_string().str;
+    OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+    {
+      rmw_ret_t ret = rmw_init_options_fini(&options);
+      EXPECT_EQ(RMW_RET_OK, ret) << rmw_get_error_string().str;
+    });
+    options.enclave = rcutils_strdup("/", rcutils_get_default_allocator());
+    ASSERT_STREQ("/", options.enclave);
+    context = rmw_get_zero_initialized_context();
+    ret = rmw_init(&options, &context);
+    ASSERT_EQ(RMW_RET_OK, ret) << rcutils_get_error_string().str;
+    node = rmw_create_node(&context, "graph_test_node", "/graph_test", 1, true);
+    ASSERT_NE(nullptr, node) << rcutils_get_error_string().str;
+  }
+
+  void TearDown() override
+  {
+    rmw_ret_t ret = rmw_destroy_node(node);
+    EXPECT_EQ(RMW_RET_OK, ret) << rcutils_get_error_string().str;
+    ret = rmw_shutdown(&context);
+    EXPECT_EQ(RMW_RET_OK, ret) << rcutils_get_error_string().str;
+    ret = rmw_context_fini(&context);
+    EXPECT_EQ(RMW_RET_OK, ret) << rcutils_get_error_string().str;
+  }
+
+  rmw_context_t context;
+  rmw_node_t * node;
+};
+
+TEST_F(TestRosGraph, type_name) {
+  char type[GRAPH_NAME_LEN];
+  hazcat_graph_type_name("std_msgs__msg", "Int32", type, GRAPH_NAME_LEN);
+  EXPECT_STREQ("std_msgs/msg/Int32", type);
+  hazcat_graph_type_name("test_msgs::srv", "Empty", type, GRAPH_NAME_LEN);
+  EXPECT_STREQ("test_msgs/srv/Empty", type);
+  hazcat_graph_type_name("std_msgs__msg", "Int32", type, 8);
+  EXPECT_STREQ("std_msg", type);
+}
+
+TEST_F(TestRosGraph, node_names) {
+  rcutils_string_array_t names = rcutils_get_zero_initialized_string_array();
+  rcutils_string_array_t namespaces = rcutils_get_zero_initialized_string_array();
+  rcutils_string_array_t enclaves = rcutils_get_zero_initialized_string_array();
+  ASSERT_EQ(
+    RMW_RET_OK,
+    rmw_get_node_names_with_enclaves(node, &names, &namespaces, &enclaves)) <<
+    rcutils_get_error_string().str;
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    EXPECT_EQ(RCUTILS_RET_OK, rcutils_string_array_fini(&names));
+    EXPECT_EQ(RCUTILS_RET_OK, rcutils_string_array_fini(&namespaces));
+    EXPECT_EQ(RCUTILS_RET_OK, rcutils_string_array_fini(&enclaves));
+  });
+
+  // Other processes on the host may have nodes too, so only look for ours
+  bool found = false;
+  for (size_t i = 0; i < names.size; i++) {
+    if (std::string("graph_test_node") == names.data[i] &&
+      std::string("/graph_test") == namespaces.data[i])
+    {
+      EXPECT_STREQ("/", enclaves.data[i]);
+      found = true;
+    }
+  }
+  EXPECT_TRUE(found);
+}
+
+TEST_F(TestRosGraph, names_and_types_by_node) {
+  const rosidl_message_type_support_t * type_support =
+    ROSIDL_GET_MSG_TYPE_SUPPORT(test_msgs, msg, BasicTypes);
+  rmw_qos_profile_t qos = rmw_qos_profile_system_default;
+  qos.depth = 1;
+  rmw_publisher_options_t pub_opts = rmw_get_default_publisher_options();
+  rmw_subscription_options_t sub_opts = rmw_get_default_subscription_options();
+
+  // Two publishers on the same topic should only be reported once
+  rmw_publisher_t * pub1 = rmw_create_publisher(node, type_support, "/graph_a", &qos, &pub_opts);
+  ASSERT_NE(nullptr, pub1) << rcutils_get_error_string().str;
+  rmw_publisher_t * pub2 = rmw_create_publisher(node, type_support, "/graph_a", &qos, &pub_opts);
+  ASSERT_NE(nullptr, pub2) << rcutils_get_error_string().str;
+  rmw_subscription_t * sub =
+    rmw_create_subscription(node, type_support, "/graph_b", &qos, &sub_opts);
+  ASSERT_NE(nullptr, sub) << rcutils_get_error_string().str;
+
+  rcutils_allocator_t allocator = rcutils_get_default_allocator();
+  rmw_names_and_types_t nt = rmw_get_zero_initialized_names_and_types();
+  ASSERT_EQ(
+    RMW_RET_OK,
+    rmw_get_publisher_names_and_types_by_node(
+      node, &allocator, "graph_test_node", "/graph_test", false, &nt)) <<
+    rcutils_get_error_string().str;
+  ASSERT_EQ(1u, nt.names.size);
+  EXPECT_STREQ("/graph_a", nt.names.data[0]);
+  ASSERT_EQ(1u, nt.types[0].size);
+  EXPECT_STREQ("test_msgs/msg/BasicTypes", nt.types[0].data[0]);
+  EXPECT_EQ(RMW_RET_OK, rmw_names_and_types_fini(&nt));
+
+  ASSERT_EQ(
+    RMW_RET_OK,
+    rmw_get_subscriber_names_and_types_by_node(
+      node, &allocator, "graph_test_node", "/graph_test", false, &nt)) <<
+    rcutils_get_error_string().str;
+  ASSERT_EQ(1u, nt.names.size);
+  EXPECT_STREQ("/graph_b", nt.names.data[0]);
+  EXPECT_EQ(RMW_RET_OK, rmw_names_and_types_fini(&nt));
+
+  EXPECT_EQ(
+    RMW_RET_NODE_NAME_NON_EXISTENT,
+    rmw_get_publisher_names_and_types_by_node(
+      node, &allocator, "missing_node", "/graph_test", false, &nt));
+  rmw_reset_error();
+
+  // Destroyed endpoints disappear from the graph
+  EXPECT_EQ(RMW_RET_OK, rmw_destroy_publisher(node, pub1));
+  EXPECT_EQ(RMW_RET_OK, rmw_destroy_publisher(node, pub2));
+  EXPECT_EQ(RMW_RET_OK, rmw_destroy_subscription(node, sub));
+  ASSERT_EQ(
+    RMW_RET_OK,
+    rmw_get_publisher_names_and_types_by_node(
+      node, &allocator, "graph_test_node", "/graph_test", false, &nt));
+  EXPECT_EQ(0u, nt.names.size);
+  EXPECT_EQ(RMW_RET_OK, rmw_names_and_types_fini(&nt));
+}
+
+TEST_F(TestRosGraph, graph_guard_condition) {
+  const rosidl_message_type_support_t * type_support =
+    ROSIDL_GET_MSG_TYPE_SUPPORT(test_msgs, msg, BasicTypes);
+  rmw_qos_profile_t qos = rmw_qos_profile_system_default;
+  qos.depth = 1;
+  rmw_publisher_options_t pub_opts = rmw_get_default_publisher_options();
+
+  const rmw_guard_condition_t * graph_guard = rmw_node_get_graph_guard_condition(node);
+  ASSERT_NE(nullptr, graph_guard);
+  rmw_wait_set_t * ws = rmw_create_wait_set(&context, 1);
+  ASSERT_NE(nullptr, ws) << rcutils_get_error_string().str;
+
+  // Let the watcher thread deliver the notification for our own node's creation first
+  void * guards[1] = {graph_guard->data};
+  rmw_guard_conditions_t guard_conditions = {1, guards};
+  rmw_time_t timeout = {1, 0};
+  rmw_wait(nullptr, &guard_conditions, nullptr, nullptr, nullptr, ws, &timeout);
+
+  uint32_t epoch = hazcat_graph_epoch();
+  rmw_publisher_t * pub = rmw_create_publisher(node, type_support, "/graph_c", &qos, &pub_opts);
+  ASSERT_NE(nullptr, pub) << rcutils_get_error_string().str;
+  EXPECT_NE(epoch, hazcat_graph_epoch());
+
+  guards[0] = graph_guard->data;
+  EXPECT_EQ(
+    RMW_RET_OK,
+    rmw_wait(nullptr, &guard_conditions, nullptr, nullptr, nullptr, ws, &timeout));
+  EXPECT_NE(nullptr, guards[0]);
+
+  EXPECT_EQ(RMW_RET_OK, rmw_destroy_publisher(node, pub));
+  EXPECT_EQ(RMW_RET_OK, rmw_destroy_wait_set(ws));
+}
+
+TEST_F(TestRosGraph, endpoints_info) {
+  const rosidl_message_type_support_t * type_support =
+    ROSIDL_GET_MSG_TYPE_SUPPORT(test_msgs, msg, BasicTypes);
+  rmw_qos_profile_t qos = rmw_qos_profile_system_default;
+  qos.depth = 3;
+  rmw_publisher_options_t pub_opts = rmw_get_default_publisher_options();
+
+  rmw_publisher_t * pub = rmw_create_publisher(node, type_support, "/graph_d", &qos, &pub_opts);
+  ASSERT_NE(nullptr, pub) << rcutils_get_error_string().str;
+
+  rcutils_allocator_t allocator = rcutils_get_default_allocator();
+  rmw_topic_endpoint_info_array_t info = rmw_get_zero_initialized_topic_endpoint_info_array();
+  ASSERT_EQ(
+    RMW_RET_OK,
+    rmw_get_publishers_info_by_topic(node, &allocator, "/graph_d", false, &info)) <<
+    rcutils_get_error_string().str;
+  ASSERT_EQ(1u, info.size);
+  EXPECT_STREQ("graph_test_node", info.info_array[0].node_name);
+  EXPECT_STREQ("/graph_test", info.info_array[0].node_namespace);
+  EXPECT_STREQ("test_msgs/msg/BasicTypes", info.info_array[0].topic_type);
+  EXPECT_EQ(RMW_ENDPOINT_PUBLISHER, info.info_array[0].endpoint_type);
+  EXPECT_EQ(3u, info.info_array[0].qos_profile.depth);
+  rmw_gid_t gid;
+  ASSERT_EQ(RMW_RET_OK, rmw_get_gid_for_publisher(pub, &gid));
+  EXPECT_EQ(0, memcmp(gid.data, info.info_array[0].endpoint_gid, RMW_GID_STORAGE_SIZE));
+
+  uint32_t domain = UINT32_MAX;
+  EXPECT_EQ(
+    RMW_RET_OK, hazcat_graph_get_endpoint_domain(info.info_array[0].endpoint_gid, &domain));
+  EXPECT_EQ(0u, domain);    // Default allocator is in CPU memory
+  EXPECT_EQ(RMW_RET_OK, rmw_topic_endpoint_info_array_fini(&info, &allocator));
+
+  ASSERT_EQ(
+    RMW_RET_OK,
+    rmw_get_subscriptions_info_by_topic(node, &allocator, "/graph_d", false, &info));
+  EXPECT_EQ(0u, info.size);
+  EXPECT_EQ(RMW_RET_OK, rmw_topic_endpoint_info_array_fini(&info, &allocator));
+
+  EXPECT_EQ(RMW_RET_OK, rmw_destroy_publisher(node, pub));
+}
+
+TEST_F(TestRosGraph, count_endpoints) {
+  const rosidl_message_type_support_t * type_support =
+    ROSIDL_GET_MSG_TYPE_SUPPORT(test_msgs, msg, BasicTypes);
+  rmw_qos_profile_t qos = rmw_qos_profile_system_default;
+  rmw_publisher_options_t pub_opts = rmw_get_default_publisher_options();
+  rmw_subscription_options_t sub_opts = rmw_get_default_subscription_options();
+
+  size_t count = SIZE_MAX;
+  EXPECT_EQ(RMW_RET_OK, rmw_count_publishers(node, "/graph_never_used", &count));
+  EXPECT_EQ(0u, count);
+  count = SIZE_MAX;
+  EXPECT_EQ(RMW_RET_OK, rmw_count_subscribers(node, "/graph_never_used", &count));
+  EXPECT_EQ(0u, count);
+
+  rmw_publisher_t * pub1 = rmw_create_publisher(node, type_support, "/graph_f", &qos, &pub_opts);
+  ASSERT_NE(nullptr, pub1) << rcutils_get_error_string().str;
+  rmw_publisher_t * pub2 = rmw_create_publisher(node, type_support, "/graph_f", &qos, &pub_opts);
+  ASSERT_NE(nullptr, pub2) << rcutils_get_error_string().str;
+  rmw_subscription_t * sub =
+    rmw_create_subscription(node, type_support, "/graph_f", &qos, &sub_opts);
+  ASSERT_NE(nullptr, sub) << rcutils_get_error_string().str;
+
+  EXPECT_EQ(RMW_RET_OK, rmw_count_publishers(node, "/graph_f", &count));
+  EXPECT_EQ(2u, count);
+  EXPECT_EQ(RMW_RET_OK, rmw_count_subscribers(node, "/graph_f", &count));
+  EXPECT_EQ(1u, count);
+
+  // TRANSIENT_LOCAL publishers keep a subscription on the queue, which isn't one to ROS
+  qos.durability = RMW_QOS_POLICY_DURABILITY_TRANSIENT_LOCAL;
+  rmw_publisher_t * pub3 = rmw_create_publisher(node, type_support, "/graph_f", &qos, &pub_opts);
+  ASSERT_NE(nullptr, pub3) << rcutils_get_error_string().str;
+  EXPECT_EQ(RMW_RET_OK, rmw_count_publishers(node, "/graph_f", &count));
+  EXPECT_EQ(3u, count);
+  EXPECT_EQ(RMW_RET_OK, rmw_count_subscribers(node, "/graph_f", &count));
+  EXPECT_EQ(1u, count);
+
+  EXPECT_EQ(RMW_RET_OK, rmw_destroy_publisher(node, pub3));
+  EXPECT_EQ(RMW_RET_OK, rmw_destroy_publisher(node, pub2));
+  EXPECT_EQ(RMW_RET_OK, rmw_count_publishers(node, "/graph_f", &count));
+  EXPECT_EQ(1u, count);
+  EXPECT_EQ(RMW_RET_OK, rmw_destroy_subscription(node, sub));
+  EXPECT_EQ(RMW_RET_OK, rmw_count_subscribers(node, "/graph_f", &count));
+  EXPECT_EQ(0u, count);
+  EXPECT_EQ(RMW_RET_OK, rmw_destroy_publisher(node, pub1));
+  EXPECT_EQ(RMW_RET_OK, rmw_count_publishers(node, "/graph_f", &count));
+  EXPECT_EQ(0u, count);
+
+  EXPECT_EQ(RMW_RET_INVALID_ARGUMENT, rmw_count_publishers(node, "not a topic", &count));
+  rmw_reset_error();
+}
+
+TEST_F(TestRosGraph, reclaim_dead_process) {
+  const rosidl_message_type_support_t * type_support =
+    ROSIDL_GET_MSG_TYPE_SUPPORT(test_msgs, msg, BasicTypes);
+  rmw_qos_profile_t qos = rmw_qos_profile_system_default;
+  qos.depth = 1;
+
+  // Child joins the topic, then exits without cleaning up, as though it crashed
+  pid_t pid = fork();
+  ASSERT_NE(-1, pid);
+  if (0 == pid) {
+    rmw_node_t * dead_node = rmw_create_node(&context, "dead_node", "/graph_test", 1, true);
+    rmw_subscription_options_t sub_opts = rmw_get_default_subscription_options();
+    rmw_subscription_t * sub =
+      rmw_create_subscription(dead_node, type_support, "/graph_e", &qos, &sub_opts);
+    _exit((NULL != dead_node && NULL != sub) ? 0 : 1);
+  }
+  int status;
+  ASSERT_EQ(pid, waitpid(pid, &status, 0));
+  ASSERT_EQ(0, WEXITSTATUS(status));
+
+  size_t count = 0;
+  ASSERT_EQ(RMW_RET_OK, rmw_count_subscribers(node, "/graph_e", &count));
+  EXPECT_EQ(1u, count);
+
+  // Scans are rate limited, and creating this test's node ran one
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  EXPECT_LE(1, hazcat_graph_reclaim());
+  ASSERT_EQ(RMW_RET_OK, rmw_count_subscribers(node, "/graph_e", &count));
+  EXPECT_EQ(0u, count);
+
+  rcutils_allocator_t allocator = rcutils_get_default_allocator();
+  rmw_names_and_types_t nt = rmw_get_zero_initialized_names_and_types();
+  EXPECT_EQ(
+    RMW_RET_NODE_NAME_NON_EXISTENT,
+    rmw_get_subscriber_names_and_types_by_node(
+      node, &allocator, "dead_node", "/graph_test", false, &nt));
+  rmw_reset_error();
+
+  // Nothing left to reclaim
+  EXPECT_EQ(0, hazcat_graph_reclaim());
+}
@@ -0,0 +1,223 @@
+// Copyright 2022 Washington University in St Louis
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <cstring>
+
+#include "osrf_testing_tools_cpp/scope_exit.hpp"
+
+#include "rcutils/allocator.h"
+#include "rcutils/strdup.h"
+
+#include "rmw/error_handling.h"
+#include "rmw/rmw.h"
+#include "rmw/serialized_message.h"
+
+#include "rosidl_runtime_c/primitives_sequence_functions.h"
+#include "rosidl_runtime_c/string_functions.h"
+
+#include "std_msgs/msg/string.h"
+#include "test_msgs/msg/strings.h"
+#include "test_msgs/msg/unbounded_sequences.h"
+
+class TestSerialize : public ::testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    rmw_init_options_t options = rmw_get_zero_initialized_init_options();
+    rmw_ret_t ret = rmw_init_options_init(&options, rcutils_get_default_allocator());
+    ASSERT_EQ(RMW_RET_OK, ret) << rcutils_get_error_string().str;
+    OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+    {
+      rmw_ret_t ret = rmw_init_options_fini(&options);
+      EXPECT_EQ(RMW_RET_OK, ret) << rmw_get_error_string().str;
+    });
+    options.enclave = rcutils_strdup("/", rcutils_get_default_allocator());
+    ASSERT_STREQ("/", options.enclave);
+    context = rmw_get_zero_initialized_context();
+    ret = rmw_init(&options, &context);
+    ASSERT_EQ(RMW_RET_OK, ret) << rcutils_get_error_string().str;
+    node = rmw_create_node(&context, "serialize_test_node", "/serialize_test", 1, true);
+    ASSERT_NE(nullptr, node) << rcutils_get_error_string().str;
+  }
+
+  void TearDown() override
+  {
+    rmw_ret_t ret = rmw_destroy_node(node);
+    EXPECT_EQ(RMW_RET_OK, ret) << rcutils_get_error_string().str;
+    ret = rmw_shutdown(&context);
+    EXPECT_EQ(RMW_RET_OK, ret) << rcutils_get_error_string().str;
+    ret = rmw_context_fini(&context);
+    EXPECT_EQ(RMW_RET_OK, ret) << rcutils_get_error_string().str;
+  }
+
+  rmw_qos_profile_t qos = rmw_qos_profile_default;
+  rmw_publisher_options_t pub_options = rmw_get_default_publisher_options();
+  rmw_subscription_options_t sub_options = rmw_get_default_subscription_options();
+  rmw_context_t context;
+  rmw_node_t * node;
+};
+
+// Taken strings live in the message's own storage, so they outlast the shared memory block they
+// were read from and are freed by the usual fini
+TEST_F(TestSerialize, strings_after_take) {
+  const rosidl_message_type_support_t * ts = ROSIDL_GET_MSG_TYPE_SUPPORT(test_msgs, msg, Strings);
+  rmw_publisher_t * pub = rmw_create_publisher(node, ts, "/strings", &qos, &pub_options);
+  ASSERT_NE(nullptr, pub) << rcutils_get_error_string().str;
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    EXPECT_EQ(RMW_RET_OK, rmw_destroy_publisher(node, pub)) << rcutils_get_error_string().str;
+  });
+  rmw_subscription_t * sub = rmw_create_subscription(node, ts, "/strings", &qos, &sub_options);
+  ASSERT_NE(nullptr, sub) << rcutils_get_error_string().str;
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    EXPECT_EQ(RMW_RET_OK, rmw_destroy_subscription(node, sub)) << rcutils_get_error_string().str;
+  });
+  EXPECT_FALSE(pub->can_loan_messages);
+  EXPECT_FALSE(sub->can_loan_messages);
+
+  test_msgs__msg__Strings msg;
+  ASSERT_TRUE(test_msgs__msg__Strings__init(&msg));
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT({test_msgs__msg__Strings__fini(&msg);});
+  ASSERT_TRUE(rosidl_runtime_c__String__assign(&msg.string_value, "first message"));
+  ASSERT_EQ(RMW_RET_OK, rmw_publish(pub, &msg, nullptr)) << rcutils_get_error_string().str;
+  ASSERT_TRUE(rosidl_runtime_c__String__assign(&msg.string_value, "second"));
+  ASSERT_EQ(RMW_RET_OK, rmw_publish(pub, &msg, nullptr)) << rcutils_get_error_string().str;
+
+  test_msgs__msg__Strings first;
+  ASSERT_TRUE(test_msgs__msg__Strings__init(&first));
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT({test_msgs__msg__Strings__fini(&first);});
+  bool taken = false;
+  ASSERT_EQ(RMW_RET_OK, rmw_take(sub, &first, &taken, nullptr)) << rcutils_get_error_string().str;
+  ASSERT_TRUE(taken);
+
+  // The first block is free now, and gets reused by the next publish
+  ASSERT_TRUE(rosidl_runtime_c__String__assign(&msg.string_value, "overwrites the first block"));
+  ASSERT_EQ(RMW_RET_OK, rmw_publish(pub, &msg, nullptr)) << rcutils_get_error_string().str;
+  EXPECT_STREQ("first message", first.string_value.data);
+  EXPECT_EQ(strlen("first message"), first.string_value.size);
+
+  ASSERT_EQ(RMW_RET_OK, rmw_take(sub, &first, &taken, nullptr)) << rcutils_get_error_string().str;
+  ASSERT_TRUE(taken);
+  EXPECT_STREQ("second", first.string_value.data);
+  ASSERT_EQ(RMW_RET_OK, rmw_take(sub, &first, &taken, nullptr)) << rcutils_get_error_string().str;
+  ASSERT_TRUE(taken);
+  EXPECT_STREQ("overwrites the first block", first.string_value.data);
+}
+
+TEST_F(TestSerialize, sequences_after_take) {
+  const rosidl_message_type_support_t * ts =
+    ROSIDL_GET_MSG_TYPE_SUPPORT(test_msgs, msg, UnboundedSequences);
+  rmw_publisher_t * pub = rmw_create_publisher(node, ts, "/sequences", &qos, &pub_options);
+  ASSERT_NE(nullptr, pub) << rcutils_get_error_string().str;
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    EXPECT_EQ(RMW_RET_OK, rmw_destroy_publisher(node, pub)) << rcutils_get_error_string().str;
+  });
+  rmw_subscription_t * sub = rmw_create_subscription(node, ts, "/sequences", &qos, &sub_options);
+  ASSERT_NE(nullptr, sub) << rcutils_get_error_string().str;
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    EXPECT_EQ(RMW_RET_OK, rmw_destroy_subscription(node, sub)) << rcutils_get_error_string().str;
+  });
+
+  test_msgs__msg__UnboundedSequences msg;
+  ASSERT_TRUE(test_msgs__msg__UnboundedSequences__init(&msg));
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT({test_msgs__msg__UnboundedSequences__fini(&msg);});
+  ASSERT_TRUE(rosidl_runtime_c__int32__Sequence__init(&msg.int32_values, 3));
+  for (int32_t i = 0; i < 3; i++) {
+    msg.int32_values.data[i] = i - 1;
+  }
+  ASSERT_TRUE(rosidl_runtime_c__String__Sequence__init(&msg.string_values, 2));
+  ASSERT_TRUE(rosidl_runtime_c__String__assign(&msg.string_values.data[0], "one"));
+  ASSERT_TRUE(rosidl_runtime_c__String__assign(&msg.string_values.data[1], ""));
+  ASSERT_EQ(RMW_RET_OK, rmw_publish(pub, &msg, nullptr)) << rcutils_get_error_string().str;
+
+  test_msgs__msg__UnboundedSequences taken_msg;
+  ASSERT_TRUE(test_msgs__msg__UnboundedSequences__init(&taken_msg));
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT({test_msgs__msg__UnboundedSequences__fini(&taken_msg);});
+  bool taken = false;
+  ASSERT_EQ(RMW_RET_OK, rmw_take(sub, &taken_msg, &taken, nullptr)) <<
+    rcutils_get_error_string().str;
+  ASSERT_TRUE(taken);
+  ASSERT_EQ(3u, taken_msg.int32_values.size);
+  EXPECT_NE(msg.int32_values.data, taken_msg.int32_values.data);
+  for (int32_t i = 0; i < 3; i++) {
+    EXPECT_EQ(i - 1, taken_msg.int32_values.data[i]);
+  }
+  ASSERT_EQ(2u, taken_msg.string_values.size);
+  EXPECT_STREQ("one", taken_msg.string_values.data[0].data);
+  EXPECT_STREQ("", taken_msg.string_values.data[1].data);
+  EXPECT_EQ(0u, taken_msg.bool_values.size);
+}
+
+// Serialized messages are deserialized straight into shared memory, then read back like any other
+TEST_F(TestSerialize, serialized_string) {
+  const rosidl_message_type_support_t * ts = ROSIDL_GET_MSG_TYPE_SUPPORT(std_msgs, msg, String);
+  rmw_publisher_t * pub = rmw_create_publisher(node, ts, "/serialized", &qos, &pub_options);
+  ASSERT_NE(nullptr, pub) << rcutils_get_error_string().str;
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    EXPECT_EQ(RMW_RET_OK, rmw_destroy_publisher(node, pub)) << rcutils_get_error_string().str;
+  });
+  rmw_subscription_t * sub = rmw_create_subscription(node, ts, "/serialized", &qos, &sub_options);
+  ASSERT_NE(nullptr, sub) << rcutils_get_error_string().str;
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    EXPECT_EQ(RMW_RET_OK, rmw_destroy_subscription(node, sub)) << rcutils_get_error_string().str;
+  });
+
+  // A CDR string is its length, counting the null terminator, then its characters
+  const char text[] = "serialized";
+  uint8_t buffer[sizeof(uint32_t) + sizeof(text)];
+  uint32_t len = sizeof(text);
+  memcpy(buffer, &len, sizeof(len));
+  memcpy(buffer + sizeof(len), text, sizeof(text));
+  rmw_serialized_message_t serialized = rmw_get_zero_initialized_serialized_message();
+  serialized.buffer = buffer;
+  serialized.buffer_length = sizeof(buffer);
+  serialized.buffer_capacity = sizeof(buffer);
+  ASSERT_EQ(RMW_RET_OK, rmw_publish_serialized_message(pub, &serialized, nullptr)) <<
+    rcutils_get_error_string().str;
+
+  std_msgs__msg__String msg;
+  ASSERT_TRUE(std_msgs__msg__String__init(&msg));
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT({std_msgs__msg__String__fini(&msg);});
+  bool taken = false;
+  ASSERT_EQ(RMW_RET_OK, rmw_take(sub, &msg, &taken, nullptr)) << rcutils_get_error_string().str;
+  ASSERT_TRUE(taken);
+  EXPECT_STREQ(text, msg.data.data);
+  EXPECT_EQ(strlen(text), msg.data.size);
+}
+
+TEST_F(TestSerialize, best_effort_strings_refused) {
+  const rosidl_message_type_support_t * ts = ROSIDL_GET_MSG_TYPE_SUPPORT(std_msgs, msg, String);
+  qos.reliability = RMW_QOS_POLICY_RELIABILITY_BEST_EFFORT;
+  rmw_publisher_t * pub = rmw_create_publisher(node, ts, "/best_effort", &qos, &pub_options);
+  ASSERT_NE(nullptr, pub) << rcutils_get_error_string().str;
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    EXPECT_EQ(RMW_RET_OK, rmw_destroy_publisher(node, pub)) << rcutils_get_error_string().str;
+  });
+
+  std_msgs__msg__String msg;
+  ASSERT_TRUE(std_msgs__msg__String__init(&msg));
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT({std_msgs__msg__String__fini(&msg);});
+  EXPECT_EQ(RMW_RET_UNSUPPORTED, rmw_publish(pub, &msg, nullptr));
+  rmw_reset_error();
+}
@@ -0,0 +1,235 @@
+// Copyright 2022 Washington University in St Louis
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <cstring>
+
+#include "osrf_testing_tools_cpp/scope_exit.hpp"
+
+#include "rcutils/allocator.h"
+#include "rcutils/strdup.h"
+
+#include "rmw/error_handling.h"
+#include "rmw/rmw.h"
+
+#include "rosidl_runtime_c/service_type_support_struct.h"
+
+#include "test_msgs/srv/basic_types.h"
+
+#include "rmw_hazcat/hazcat_service_loans.h"
+
+class TestService : public ::testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    rmw_init_options_t options = rmw_get_zero_initialized_init_options();
+    rmw_ret_t ret = rmw_init_options_init(&options, rcutils_get_default_allocator());
+    ASSERT_EQ(RMW_RET_OK, ret) << rcutils_get_error_string().str;
+    OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+    {
+      rmw_ret_t ret = rmw_init_options_fini(&options);
+      EXPECT_EQ(RMW_RET_OK, ret) << rmw_get_error_string().str;
+    });
+    options.enclave = rcutils_strdup("/", rcutils_get_default_allocator());
+    ASSERT_STREQ("/", options.enclave);
+    context = rmw_get_zero_initialized_context();
+    ret = rmw_init(&options, &context);
+    ASSERT_EQ(RMW_RET_OK, ret) << rcutils_get_error_string().str;
+    node = rmw_create_node(&context, "service_test_node", "/service_test", 1, true);
+    ASSERT_NE(nullptr, node) << rcutils_get_error_string().str;
+  }
+
+  void TearDown() override
+  {
+    rmw_ret_t ret = rmw_destroy_node(node);
+    EXPECT_EQ(RMW_RET_OK, ret) << rcutils_get_error_string().str;
+    ret = rmw_shutdown(&context);
+    EXPECT_EQ(RMW_RET_OK, ret) << rcutils_get_error_string().str;
+    ret = rmw_context_fini(&context);
+    EXPECT_EQ(RMW_RET_OK, ret) << rcutils_get_error_string().str;
+  }
+
+  const rosidl_service_type_support_t * ts =
+    ROSIDL_GET_SRV_TYPE_SUPPORT(test_msgs, srv, BasicTypes);
+  rmw_qos_profile_t qos = rmw_qos_profile_services_default;
+  rmw_context_t context;
+  rmw_node_t * node;
+};
+
+// Messages are copied as is, so only primitive fields are set and nothing is finalized
+TEST_F(TestService, request_response) {
+  rmw_service_t * srv = rmw_create_service(node, ts, "/srv_a", &qos);
+  ASSERT_NE(nullptr, srv) << rcutils_get_error_string().str;
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    EXPECT_EQ(RMW_RET_OK, rmw_destroy_service(node, srv)) << rcutils_get_error_string().str;
+  });
+  rmw_client_t * clt = rmw_create_client(node, ts, "/srv_a", &qos);
+  ASSERT_NE(nullptr, clt) << rcutils_get_error_string().str;
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    EXPECT_EQ(RMW_RET_OK, rmw_destroy_client(node, clt)) << rcutils_get_error_string().str;
+  });
+
+  bool available = false;
+  ASSERT_EQ(RMW_RET_OK, rmw_service_server_is_available(node, clt, &available));
+  EXPECT_TRUE(available);
+
+  test_msgs__srv__BasicTypes_Request request;
+  memset(&request, 0, sizeof(request));
+  int64_t seq[2];
+  for (int i = 0; i < 2; i++) {
+    request.int64_value = 100 + i;
+    ASSERT_EQ(RMW_RET_OK, rmw_send_request(clt, &request, &seq[i])) <<
+      rcutils_get_error_string().str;
+  }
+  EXPECT_EQ(seq[0] + 1, seq[1]);
+
+  // Service should wake up
+  rmw_wait_set_t * ws = rmw_create_wait_set(&context, 2);
+  ASSERT_NE(nullptr, ws) << rcutils_get_error_string().str;
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    EXPECT_EQ(RMW_RET_OK, rmw_destroy_wait_set(ws)) << rcutils_get_error_string().str;
+  });
+  void * srv_storage[1] = {srv->data};
+  rmw_services_t services = {1, srv_storage};
+  rmw_time_t timeout = {1, 0};
+  ASSERT_EQ(RMW_RET_OK, rmw_wait(nullptr, nullptr, &services, nullptr, nullptr, ws, &timeout));
+  EXPECT_NE(nullptr, services.services[0]);
+
+  // Answer each request with double its value
+  for (int i = 0; i < 2; i++) {
+    rmw_service_info_t header;
+    bool taken = false;
+    ASSERT_EQ(RMW_RET_OK, rmw_take_request(srv, &header, &request, &taken));
+    ASSERT_TRUE(taken);
+    EXPECT_EQ(request.int64_value, 100 + header.request_id.sequence_number - seq[0]);
+
+    test_msgs__srv__BasicTypes_Response response;
+    memset(&response, 0, sizeof(response));
+    response.int64_value = 2 * request.int64_value;
+    ASSERT_EQ(RMW_RET_OK, rmw_send_response(srv, &header.request_id, &response)) <<
+      rcutils_get_error_string().str;
+  }
+  rmw_service_info_t header;
+  bool taken = true;
+  ASSERT_EQ(RMW_RET_OK, rmw_take_request(srv, &header, &request, &taken));
+  EXPECT_FALSE(taken);
+
+  // Client should wake up, with responses matched to requests by sequence number
+  void * clt_storage[1] = {clt->data};
+  rmw_clients_t clients = {1, clt_storage};
+  ASSERT_EQ(RMW_RET_OK, rmw_wait(nullptr, nullptr, nullptr, &clients, nullptr, ws, &timeout));
+  EXPECT_NE(nullptr, clients.clients[0]);
+  test_msgs__srv__BasicTypes_Response response;
+  memset(&response, 0, sizeof(response));
+  for (int i = 0; i < 2; i++) {
+    ASSERT_EQ(RMW_RET_OK, rmw_take_response(clt, &header, &response, &taken));
+    ASSERT_TRUE(taken);
+    EXPECT_EQ(response.int64_value, 2 * (100 + header.request_id.sequence_number - seq[0]));
+  }
+  ASSERT_EQ(RMW_RET_OK, rmw_take_response(clt, &header, &response, &taken));
+  EXPECT_FALSE(taken);
+}
+
+TEST_F(TestService, server_unavailable) {
+  rmw_client_t * clt = rmw_create_client(node, ts, "/srv_b", &qos);
+  ASSERT_NE(nullptr, clt) << rcutils_get_error_string().str;
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    EXPECT_EQ(RMW_RET_OK, rmw_destroy_client(node, clt)) << rcutils_get_error_string().str;
+  });
+
+  bool available = true;
+  ASSERT_EQ(RMW_RET_OK, rmw_service_server_is_available(node, clt, &available));
+  EXPECT_FALSE(available);
+}
+
+TEST_F(TestService, client_gone) {
+  rmw_service_t * srv = rmw_create_service(node, ts, "/srv_c", &qos);
+  ASSERT_NE(nullptr, srv) << rcutils_get_error_string().str;
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    EXPECT_EQ(RMW_RET_OK, rmw_destroy_service(node, srv)) << rcutils_get_error_string().str;
+  });
+  rmw_client_t * clt = rmw_create_client(node, ts, "/srv_c", &qos);
+  ASSERT_NE(nullptr, clt) << rcutils_get_error_string().str;
+
+  test_msgs__srv__BasicTypes_Request request;
+  memset(&request, 0, sizeof(request));
+  int64_t seq;
+  ASSERT_EQ(RMW_RET_OK, rmw_send_request(clt, &request, &seq));
+  rmw_service_info_t header;
+  bool taken = false;
+  ASSERT_EQ(RMW_RET_OK, rmw_take_request(srv, &header, &request, &taken));
+  ASSERT_TRUE(taken);
+  ASSERT_EQ(RMW_RET_OK, rmw_destroy_client(node, clt)) << rcutils_get_error_string().str;
+
+  // Response is dropped quietly
+  test_msgs__srv__BasicTypes_Response response;
+  memset(&response, 0, sizeof(response));
+  EXPECT_EQ(RMW_RET_OK, rmw_send_response(srv, &header.request_id, &response));
+}
+
+TEST_F(TestService, loaned_request_response) {
+  rmw_service_t * srv = rmw_create_service(node, ts, "/srv_d", &qos);
+  ASSERT_NE(nullptr, srv) << rcutils_get_error_string().str;
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    EXPECT_EQ(RMW_RET_OK, rmw_destroy_service(node, srv)) << rcutils_get_error_string().str;
+  });
+  rmw_client_t * clt = rmw_create_client(node, ts, "/srv_d", &qos);
+  ASSERT_NE(nullptr, clt) << rcutils_get_error_string().str;
+  OSRF_TESTING_TOOLS_CPP_SCOPE_EXIT(
+  {
+    EXPECT_EQ(RMW_RET_OK, rmw_destroy_client(node, clt)) << rcutils_get_error_string().str;
+  });
+
+  void * loan = nullptr;
+  ASSERT_EQ(RMW_RET_OK, rmw_hazcat_borrow_loaned_request(clt, &loan));
+  ASSERT_NE(nullptr, loan);
+  auto request = static_cast<test_msgs__srv__BasicTypes_Request *>(loan);
+  request->int64_value = 7;
+  int64_t seq;
+  ASSERT_EQ(RMW_RET_OK, rmw_hazcat_send_loaned_request(clt, loan, &seq));
+
+  // Service sees the request in place, and answers with a loan of its own
+  rmw_service_info_t header;
+  bool taken = false;
+  void * taken_request = nullptr;
+  ASSERT_EQ(RMW_RET_OK, rmw_hazcat_take_loaned_request(srv, &header, &taken_request, &taken));
+  ASSERT_TRUE(taken);
+  EXPECT_EQ(seq, header.request_id.sequence_number);
+  EXPECT_EQ(7, static_cast<test_msgs__srv__BasicTypes_Request *>(taken_request)->int64_value);
+
+  loan = nullptr;
+  ASSERT_EQ(RMW_RET_OK, rmw_hazcat_borrow_loaned_response(srv, &header.request_id, &loan));
+  ASSERT_NE(nullptr, loan);
+  static_cast<test_msgs__srv__BasicTypes_Response *>(loan)->int64_value = 14;
+  ASSERT_EQ(
+    RMW_RET_OK,
+    rmw_hazcat_return_loaned_request_from_service(srv, taken_request));
+  ASSERT_EQ(RMW_RET_OK, rmw_hazcat_send_loaned_response(srv, &header.request_id, loan));
+
+  void * response = nullptr;
+  ASSERT_EQ(RMW_RET_OK, rmw_hazcat_take_loaned_response(clt, &header, &response, &taken));
+  ASSERT_TRUE(taken);
+  EXPECT_EQ(seq, header.request_id.sequence_number);
+  EXPECT_EQ(14, static_cast<test_msgs__srv__BasicTypes_Response *>(response)->int64_value);
+  EXPECT_EQ(RMW_RET_OK, rmw_hazcat_return_loaned_response_from_client(clt, response));
+}